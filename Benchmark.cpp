@@ -0,0 +1,874 @@
+// Microbenchmarks of the engine subsystems (no window; the GPU ones create their own GL context)
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "Benchmark.hpp"
+#include "TransformKernel.hpp"
+#include "EntityStore.hpp"
+#include "JobSystem.hpp"
+#define HEIGHTMAP_NO_STB_IMPLEMENTATION
+#include "Heightmap.hpp"
+#include "HeightPyramid.hpp"
+#include "TerrainNoise.hpp"
+#include "ProjectileSystem.hpp"
+#include "SpatialHash.hpp"
+#include "ParticleSystem.hpp"
+#include "FireflySwarm.hpp"
+#include "HeadlessContext.hpp"
+#ifndef HEADLESS_EGL
+#include <GLFW/glfw3.h>
+#endif
+
+//------ TRS -> model/normal matrix: glm chain (as Model::draw did) vs. scalar kernel vs. SIMD kernel ------
+static void bench_transform(void) {
+    std::cout << "--- transform kernel (" << TransformKernel::lanes() << " lanes) ---\n";
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f), angle(-3.14f, 3.14f), size(0.1f, 3.0f);
+
+    for (size_t count : { 1000, 10000, 100000 }) {
+        TransformKernel kernel;
+        for (size_t i = 0; i < count; ++i)
+            kernel.add(glm::vec3(pos(rng), pos(rng), pos(rng)), glm::vec3(angle(rng), angle(rng), angle(rng)), glm::vec3(size(rng), size(rng), size(rng)));
+
+        std::vector<glm::mat4> glm_model(count);
+        std::vector<glm::mat3> glm_normal(count);
+        double t_glm = time_ms([&] {
+            for (size_t i = 0; i < count; ++i) {
+                glm::mat4 t = glm::translate(glm::mat4(1.0f), glm::vec3(kernel.px[i], kernel.py[i], kernel.pz[i]));
+                glm::mat4 rx = glm::rotate(glm::mat4(1.0f), kernel.ex[i], glm::vec3(1.0f, 0.0f, 0.0f));
+                glm::mat4 ry = glm::rotate(glm::mat4(1.0f), kernel.ey[i], glm::vec3(0.0f, 1.0f, 0.0f));
+                glm::mat4 rz = glm::rotate(glm::mat4(1.0f), kernel.ez[i], glm::vec3(0.0f, 0.0f, 1.0f));
+                glm::mat4 s = glm::scale(glm::mat4(1.0f), glm::vec3(kernel.sx[i], kernel.sy[i], kernel.sz[i]));
+                glm_model[i] = t * rx * ry * rz * s;
+                glm_normal[i] = glm::mat3(glm::inverseTranspose(glm_model[i]));
+            }
+            });
+        // positions change every frame, orientations are static (the sin/cos cache stays valid)
+        double t_scalar = time_ms([&] { kernel.compute_scalar(); });
+        double t_simd = time_ms([&] { kernel.compute(); });
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; ++i)
+            if (glm_model[i] != kernel.model_matrices[i])
+                ++mismatches;
+
+        // every orientation changes every frame (sin/cos re-evaluated)
+        double t_rotating = time_ms([&] {
+            for (size_t i = 0; i < count; ++i)
+                kernel.ey[i] += 0.001f;
+            kernel.compute();
+            });
+
+        std::cout << count << " objects: glm " << t_glm << " ms, scalar " << t_scalar << " ms, simd " << t_simd
+            << " ms (" << t_glm / t_simd << "x), simd + rotating " << t_rotating
+            << " ms, model matrix mismatches: " << mismatches << '\n';
+    }
+}
+
+//------ Scene update: frame CPU time of the entity systems (movers, scene graph, draw lists) ------
+static void bench_entities(void) {
+    std::cout << "--- entity store ---\n";
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f), unit(0.0f, 1.0f);
+    Model model;    // no meshes, only the CPU side is measured
+    auto terrain_height = [](float x, float z) { return 0.01f * (x + z); };
+    auto terrain_hit = [](glm::vec3 const&, glm::vec3 const&) { return false; };   // circle movers only
+
+    for (size_t count : { 100, 10000, 100000 }) {
+        SceneGraph graph;
+        EntityStore store(graph);
+        SceneGraph::NodeId root = graph.create();
+        for (size_t i = 0; i < count; ++i) {
+            Entity e = store.create(i < 1000 ? "Tree:" + std::to_string(i) : std::string());
+            Transform t;
+            t.origin = glm::vec3(pos(rng), 0.0f, pos(rng));
+            store.add_transform(e, t, root);
+            store.renderables.add(e, Renderable{ &model });
+            store.texture_layers.add(e, 1);
+            float kind = unit(rng);
+            if (kind < 0.1f) {          // 10 % move on a circle
+                Mover m;
+                m.center = t.origin;
+                m.radius = 1.0f + 5.0f * unit(rng);
+                store.movers.add(e, m);
+            }
+            else if (kind < 0.12f) {    // 2 % transparent
+                store.transparency.add(e, Transparency{});
+            }
+        }
+        graph.update();
+
+        std::vector<DrawItem> opaque, transparent;
+        std::vector<Entity> landed;
+        glm::vec3 eye(0.0f, 10.0f, 0.0f);
+        double t_frame = time_ms([&] {
+            landed.clear();
+            store.update_movers(0.016f, glm::vec3(0.0f), terrain_height, terrain_hit, landed);
+            store.interpolate_movers(0.5f);
+            graph.update();
+            store.build_draw_lists(eye, opaque, transparent);
+            });
+        std::cout << count << " entities: " << t_frame << " ms per frame (" << store.movers.size() << " moving, "
+            << graph.updatedLastFrame() << " nodes updated, " << opaque.size() << " opaque + " << transparent.size() << " transparent draws)\n";
+    }
+}
+
+//------ Job system: core scaling of the parallel ports (terrain generation, scene update) from 1 to N threads ------
+static void bench_jobs(void) {
+    std::cout << "--- job system ---\n";
+    JobSystem& jobs = JobSystem::instance();
+    const int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    // terrain: synthetic 2048 x 2048 height image
+    const int size = 2048;
+    std::vector<unsigned char> image(static_cast<size_t>(size) * size);
+    std::mt19937 rng(3);
+    for (unsigned char& texel : image)
+        texel = static_cast<unsigned char>(rng() & 0xff);
+    std::vector<vertex> vertices;
+    Heightfield heights;
+
+    // scene: 100000 entities, all moving
+    SceneGraph graph;
+    EntityStore store(graph);
+    SceneGraph::NodeId root = graph.create();
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    for (int i = 0; i < 100000; ++i) {
+        Entity e = store.create();
+        Transform t;
+        t.origin = glm::vec3(pos(rng), 0.0f, pos(rng));
+        store.add_transform(e, t, root);
+        Mover m;
+        m.center = t.origin;
+        store.movers.add(e, m);
+    }
+    auto terrain_height = [](float x, float z) { return 0.01f * (x + z); };
+    auto terrain_hit = [](glm::vec3 const&, glm::vec3 const&) { return false; };   // circle movers only
+    std::vector<Entity> landed;
+
+    double base_terrain = 0.0, base_scene = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = (threads < max_threads && threads * 2 > max_threads) ? max_threads : threads * 2) {
+        jobs.start(threads - 1);
+        double t_terrain = time_ms([&] { Heightmap::generate(image.data(), size, size, 1, vertices, heights); });
+        double t_scene = time_ms([&] {
+            landed.clear();
+            store.update_movers(1.0f / 120.0f, glm::vec3(0.0f), terrain_height, terrain_hit, landed);
+            store.interpolate_movers(0.5f);
+            graph.update();
+            });
+        if (threads == 1) {
+            base_terrain = t_terrain;
+            base_scene = t_scene;
+        }
+        std::cout << threads << " threads: terrain " << size << "x" << size << " " << t_terrain << " ms (" << base_terrain / t_terrain
+            << "x), scene update 100000 movers " << t_scene << " ms (" << base_scene / t_scene << "x)\n";
+        if (threads == max_threads)
+            break;
+    }
+    jobs.start();   // back to the default thread count
+}
+
+//------ Terrain construction: per-texel loop with push_back (as the Heightmap constructor did) vs. row-parallel two-pass generation ------
+static void legacy_generate(unsigned char const* data, int width, int height, int nChannels,
+    std::vector<vertex>& vertices, std::vector<std::vector<float>>& heightmap) {
+    float yScale = 64.0f / 255.0f, yShift = 16.0f;
+    heightmap.assign(height, std::vector<float>(width));
+    vertices.clear();
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            auto getHeight = [&](int row, int col) {
+                row = glm::clamp(row, 0, height - 1);
+                col = glm::clamp(col, 0, width - 1);
+                unsigned char const* texel = data + (col + width * row) * nChannels;
+                return static_cast<float>(texel[0]) * yScale - yShift;
+                };
+            float h = getHeight(i, j);
+            heightmap[i][j] = h;
+            glm::vec3 pL = glm::vec3(-height / 2.0f + (i - 1), getHeight(i - 1, j), -width / 2.0f + j);
+            glm::vec3 pR = glm::vec3(-height / 2.0f + (i + 1), getHeight(i + 1, j), -width / 2.0f + j);
+            glm::vec3 pD = glm::vec3(-height / 2.0f + i, getHeight(i, j - 1), -width / 2.0f + (j - 1));
+            glm::vec3 pU = glm::vec3(-height / 2.0f + i, getHeight(i, j + 1), -width / 2.0f + (j + 1));
+            glm::vec3 N = glm::normalize(glm::cross(pU - pD, pR - pL));
+            vertex v;
+            v.position = glm::vec3(-height / 2.0f + i, h, -width / 2.0f + j);
+            v.normal = N;
+            v.texcoord = glm::vec2(static_cast<float>(j) / (width - 1), static_cast<float>(i) / (height - 1));
+            vertices.push_back(v);
+        }
+    }
+}
+
+static void bench_terrain(void) {
+    JobSystem& jobs = JobSystem::instance();
+    if (jobs.thread_count() == 0)
+        jobs.start();
+    std::cout << "--- terrain construction (" << jobs.thread_count() << " threads) ---\n";
+    std::mt19937 rng(9);
+    for (int size : { 1024, 4096, 8192 }) {
+        // smooth synthetic terrain, the 16-bit image has the same shape at full precision
+        std::vector<unsigned char> image8(static_cast<size_t>(size) * size);
+        std::vector<unsigned short> image16(image8.size());
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j) {
+                const float h = 0.5f + 0.25f * std::sin(i * 0.01f) + 0.25f * std::cos(j * 0.013f);
+                image16[static_cast<size_t>(i) * size + j] = static_cast<unsigned short>(h * 65535.0f);
+                image8[static_cast<size_t>(i) * size + j] = static_cast<unsigned char>(h * 255.0f);
+            }
+        std::vector<vertex> vertices;
+        Heightfield heights;
+
+        std::string legacy = "skipped (memory)";
+        float max_error = 0.0f;
+        if (size <= 4096) {
+            std::vector<vertex> reference;
+            std::vector<std::vector<float>> rows;
+            legacy = std::to_string(time_ms([&] { legacy_generate(image8.data(), size, size, 1, reference, rows); }, 0.0)) + " ms";
+            Heightmap::generate(image8.data(), size, size, 1, vertices, heights);
+            for (size_t i = 0; i < vertices.size(); ++i)
+                max_error = std::max(max_error, glm::length(vertices[i].normal - reference[i].normal) + std::abs(vertices[i].position.y - reference[i].position.y));
+        }
+        double t_generate = time_ms([&] { Heightmap::generate(image8.data(), size, size, 1, vertices, heights); }, 0.0);
+        double t_generate16 = time_ms([&] { Heightmap::generate(image16.data(), size, size, 1, vertices, heights); }, 0.0);
+        double t_heights = time_ms([&] { Heightmap::load_heights(image16.data(), size, size, 1, heights); }, 0.0);
+        std::cout << size << "x" << size << ": per texel " << legacy << ", rows 8-bit " << t_generate << " ms, 16-bit "
+            << t_generate16 << " ms, heights only (chunked terrain) " << t_heights << " ms; max difference " << max_error << '\n';
+    }
+}
+
+//------ Terrain height queries: per-row vectors (as App::getTerrainHeight did) vs. flat heightfield, one by one and batched ------
+// the previous lookup, kept for comparison: heights[row][column], scalar bilinear
+static float legacy_height(float x, float z, std::vector<std::vector<float>> const& heightmap, int width, int height) {
+    float fx = x + height / 2.0f;
+    float fz = z + width / 2.0f;
+    int ix = std::max(0, std::min(static_cast<int>(fx), height - 2));
+    int iz = std::max(0, std::min(static_cast<int>(fz), width - 2));
+    float h00 = heightmap[ix][iz];
+    float h10 = heightmap[ix + 1][iz];
+    float h01 = heightmap[ix][iz + 1];
+    float h11 = heightmap[ix + 1][iz + 1];
+    float fracx = fx - ix;
+    float fracz = fz - iz;
+    float h0 = h00 * (1 - fracx) + h10 * fracx;
+    float h1 = h01 * (1 - fracx) + h11 * fracx;
+    return h0 * (1 - fracz) + h1 * fracz;
+}
+
+static void bench_heightfield(void) {
+    std::cout << "--- heightfield queries (sample(): " << Heightfield::lanes() << " lanes) ---\n";
+    const int size = 2048;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> texel(-16.0f, 48.0f);
+    std::vector<std::vector<float>> rows(size, std::vector<float>(size));
+    Heightfield field;
+    field.resize(size, size);
+    for (int r = 0; r < size; ++r)
+        for (int c = 0; c < size; ++c)
+            field.set(r, c, rows[r][c] = texel(rng));
+    Heightfield quantized = field;
+    quantized.quantize();
+    std::cout << "memory: rows " << size * (size * sizeof(float) + sizeof(std::vector<float>)) / (1024 * 1024) << " MB, flat "
+        << field.memory_bytes() / (1024 * 1024) << " MB, 16-bit " << quantized.memory_bytes() / (1024 * 1024) << " MB\n";
+
+    for (size_t count : { 1, 1000, 1000000 }) {
+        std::uniform_real_distribution<float> pos(-size / 2.0f, size / 2.0f - 1.0f);
+        std::vector<float> x(count), z(count), y(count), nx(count), ny(count), nz(count), reference(count);
+        for (size_t i = 0; i < count; ++i) {
+            x[i] = pos(rng);
+            z[i] = pos(rng);
+        }
+        float sink = 0.0f;  // keeps the one-by-one loops from being optimized away
+        double t_legacy = time_ms([&] {
+            for (size_t i = 0; i < count; ++i)
+                sink += reference[i] = legacy_height(x[i], z[i], rows, size, size);
+            });
+        double t_single = time_ms([&] {
+            for (size_t i = 0; i < count; ++i)
+                sink += field.height(x[i], z[i]);
+            });
+        double t_batch = time_ms([&] { field.sample(x.data(), z.data(), count, y.data()); });
+        float max_error = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+            max_error = std::max(max_error, std::abs(y[i] - reference[i]));
+        std::vector<float> scalar(count);
+        field.sample_scalar(x.data(), z.data(), count, scalar.data());
+        const bool identical = scalar == y;     // the SIMD path must match the scalar one exactly
+        double t_normals = time_ms([&] { field.sample(x.data(), z.data(), count, y.data(), nx.data(), ny.data(), nz.data()); });
+        double t_quantized = time_ms([&] { quantized.sample(x.data(), z.data(), count, y.data()); });
+        float quantized_error = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+            quantized_error = std::max(quantized_error, std::abs(y[i] - reference[i]));
+
+        std::cout << count << " queries: rows " << t_legacy * 1e6 / count << " ns, flat " << t_single * 1e6 / count
+            << " ns, batch " << t_batch * 1e6 / count << " ns (" << t_legacy / t_batch << "x), batch + normals "
+            << t_normals * 1e6 / count << " ns, 16-bit batch " << t_quantized * 1e6 / count << " ns per query; max difference "
+            << max_error << ", 16-bit " << quantized_error << (identical ? "" : " SIMD != scalar!") << (sink == 0.123f ? " " : "") << '\n';
+    }
+}
+
+//------ Terrain ray casts: min/max pyramid vs. every cell along the ray, on the bundled heightmaps ------
+static void bench_raycast(void) {
+    JobSystem& jobs = JobSystem::instance();
+    if (jobs.thread_count() == 0)
+        jobs.start();
+    std::cout << "--- terrain ray casts (" << jobs.thread_count() << " threads) ---\n";
+    const size_t count = 1000000;
+    const size_t reference_count = 100000;      // the cell walk is slow: a part of the rays
+    for (char const* file : { "resources/heightmaps/ground_v5.jpeg", "resources/heightmaps/iceland_heightmap.png" }) {
+        Heightfield heights;
+        if (!Heightmap::load_heightfield(file, heights))
+            continue;
+        HeightPyramid pyramid;
+        double t_build = time_ms([&] { pyramid.build(heights); }, 0.0);
+
+        // from above the terrain, down at 1..60 degrees in any direction (the flat ones cross many cells)
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<float> px(-heights.rows() / 2.0f, heights.rows() / 2.0f - 1.0f);
+        std::uniform_real_distribution<float> pz(-heights.columns() / 2.0f, heights.columns() / 2.0f - 1.0f);
+        std::uniform_real_distribution<float> above(1.0f, 50.0f);
+        std::uniform_real_distribution<float> heading(0.0f, glm::two_pi<float>());
+        std::uniform_real_distribution<float> pitch(glm::radians(1.0f), glm::radians(60.0f));
+        const float top = heights.max_height();
+        std::vector<HeightPyramid::Ray> rays(count);
+        for (HeightPyramid::Ray& ray : rays) {
+            ray.origin = glm::vec3(px(rng), top + above(rng), pz(rng));
+            const float a = heading(rng), b = pitch(rng);
+            ray.direction = glm::vec3(std::cos(a) * std::cos(b), -std::sin(b), std::sin(a) * std::cos(b));
+        }
+        std::vector<HeightPyramid::Hit> hits(count), reference(reference_count);
+
+        double t_single = time_ms([&] {
+            for (size_t i = 0; i < count; ++i)
+                pyramid.raycast(rays[i].origin, rays[i].direction, rays[i].max_t, hits[i]);
+            }, 0.0);
+        double t_batch = time_ms([&] { pyramid.raycast(rays.data(), count, hits.data()); }, 0.0);
+        double t_reference = time_ms([&] {
+            for (size_t i = 0; i < reference_count; ++i)
+                pyramid.raycast_reference(rays[i].origin, rays[i].direction, rays[i].max_t, reference[i]);
+            }, 0.0);
+        size_t hit_count = 0, mismatches = 0;
+        float max_error = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+            hit_count += hits[i].hit;
+        for (size_t i = 0; i < reference_count; ++i) {
+            if (hits[i].hit != reference[i].hit)
+                ++mismatches;
+            else if (hits[i].hit)
+                max_error = std::max(max_error, glm::length(hits[i].position - reference[i].position));
+        }
+        std::cout << file << " " << heights.columns() << "x" << heights.rows() << ": build " << t_build << " ms, "
+            << pyramid.memory_bytes() / 1024 << " KB; " << count << " rays, " << hit_count * 100 / count << "% hits: pyramid "
+            << t_single * 1e6 / count << " ns, batch " << t_batch * 1e6 / count << " ns, cell walk " << t_reference * 1e6 / reference_count
+            << " ns per ray (" << t_reference * count / reference_count / t_batch << "x); vs. cell walk: " << mismatches
+            << " different, max distance " << max_error << '\n';
+    }
+}
+
+//------ Procedural terrain: noise samples scalar vs. AVX2, chunks (pager tiles) per second vs. threads ------
+static void bench_noise(void) {
+    std::cout << "--- procedural terrain (sample(): " << TerrainNoise::lanes() << " lanes) ---\n";
+    JobSystem& jobs = JobSystem::instance();
+    const int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const TerrainNoise noise;       // default settings, seed 1: the same terrain in every run
+    constexpr int samples = TerrainPager::tile_samples;
+
+    // one chunk, sample by sample vs. 8 at a time
+    std::vector<float> rows(samples * samples), columns(samples * samples), scalar(samples * samples), simd(samples * samples);
+    for (int i = 0; i < samples * samples; ++i) {
+        rows[i] = static_cast<float>(1000 + i / samples);
+        columns[i] = static_cast<float>(-3000 + i % samples);
+    }
+    double t_scalar = time_ms([&] {
+        for (int i = 0; i < samples * samples; ++i)
+            scalar[i] = noise.height(rows[i], columns[i]);
+        });
+    double t_simd = time_ms([&] { noise.sample(rows.data(), columns.data(), rows.size(), simd.data()); });
+    size_t different = 0;
+    for (int i = 0; i < samples * samples; ++i)
+        different += scalar[i] != simd[i];
+    std::cout << noise.parameters().octaves << " octaves + " << noise.parameters().warp_octaves << " x 2 warp octaves: scalar "
+        << t_scalar * 1e6 / rows.size() << " ns, sample() " << t_simd * 1e6 / rows.size() << " ns per height (" << t_scalar / t_simd
+        << "x), " << different << " different\n";
+
+    // 256 chunks of a 16 x 16 chunk area, in parallel (as the pager's loads, one job per chunk)
+    const int chunks = 256;
+    std::vector<float> heights(static_cast<size_t>(chunks) * samples * samples);
+    auto generate = [&] {
+        jobs.parallel_for(0, chunks, 1, [&](size_t first, size_t last) {
+            for (size_t chunk = first; chunk < last; ++chunk) {
+                float r[samples], c[samples];
+                for (int j = 0; j < samples; ++j) {
+                    r[j] = static_cast<float>(static_cast<int>(chunk / 16) * TerrainPager::tile_size - 1 + j);
+                    c[j] = static_cast<float>(static_cast<int>(chunk % 16) * TerrainPager::tile_size - 1 + j);
+                }
+                noise.grid(r, samples, c, samples, heights.data() + chunk * samples * samples);
+            }
+            });
+    };
+    std::vector<float> first_run;
+    double base = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = (threads < max_threads && threads * 2 > max_threads) ? max_threads : threads * 2) {
+        jobs.start(threads - 1);
+        double t = time_ms(generate, 0.5);
+        if (threads == 1) {
+            base = t;
+            first_run = heights;
+        }
+        std::cout << threads << " threads: " << chunks << " chunks of " << samples << "x" << samples << " in " << t << " ms, "
+            << chunks * 1000.0 / t << " chunks/s (" << base / t << "x), " << (heights == first_run ? "same" : "DIFFERENT")
+            << " heights as 1 thread\n";
+        if (threads == max_threads)
+            break;
+    }
+    jobs.start();   // back to the default thread count
+}
+
+//------ Thrown projectiles: one entity per projectile (movers, created and destroyed) vs. the SoA pool ------
+static void bench_projectiles(void) {
+    JobSystem& jobs = JobSystem::instance();
+    if (jobs.thread_count() == 0)
+        jobs.start();
+    std::cout << "--- projectiles (" << jobs.thread_count() << " threads, " << ProjectileSystem::lanes() << " lanes) ---\n";
+    Heightfield heights;
+    if (!Heightmap::load_heightfield("resources/heightmaps/ground_v5.jpeg", heights))
+        return;
+    HeightPyramid pyramid;
+    pyramid.build(heights);
+    const float step = 1.0f / 120.0f;
+    const int steps = 600;          // 5 s: both run the same simulation (the stepping is stateful, not time_ms())
+    const float top = heights.max_height();
+    auto run = [&](auto&& fn) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < steps; ++i)
+            fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / steps;
+    };
+
+    // thrown from above the terrain in any direction, a landed one is replaced at once: always 'count' in flight
+    for (size_t count : { 1000u, 4000u, 8000u }) {
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> px(-heights.rows() / 2.5f, heights.rows() / 2.5f);
+        std::uniform_real_distribution<float> pz(-heights.columns() / 2.5f, heights.columns() / 2.5f);
+        std::uniform_real_distribution<float> v(-10.0f, 10.0f);
+        auto start = [&] { return glm::vec3(px(rng), top + 5.0f, pz(rng)); };
+        auto velocity = [&] { return glm::vec3(v(rng), v(rng) * 0.5f, v(rng)); };
+        auto hit = [&](glm::vec3 const& from, glm::vec3 const& to, glm::vec3& point) {
+            HeightPyramid::Hit h;
+            if (!pyramid.segment(from, to, h))
+                return false;
+            point = h.position;
+            return true;
+        };
+
+        SceneGraph graph;
+        EntityStore store(graph);
+        SceneGraph::NodeId root = graph.create();
+        auto throw_entity = [&] {
+            Entity e = store.create("throwable_rock");
+            Transform t;
+            t.origin = start();
+            store.add_transform(e, t, root);
+            Mover m;
+            m.path = Mover::Path::Flight;
+            m.velocity = velocity();
+            store.movers.add(e, m);
+        };
+        for (size_t i = 0; i < count; ++i)
+            throw_entity();
+        std::vector<Entity> landed;
+        size_t landed_entities = 0;
+        double t_entities = run([&] {
+            landed.clear();
+            store.update_movers(step, glm::vec3(0.0f), [&](float x, float z) { return heights.height(x, z); },
+                [&](glm::vec3 const& from, glm::vec3 const& to) { glm::vec3 p; return hit(from, to, p); }, landed);
+            for (Entity e : landed) {
+                store.destroy(e);
+                throw_entity();
+            }
+            landed_entities += landed.size();
+            });
+
+        ProjectileSystem pool;
+        pool.create(count);
+        for (size_t i = 0; i < count; ++i)
+            pool.spawn(start(), velocity());
+        std::vector<ProjectileSystem::Impact> impacts;
+        impacts.reserve(count);
+        size_t landed_pool = 0;
+        double t_pool = run([&] {
+            impacts.clear();
+            pool.update(step, glm::vec3(0.0f),
+                [&](float* x, float* z, size_t n, float* out) { heights.sample(x, z, n, out); }, hit, nullptr, impacts);
+            while (pool.size() < count)
+                pool.spawn(start(), velocity());
+            landed_pool += impacts.size();
+            });
+        std::cout << count << " in flight, " << steps << " steps: entities " << t_entities << " ms per step (" << landed_entities
+            << " landed), pool " << t_pool << " ms (" << landed_pool << " landed), " << t_entities / t_pool << "x\n";
+    }
+}
+
+//------ Broadphase: insert, update (same cells / new cells), overlap and ray queries of the spatial hash, 1k to 100k trees ------
+static void bench_broadphase(void) {
+    std::cout << "--- broadphase ---\n";
+    // trees of 1 x 6 x 1 on an area that grows with the count: the same density (one per 25 m2) at every count
+    for (size_t count : { 1000u, 10000u, 100000u }) {
+        std::mt19937 rng(7);
+        const float half = std::sqrt(static_cast<float>(count) * 25.0f) / 2.0f;
+        std::uniform_real_distribution<float> position(-half, half);
+        std::vector<SpatialHash::Box> trees(count), moved(count), jumped(count);
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3 base(position(rng), 0.0f, position(rng));
+            trees[i] = SpatialHash::Box{ base - glm::vec3(0.5f, 0.0f, 0.5f), base + glm::vec3(0.5f, 6.0f, 0.5f) };
+            const glm::vec3 small(0.01f, 0.0f, 0.0f), large(4.0f, 0.0f, 0.0f);     // large: one cell over
+            moved[i] = SpatialHash::Box{ trees[i].min + small, trees[i].max + small };
+            jumped[i] = SpatialHash::Box{ trees[i].min + large, trees[i].max + large };
+        }
+
+        SpatialHash objects(4.0f);
+        std::vector<SpatialHash::Proxy> proxies(count);
+        double t_insert = time_ms([&] {
+            objects.clear();
+            for (size_t i = 0; i < count; ++i)
+                proxies[i] = objects.insert(trees[i], static_cast<std::uint32_t>(i));
+            });
+        bool flip = false;      // back and forth: every run moves all of them
+        double t_small = time_ms([&] {
+            flip = !flip;
+            for (size_t i = 0; i < count; ++i)
+                objects.update(proxies[i], flip ? moved[i] : trees[i]);
+            });
+        double t_jump = time_ms([&] {
+            flip = !flip;
+            for (size_t i = 0; i < count; ++i)
+                objects.update(proxies[i], flip ? jumped[i] : trees[i]);
+            });
+        for (size_t i = 0; i < count; ++i)
+            objects.update(proxies[i], trees[i]);
+
+        // queries: 4096 boxes of 2 m (blast radius), 8192 projectile steps of 1/120 s at 30 m/s, 1024 rays of 200 m
+        const size_t box_count = 4096, step_count = 8192, long_count = 1024;
+        std::uniform_real_distribution<float> height(0.0f, 8.0f), direction(-1.0f, 1.0f);
+        std::vector<SpatialHash::Box> boxes(box_count);
+        for (SpatialHash::Box& box : boxes) {
+            const glm::vec3 center(position(rng), height(rng), position(rng));
+            box = SpatialHash::Box{ center - glm::vec3(1.0f), center + glm::vec3(1.0f) };
+        }
+        auto rays = [&](size_t n, float length) {
+            std::vector<SpatialHash::Ray> out(n);
+            for (SpatialHash::Ray& ray : out) {
+                const glm::vec3 from(position(rng), height(rng), position(rng));
+                glm::vec3 d(direction(rng), direction(rng) * 0.2f, direction(rng));
+                d = glm::length(d) > 0.0f ? glm::normalize(d) : glm::vec3(1.0f, 0.0f, 0.0f);
+                ray = SpatialHash::Ray{ from, from + d * length, 0.1f };
+            }
+            return out;
+        };
+        const std::vector<SpatialHash::Ray> steps = rays(step_count, 30.0f / 120.0f), beams = rays(long_count, 200.0f);
+        std::vector<SpatialHash::Overlap> overlaps;
+        overlaps.reserve(box_count * 4);
+        std::vector<SpatialHash::RayHit> hits(step_count);
+        double t_overlap = time_ms([&] {
+            overlaps.clear();
+            objects.overlap(boxes.data(), box_count, overlaps);
+            });
+        double t_steps = time_ms([&] { objects.raycast(steps.data(), step_count, hits.data()); });
+        size_t step_hits = 0;
+        for (SpatialHash::RayHit const& hit : hits)
+            step_hits += hit.object != SpatialHash::no_object;
+        double t_beams = time_ms([&] { objects.raycast(beams.data(), long_count, hits.data()); });
+
+        // a sample against every object
+        size_t different = 0;
+        for (size_t i = 0; i < 256; ++i) {
+            const SpatialHash::RayHit grid = objects.raycast(beams[i]), reference = objects.raycast_reference(beams[i]);
+            different += grid.object != reference.object && std::abs(grid.t - reference.t) > 1e-5f;
+        }
+        const SpatialHash::Stats stats = objects.stats();
+        std::cout << count << " trees: insert " << t_insert * 1e6 / count << " ns, update " << t_small * 1e6 / count << " ns (same cells), "
+            << t_jump * 1e6 / count << " ns (new cells) per object; overlap " << t_overlap * 1e6 / box_count << " ns per box ("
+            << overlaps.size() << " pairs), steps " << t_steps * 1e6 / step_count << " ns (" << step_hits << " hits), 200 m rays "
+            << t_beams * 1e6 / long_count << " ns per ray; " << stats.buckets << " buckets, longest " << stats.longest << ", "
+            << different << "/256 different from all objects\n";
+    }
+}
+
+//------ GPU particles: update (simulate, compact, emit) and draw time per frame, 10k to 1M live particles ------
+// GL context of the GPU benchmarks: EGL without display; elsewhere a hidden window
+class BenchContext {
+public:
+    bool create(void) {
+#ifdef HEADLESS_EGL
+        if (!context.create()) {
+            std::cout << "skipped: no OpenGL context\n";
+            return false;
+        }
+#else
+        if (glfwInit()) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            window = glfwCreateWindow(64, 64, "bench", nullptr, nullptr);
+        }
+        if (!window) {
+            std::cout << "skipped: no OpenGL context\n";
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+#endif
+        GLenum glew = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        if (glew == GLEW_ERROR_NO_GLX_DISPLAY)
+            glew = GLEW_OK;     // GLEW built for GLX, the GL functions are loaded
+#endif
+        if (glew != GLEW_OK) {
+            std::cout << "skipped: GLEW failed\n";
+            return false;
+        }
+        std::cout << glGetString(GL_RENDERER) << '\n';
+        return true;
+    }
+    ~BenchContext() {
+#ifdef HEADLESS_EGL
+        context.destroy();
+#else
+        if (window)
+            glfwDestroyWindow(window);
+        glfwTerminate();
+#endif
+    }
+
+private:
+#ifdef HEADLESS_EGL
+    HeadlessContext context;
+#else
+    GLFWwindow* window = nullptr;
+#endif
+};
+
+// heights as TerrainLod::height_map(): one R32F texel per sample
+static GLuint height_texture(Heightfield const& heights) {
+    GLuint texture = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, 1, GL_R32F, heights.columns(), heights.rows());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, heights.row_stride());
+    glTextureSubImage2D(texture, 0, 0, 0, heights.columns(), heights.rows(), GL_RED, GL_FLOAT, heights.row_data(0));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void bench_particles(void) {
+    std::cout << "--- GPU particles ---\n";
+    BenchContext context;
+    if (!context.create())
+        return;
+
+    // 1280x720 color + depth target, the terrain heights as a texture (the collisions of the app) and a round sprite
+    const GLsizei width = 1280, height = 720;
+    GLuint color = 0, depth = 0, fbo = 0, height_map = 0, sprite = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &color);
+    glTextureStorage2D(color, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth);
+    glTextureStorage2D(depth, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, color, 0);
+    glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depth, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+
+    Heightfield heights;
+    if (!Heightmap::load_heightfield("resources/heightmaps/ground_v5.jpeg", heights))
+        return;
+    height_map = height_texture(heights);
+    const int sprite_size = 64;
+    std::vector<unsigned char> texels(sprite_size * sprite_size * 4);
+    for (int i = 0; i < sprite_size * sprite_size; ++i) {
+        const float u = (i % sprite_size + 0.5f) / sprite_size * 2.0f - 1.0f, v = (i / sprite_size + 0.5f) / sprite_size * 2.0f - 1.0f;
+        const float a = std::max(0.0f, 1.0f - std::sqrt(u * u + v * v));
+        texels[i * 4 + 0] = 255; texels[i * 4 + 1] = 160; texels[i * 4 + 2] = 64; texels[i * 4 + 3] = static_cast<unsigned char>(a * 255.0f);
+    }
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &sprite);
+    glTextureStorage3D(sprite, 1, GL_RGBA8, sprite_size, sprite_size, 1);
+    glTextureSubImage3D(sprite, 0, 0, 0, 0, sprite_size, sprite_size, 1, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 250.0f, 400.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(width) / height, 0.1f, 2000.0f);
+    GLuint queries[2];
+    glCreateQueries(GL_TIME_ELAPSED, 2, queries);
+    auto elapsed_ms = [](GLuint query) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);     // waits: the benchmark measures, nothing overlaps
+        return ns * 1e-6;
+    };
+
+    const float step = 1.0f / 60.0f;
+    const int frames = 30;
+    double base = 0.0;
+    for (size_t count : { 10000u, 30000u, 100000u, 300000u, 1000000u }) {
+        // 'count' long-lived sparks raining on the whole terrain, bouncing and sliding; every frame 1 % more as short
+        // flames (6 frames): each frame emits and compacts as the effects of the app do
+        ParticleSystem particles;
+        particles.create(count + count / 10);
+        particles.set_terrain(height_map, glm::vec2(heights.columns(), heights.rows()), glm::vec2(0.0f, 1.0f), glm::mat4(1.0f));
+        ParticleSystem::Emitter rain;
+        rain.kind = ParticleSystem::Kind::Spark;
+        rain.position = glm::vec3(0.0f, heights.max_height() + 20.0f, 0.0f);
+        rain.radius = std::min(heights.rows(), heights.columns()) * 0.45f;
+        rain.spread = 5.0f;
+        rain.lifetime = 1.0e6f;
+        rain.size = 0.3f;
+        ParticleSystem::Emitter flames;
+        flames.position = glm::vec3(0.0f, heights.max_height(), 0.0f);
+        flames.radius = rain.radius;
+        flames.lifetime = 0.1f;
+        flames.size = 1.0f;
+        particles.emit(rain, static_cast<int>(count));
+        for (int i = 0; i < 10; ++i) {      // warm-up, the sparks reach the terrain
+            particles.emit(flames, static_cast<int>(count / 100));
+            particles.update(step);
+        }
+
+        double update_ms = 0.0, draw_ms = 0.0;
+        glFinish();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            particles.emit(flames, static_cast<int>(count / 100));
+            glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+            particles.update(step);
+            glEndQuery(GL_TIME_ELAPSED);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBeginQuery(GL_TIME_ELAPSED, queries[1]);
+            particles.draw(glm::mat4(1.0f), view, projection, sprite, 0);
+            glEndQuery(GL_TIME_ELAPSED);
+            update_ms += elapsed_ms(queries[0]);
+            draw_ms += elapsed_ms(queries[1]);
+        }
+        glFinish();
+        // wall clock as well: software rasterizers defer the draw past its timer query
+        const double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+        update_ms /= frames;
+        draw_ms /= frames;
+        const ParticleSystem::Stats stats = particles.stats();
+        if (count == 10000u)
+            base = update_ms;
+        std::cout << stats.alive << " alive (" << count << " + flames): update " << update_ms << " ms (" << update_ms * 1e6 / stats.alive
+            << " ns per particle, " << update_ms / base << "x the 10k time), draw " << draw_ms << " ms, frame " << frame_ms << " ms (wall), "
+            << stats.dropped << " dropped\n";
+        particles.clear();
+    }
+
+    glDeleteQueries(2, queries);
+    glDeleteFramebuffers(1, &fbo);
+    GLuint textures[] = { color, depth, height_map, sprite };
+    glDeleteTextures(4, textures);
+}
+
+static void bench_fireflies(void) {
+    std::cout << "--- GPU firefly swarm ---\n";
+    BenchContext context;
+    if (!context.create())
+        return;
+    Heightfield heights;
+    if (!Heightmap::load_heightfield("resources/heightmaps/ground_v5.jpeg", heights))
+        return;
+    const GLuint height_map = height_texture(heights);
+    const glm::vec3 home(0.0f, heights.height(0.0f, 0.0f), 0.0f);
+    const glm::vec3 eye = home + glm::vec3(0.0f, 5.0f, 20.0f);
+
+    const GLsizei width = 1280, height = 720;
+    GLuint color = 0, depth = 0, fbo = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &color);
+    glTextureStorage2D(color, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth);
+    glTextureStorage2D(depth, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, color, 0);
+    glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depth, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    const glm::mat4 view = glm::lookAt(eye, home, glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(width) / height, 0.1f, 2000.0f);
+
+    GLuint queries[2];
+    glCreateQueries(GL_TIME_ELAPSED, 2, queries);
+    auto elapsed_ms = [](GLuint query) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        return ns * 1e-6;
+    };
+
+    const float step = 1.0f / 60.0f;
+    const int frames = 30;
+    double base = 0.0;
+    for (size_t count : { 1024u, 4096u, 16384u, 65536u }) {
+        // the home circle grows with the swarm: the same density, so the same neighbours per firefly
+        FireflySwarm swarm;
+        swarm.create(count, home, 30.0f * std::sqrt(count / 4096.0f));
+        swarm.set_terrain(height_map, glm::vec2(heights.columns(), heights.rows()), glm::vec2(0.0f, 1.0f), glm::mat4(1.0f));
+        for (int i = 0; i < 30; ++i)        // warm-up, the swarm forms groups
+            swarm.update(step, glm::mat4(1.0f), eye);
+
+        double update_ms = 0.0, draw_ms = 0.0;
+        glFinish();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+            swarm.update(step, glm::mat4(1.0f), eye);
+            glEndQuery(GL_TIME_ELAPSED);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBeginQuery(GL_TIME_ELAPSED, queries[1]);
+            swarm.draw_glow(glm::mat4(1.0f), view, projection);
+            glEndQuery(GL_TIME_ELAPSED);
+            update_ms += elapsed_ms(queries[0]);
+            draw_ms += elapsed_ms(queries[1]);
+        }
+        glFinish();
+        const double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+        update_ms /= frames;
+        draw_ms /= frames;
+        if (count == 1024u)
+            base = update_ms;
+        std::cout << count << " fireflies: simulation " << update_ms << " ms (" << update_ms * 1e6 / count << " ns per firefly, "
+            << update_ms / base << "x the 1k time), glow " << draw_ms << " ms, frame " << frame_ms << " ms (wall)\n";
+        swarm.clear();
+    }
+
+    glDeleteQueries(2, queries);
+    glDeleteFramebuffers(1, &fbo);
+    GLuint textures[] = { color, depth, height_map };
+    glDeleteTextures(3, textures);
+}
+
+int run_benchmarks(std::string const& name) {
+    bool all = (name == "all");
+    bool found = false;
+    if (all || name == "transform") { bench_transform(); found = true; }
+    if (all || name == "entities") { bench_entities(); found = true; }
+    if (all || name == "jobs") { bench_jobs(); found = true; }
+    if (all || name == "terrain") { bench_terrain(); found = true; }
+    if (all || name == "heightfield") { bench_heightfield(); found = true; }
+    if (all || name == "raycast") { bench_raycast(); found = true; }
+    if (all || name == "noise") { bench_noise(); found = true; }
+    if (all || name == "projectiles") { bench_projectiles(); found = true; }
+    if (all || name == "broadphase") { bench_broadphase(); found = true; }
+    if (all || name == "particles") { bench_particles(); found = true; }
+    if (all || name == "fireflies") { bench_fireflies(); found = true; }
+
+    if (!found) {
+        std::cerr << "Unknown benchmark: " << name << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
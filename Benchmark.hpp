@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Microbenchmarks, started with: my_app.exe --bench <name>   (or "all")
+int run_benchmarks(std::string const& name);
+
+// Runs fn() repeatedly for at least min_seconds and returns the average time of one call in milliseconds
+template <class Fn>
+double time_ms(Fn&& fn, double min_seconds = 0.25) {
+    using Clock = std::chrono::high_resolution_clock;
+    fn(); // warm-up
+    int runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++runs;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < min_seconds);
+    return elapsed * 1000.0 / runs;
+}
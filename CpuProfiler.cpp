@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <nlohmann/json.hpp>
+
+#include "CpuProfiler.hpp"
+
+CpuProfiler::ThreadBuffer& CpuProfiler::local_buffer(void) {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {  // first zone of this thread: register its ring (buffers live until the end of the program)
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->tid = static_cast<int>(buffers.size());
+        buffer->name = "thread " + std::to_string(buffer->tid);
+    }
+    return *buffer;
+}
+
+void CpuProfiler::set_thread_name(std::string const& name) {
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer.name = name;
+}
+
+void CpuProfiler::record(const char* name, std::int64_t start_ns, std::int64_t end_ns) {
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(buffer.lock);
+    buffer.events[buffer.written % ring_size] = Event{ name, start_ns, end_ns };
+    ++buffer.written;
+}
+
+bool CpuProfiler::write_chrome_trace(std::filesystem::path const& file, double seconds) const {
+    const std::int64_t now = now_ns();
+    const std::int64_t since = now - static_cast<std::int64_t>(seconds * 1.0e9);
+
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Event> snapshot;
+        snapshot.reserve(ring_size);
+        for (auto const& buffer : buffers) {
+            events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 0 }, { "tid", buffer->tid },
+                { "args", { { "name", buffer->name } } } });
+
+            // the other threads keep recording: copy the ring, oldest first, while holding its lock only that long
+            snapshot.clear();
+            {
+                std::lock_guard<std::mutex> ring_lock(buffer->lock);
+                const size_t written = buffer->written;
+                for (size_t i = (written > ring_size) ? written - ring_size : 0; i < written; ++i)
+                    snapshot.push_back(buffer->events[i % ring_size]);
+            }
+            for (Event const& e : snapshot) {
+                if (e.end_ns < since)
+                    continue;
+                events.push_back({ { "name", e.name }, { "ph", "X" }, { "pid", 0 }, { "tid", buffer->tid },
+                    { "ts", (e.start_ns - since) / 1000.0 }, { "dur", (e.end_ns - e.start_ns) / 1000.0 } });
+            }
+        }
+    }
+
+    std::ofstream out(file);
+    if (!out) {
+        std::cerr << "Can not write CPU trace: " << file << '\n';
+        return false;
+    }
+    nlohmann::json trace = { { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+    out << trace.dump();
+    std::cout << "CPU trace of the last " << seconds << " s written to " << file << '\n';
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU time of named scopes (zones) on all threads, exported as a chrome://tracing / Perfetto JSON trace.
+//
+//   CPU_ZONE("scene update");      // measures until the end of the enclosing block
+//
+// Every thread writes into its own ring buffer under the buffer's own lock (uncontended but while a trace is written,
+// which copies each ring under its lock), the ring keeps the last ring_size zones of the thread.
+// When the profiler is disabled at runtime a zone costs one relaxed atomic load,
+// when compiled with CPU_PROFILER_DISABLED the zones disappear completely.
+class CpuProfiler {
+public:
+    static constexpr size_t ring_size = 1 << 16;   // zones per thread
+
+    struct Event {
+        const char* name;       // string literal
+        std::int64_t start_ns;
+        std::int64_t end_ns;
+    };
+
+    class Zone {
+    public:
+        explicit Zone(const char* name) : name(name), start_ns(CpuProfiler::instance().enabled() ? now_ns() : -1) {}
+        ~Zone() {
+            if (start_ns >= 0)
+                CpuProfiler::instance().record(name, start_ns, now_ns());
+        }
+        Zone(Zone const&) = delete;
+        Zone& operator=(Zone const&) = delete;
+    private:
+        const char* name;
+        std::int64_t start_ns;
+    };
+
+    static CpuProfiler& instance(void) {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    static std::int64_t now_ns(void) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool enabled(void) const { return on.load(std::memory_order_relaxed); }
+    void set_enabled(bool enable) { on.store(enable, std::memory_order_relaxed); }
+
+    void set_thread_name(std::string const& name);  // shown as the track name in the trace
+    void record(const char* name, std::int64_t start_ns, std::int64_t end_ns);
+
+    // write the zones that ended in the last 'seconds' seconds (of all threads)
+    bool write_chrome_trace(std::filesystem::path const& file, double seconds) const;
+
+private:
+    struct ThreadBuffer {
+        std::mutex lock;                    // the owning thread while recording, write_chrome_trace() while copying
+        std::array<Event, ring_size> events{};
+        size_t written = 0;                 // total number of recorded zones, the ring holds the last ring_size
+        std::string name;
+        int tid = 0;
+    };
+
+    CpuProfiler(void) = default;
+    ThreadBuffer& local_buffer(void);
+
+    std::atomic<bool> on{ false };
+    mutable std::mutex mutex;                           // guards the list of buffers and their names
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers{};
+};
+
+#define CPU_ZONE_CONCAT2(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT2(a, b)
+#ifdef CPU_PROFILER_DISABLED
+#define CPU_ZONE(name) ((void)0)
+#else
+#define CPU_ZONE(name) CpuProfiler::Zone CPU_ZONE_CONCAT(cpu_zone_, __LINE__)(name)
+#endif
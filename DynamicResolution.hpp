@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <GL/glew.h>
+
+// Resolution scale of the 3D scene, adjusted from the measured GPU frame time against a budget.
+// The fragment cost grows with the pixel count (scale^2), so the controller jumps to the scale that is expected
+// to fit the budget instead of creeping. Hysteresis: nothing changes while the GPU time is inside
+// [grow_below, budget], growing is limited to grow_step per change, and after every change it waits
+// cooldown_frames measurements (the GPU times arrive a few frames late).
+//
+// The scene is rendered into the lower left part of full size targets (scaled() x scaled()), so changing the scale
+// never reallocates textures; the present pass upscales that part to the window.
+class DynamicResolution {
+public:
+    double budget_ms = 12.0;        // GPU time of a frame, leaves room for the CPU/driver at 60 Hz
+    double grow_below = 0.75;       // grow only when the GPU time is below this fraction of the budget
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    float grow_step = 0.05f;        // largest increase per change
+    int cooldown_frames = 8;
+
+    float scale(void) const { return current; }
+    bool locked(void) const { return is_locked; }
+    void lock(float scale) { current = std::clamp(scale, 0.1f, 1.0f); is_locked = true; }
+    void unlock(void) { is_locked = false; cooldown = cooldown_frames; }
+
+    // feed one GPU frame time (only frames that were really measured), returns the new scale
+    float update(double gpu_ms) {
+        if (is_locked || gpu_ms <= 0.0)
+            return current;
+        if (cooldown > 0) {
+            --cooldown;
+            return current;
+        }
+        if (gpu_ms <= budget_ms && gpu_ms >= budget_ms * grow_below)
+            return current;     // inside the band
+
+        // aim a little below the budget, so the next frame is not right at the edge again
+        float wanted = current * static_cast<float>(std::sqrt(0.9 * budget_ms / gpu_ms));
+        wanted = std::min(wanted, current + grow_step);
+        wanted = std::clamp(std::round(wanted * 64.0f) / 64.0f, min_scale, max_scale);    // fewer distinct sizes
+        if (wanted != current) {
+            current = wanted;
+            cooldown = cooldown_frames;
+        }
+        return current;
+    }
+
+    GLsizei scaled(GLsizei full_size) const { return std::max<GLsizei>(1, static_cast<GLsizei>(std::lround(full_size * current))); }
+
+private:
+    float current = 1.0f;
+    bool is_locked = false;
+    int cooldown = 0;
+};
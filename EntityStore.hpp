@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <glm/glm.hpp>
+
+#include "SceneGraph.hpp"
+#include "Model.hpp"
+#include "JobSystem.hpp"
+#include "SpatialHash.hpp"
+
+// Handle of an entity: slot index + generation of the slot.
+// When an entity is destroyed the generation of its slot is increased, so old handles never resolve to a new entity.
+struct Entity {
+    std::uint32_t index = UINT32_MAX;
+    std::uint32_t generation = 0;
+
+    bool operator==(Entity const& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(Entity const& other) const { return !(*this == other); }
+};
+
+// Dense storage of one component type.
+// The components are packed into a contiguous array that the systems iterate directly,
+// the sparse array maps an entity slot to the position of its component in the dense array.
+template <class T>
+class ComponentArray {
+public:
+    std::vector<T> data{};           // dense, contiguous components
+    std::vector<Entity> owners{};    // owners[i] is the entity of data[i]
+
+    size_t size(void) const { return data.size(); }
+
+    T& add(Entity e, T const& value) {
+        if (T* existing = get(e)) {
+            *existing = value;
+            return *existing;
+        }
+        if (e.index >= sparse.size())
+            sparse.resize(e.index + 1, no_slot);
+        sparse[e.index] = static_cast<std::uint32_t>(data.size());
+        data.push_back(value);
+        owners.push_back(e);
+        return data.back();
+    }
+
+    void remove(Entity e) {
+        if (!get(e))
+            return;
+        // move the last component into the hole, so the array stays dense
+        std::uint32_t slot = sparse[e.index];
+        std::uint32_t last = static_cast<std::uint32_t>(data.size() - 1);
+        if (slot != last) {
+            data[slot] = std::move(data[last]);
+            owners[slot] = owners[last];
+            sparse[owners[slot].index] = slot;
+        }
+        data.pop_back();
+        owners.pop_back();
+        sparse[e.index] = no_slot;
+    }
+
+    T* get(Entity e) {
+        if (e.index >= sparse.size() || sparse[e.index] == no_slot || owners[sparse[e.index]].generation != e.generation)
+            return nullptr;
+        return &data[sparse[e.index]];
+    }
+    T const* get(Entity e) const { return const_cast<ComponentArray*>(this)->get(e); }
+    bool has(Entity e) const { return get(e) != nullptr; }
+
+private:
+    static constexpr std::uint32_t no_slot = UINT32_MAX;
+    std::vector<std::uint32_t> sparse{};
+};
+
+//------ Components ------
+struct Transform {
+    glm::vec3 origin{ 0.0f };
+    glm::vec3 orientation{ 0.0f };  //rotation by x,y,z axis, in radians
+    glm::vec3 scale{ 1.0f };
+    SceneGraph::NodeId node = SceneGraph::no_node; // cached world and normal matrix
+};
+
+struct Renderable {
+    Model* model = nullptr;   // meshes and texture, shared by all entities using the same model
+};
+
+struct Mover {
+    enum class Path { Circle, Flight };
+    Path path = Path::Circle;
+
+    // circle path
+    glm::vec3 center{ 0.0f };
+    float radius = 10.0f;           // circle radius
+    float angular_speed = 1.0f;     // radians per second
+    float angle = 0.0f;             // current angle around the circle
+
+    static constexpr float steering_rate = 60.0f;   // the steering input is an offset per 1/60 s
+
+    // flight path (thrown objects)
+    glm::vec3 velocity{ 0.0f };
+    glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+
+    int light = -1;                 // index of the light that follows this entity, -1 = none
+
+    // fixed-step simulation: origin before the last step, rendering interpolates between it and the current origin
+    glm::vec3 previous{ 0.0f };
+    bool stepped = false;           // false until the first step (nothing to interpolate from)
+
+    // update position etc. based on running time
+    void circlepath(glm::vec3& origin, float delta_t, float height) {
+        // advance angle
+        angle += angular_speed * delta_t;
+
+        // wrap around if too large
+        if (angle > glm::two_pi<float>())
+            angle -= glm::two_pi<float>();
+
+        // compute new position
+        origin.x = center.x + radius * cos(angle);
+        origin.z = center.z + radius * sin(angle);
+        origin.y = height + 0.5f;
+    }
+
+    void flyghtpath(glm::vec3& origin, float delta_t, glm::vec3 input) {
+        velocity += gravity * delta_t;
+        origin.x += input.x * steering_rate * delta_t + velocity.x * delta_t;
+        origin.y += velocity.y * delta_t;
+        origin.z += velocity.z * delta_t;
+    }
+};
+
+// transparency = final fragment alpha < 1.0; this can happen usually because -> model has transparent material -> model has transparent texture
+struct Transparency {
+    glm::vec4 color{ 1.0f, 1.0f, 1.0f, 0.1f };
+};
+
+// Box of the entity in the broadphase of the store (projectiles, picking)
+struct Collider {
+    glm::vec3 min{ 0.0f };          // in the space of the entity, e.g. the bounds of its model
+    glm::vec3 max{ 0.0f };
+    SpatialHash::Proxy proxy = SpatialHash::no_proxy;
+};
+
+// One draw of the render system
+struct DrawItem {
+    Model* model = nullptr;
+    SceneGraph::NodeId node = SceneGraph::no_node;
+    int layer = -1;                 // layer of the texture array, -1 = the model's own
+    glm::vec4 color{ 1.0f };
+    float distance = 0.0f;          // distance from the camera (transparent objects only)
+};
+
+// All objects of the scene: generational entity handles + dense component arrays.
+// Systems iterate the component arrays; the name lookup is only meant for setup and debugging.
+class EntityStore {
+public:
+    ComponentArray<Transform> transforms;
+    ComponentArray<Renderable> renderables;
+    ComponentArray<Mover> movers;
+    ComponentArray<Transparency> transparency;
+    ComponentArray<int> texture_layers;     // texture array layer, overrides the layer of the model
+    ComponentArray<Collider> colliders;
+    SpatialHash broadphase{ 4.0f };         // boxes of the colliders, object = entity index (see entity())
+
+    explicit EntityStore(SceneGraph& graph) : graph(graph) {}
+
+    Entity create(std::string const& name = "") {
+        Entity e;
+        if (!free_slots.empty()) {
+            e.index = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            e.index = static_cast<std::uint32_t>(generations.size());
+            generations.push_back(0);
+            names.emplace_back();
+        }
+        e.generation = generations[e.index];
+        names[e.index] = name;
+        if (!name.empty())
+            name_lookup[name] = e;
+        ++count;
+        return e;
+    }
+
+    void destroy(Entity e) {
+        if (!alive(e))
+            return;
+        if (Transform* t = transforms.get(e))
+            graph.destroy(t->node);
+        transforms.remove(e);
+        renderables.remove(e);
+        movers.remove(e);
+        transparency.remove(e);
+        texture_layers.remove(e);
+        if (Collider const* c = colliders.get(e))
+            broadphase.remove(c->proxy);
+        colliders.remove(e);
+
+        auto found = name_lookup.find(names[e.index]);
+        if (found != name_lookup.end() && found->second == e)
+            name_lookup.erase(found);
+        names[e.index].clear();
+        ++generations[e.index];
+        free_slots.push_back(e.index);
+        --count;
+    }
+
+    bool alive(Entity e) const { return e.index < generations.size() && generations[e.index] == e.generation; }
+    Entity entity(std::uint32_t index) const { return index < generations.size() ? Entity{ index, generations[index] } : Entity{}; }  // live entity of a slot
+    size_t size(void) const { return count; }
+
+    // add the transform component together with its scene graph node
+    Transform& add_transform(Entity e, Transform t, SceneGraph::NodeId parent = SceneGraph::no_node) {
+        t.node = graph.create(parent);
+        graph.setLocal(t.node, t.origin, t.orientation, t.scale);
+        return transforms.add(e, t);
+    }
+
+    // push the transform of an entity to the scene graph after it was changed
+    void update_transform(Entity e) {
+        if (Transform* t = transforms.get(e))
+            graph.setLocal(t->node, t->origin, t->orientation, t->scale);
+    }
+
+    // collider from the box in the space of the entity; space: world -> space of the broadphase (e.g. inverse of the world root).
+    // Uses the cached world matrix, so the scene graph must be up to date.
+    void add_collider(Entity e, glm::vec3 const& min, glm::vec3 const& max, glm::mat4 const& space) {
+        Transform const* t = transforms.get(e);
+        if (!t || colliders.has(e))
+            return;
+        Collider c{ min, max };
+        c.proxy = broadphase.insert(SpatialHash::transform(SpatialHash::Box{ min, max }, space * graph.world(t->node)), e.index);
+        colliders.add(e, c);
+    }
+
+    //------ Name lookup: setup and debugging only ------
+    Entity find(std::string const& name) const {
+        auto found = name_lookup.find(name);
+        return (found != name_lookup.end()) ? found->second : Entity{};
+    }
+    std::string const& name(Entity e) const { return names[e.index]; }
+
+    //------ Systems ------
+    // One simulation step of all entities with a mover component. Thrown objects that hit the terrain are reported in 'landed':
+    // terrain_hit(from, to) tests the whole step (no tunneling through ridges at high speed), below terrain_height() counts too.
+    // Only the simulated state changes, interpolate_movers() pushes the rendered transforms to the scene graph.
+    // Movers are independent, large counts are split over the job system (the terrain functions must be thread-safe).
+    template <class HeightFn, class HitFn>
+    void update_movers(float delta_t, glm::vec3 const& steering, HeightFn&& terrain_height, HitFn&& terrain_hit, std::vector<Entity>& landed) {
+        std::mutex landed_mutex;
+        JobSystem::instance().parallel_for(0, movers.size(), 512, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                Mover& mover = movers.data[i];
+                Entity e = movers.owners[i];
+                Transform* t = transforms.get(e);
+                if (!t)
+                    continue;
+
+                mover.previous = t->origin;
+                mover.stepped = true;
+                if (mover.path == Mover::Path::Circle) {
+                    float height = terrain_height(t->origin.x, t->origin.z);
+                    mover.circlepath(t->origin, delta_t, height);
+                }
+                else {
+                    mover.flyghtpath(t->origin, delta_t, steering);
+                    if (terrain_hit(mover.previous, t->origin) || t->origin.y < terrain_height(t->origin.x, t->origin.z)) {
+                        std::lock_guard<std::mutex> lock(landed_mutex);
+                        landed.push_back(e);
+                    }
+                }
+            }
+            });
+        // independent of the thread count, so the destroyed slots are reused in a reproducible order
+        std::sort(landed.begin(), landed.end(), [](Entity a, Entity b) { return a.index < b.index; });
+    }
+
+    // Colliders of the movers at their simulated transforms (after update_movers(), the rendered ones lag behind);
+    // the parents are taken from the scene graph. Only objects that leave their cells are re-binned.
+    void update_colliders(glm::mat4 const& space) {
+        for (size_t i = 0; i < movers.size(); ++i) {
+            Entity e = movers.owners[i];
+            Collider const* c = colliders.get(e);
+            Transform const* t = transforms.get(e);
+            if (!c || !t)
+                continue;
+            const SceneGraph::NodeId parent = graph.parent(t->node);
+            const glm::mat4 local = TransformKernel::compose(t->origin, t->orientation, t->scale);
+            const glm::mat4 to_space = parent != SceneGraph::no_node ? space * graph.world(parent) * local : space * local;
+            broadphase.update(c->proxy, SpatialHash::transform(SpatialHash::Box{ c->min, c->max }, to_space));
+        }
+    }
+
+    // Rendered transforms of the movers: 'alpha' of the way from the previous to the current simulation step
+    void interpolate_movers(float alpha) {
+        for (size_t i = 0; i < movers.size(); ++i) {
+            Mover const& mover = movers.data[i];
+            Transform const* t = transforms.get(movers.owners[i]);
+            if (!t)
+                continue;
+            glm::vec3 origin = mover.stepped ? glm::mix(mover.previous, t->origin, alpha) : t->origin;
+            graph.setLocal(t->node, origin, t->orientation, t->scale);
+        }
+    }
+
+    // Collect the draws of all renderable entities: opaque in any order, transparent sorted from far to near (painter's algorithm)
+    void build_draw_lists(glm::vec3 const& eye, std::vector<DrawItem>& opaque, std::vector<DrawItem>& transparent) const {
+        opaque.clear();
+        transparent.clear();
+        for (size_t i = 0; i < renderables.size(); ++i) {
+            Entity e = renderables.owners[i];
+            Transform const* t = transforms.get(e);
+            if (!t)
+                continue;
+
+            DrawItem item;
+            item.model = renderables.data[i].model;
+            item.node = t->node;
+            if (int const* layer = texture_layers.get(e)) {
+                item.layer = *layer;
+            }
+            if (Transparency const* tr = transparency.get(e)) {
+                item.color = tr->color;
+                item.distance = glm::distance(eye, glm::vec3(graph.world(t->node)[3]));  // translation = last column of model matrix
+                transparent.push_back(item);
+            }
+            else {
+                opaque.push_back(item);
+            }
+        }
+        std::sort(transparent.begin(), transparent.end(), [](DrawItem const& a, DrawItem const& b) {
+            return a.distance > b.distance;
+            });
+    }
+
+private:
+    SceneGraph& graph;
+    std::vector<std::uint32_t> generations{};
+    std::vector<std::uint32_t> free_slots{};
+    std::vector<std::string> names{};
+    std::unordered_map<std::string, Entity> name_lookup{};
+    size_t count = 0;
+};
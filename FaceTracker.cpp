@@ -1,4 +1,5 @@
 #include "FaceTracker.hpp"
+#include "CpuProfiler.hpp"
 #include <algorithm>   // std::max_element
 #include <iostream>    // std::cerr
 
@@ -102,15 +103,25 @@ std::optional<FaceResult> FaceTracker::getLatest(std::uint64_t& last_seq) const
 // Worker internals
 // ------------------------
 void FaceTracker::trackerThreadLoop() {
+    CpuProfiler::instance().set_thread_name("face tracker");
     while (!stopRequested_.load(std::memory_order_relaxed)) {
         cv::Mat frame;
-        if (!capture_.read(frame) || frame.empty()) {
+        bool captured;
+        {
+            CPU_ZONE("camera capture");
+            captured = capture_.read(frame);
+        }
+        if (!captured || frame.empty()) {
             endOfStream_.store(true, std::memory_order_relaxed);
             break;
         }
 
         cv::Point2f center_px, center_norm;
-        const bool found = detectFaceCenter(frame, center_px, center_norm);
+        bool found;
+        {
+            CPU_ZONE("face detection");
+            found = detectFaceCenter(frame, center_px, center_norm);
+        }
 
         // Publish the latest result atomically
         lastFaceFound_.store(found, std::memory_order_relaxed);
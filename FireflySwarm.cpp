@@ -0,0 +1,253 @@
+// Buffers, passes and drawing of the firefly swarm, see FireflySwarm.hpp
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "FireflySwarm.hpp"
+
+namespace {
+    // firefly_swarm.comp: swarm_pass
+    constexpr int bin_pass = 0;
+    constexpr int scan_pass = 1;
+    constexpr int scatter_pass = 2;
+    constexpr int flock_pass = 3;
+    constexpr int classify_pass = 4;
+    constexpr int select_pass = 5;
+    constexpr int gather_pass = 6;
+
+    struct Firefly {                // std430 layout of firefly_swarm.comp
+        glm::vec4 position;         // xyz, blink phase 0..1
+        glm::vec4 velocity;         // xyz, brightness 0..1
+    };
+    constexpr size_t command_bytes = 5 * sizeof(GLuint);       // DrawElementsIndirectCommand
+    constexpr size_t selection_header = 8;                      // uints before the histogram
+    constexpr size_t light_bytes = 2 * sizeof(glm::vec4);      // position, color
+}
+
+void FireflySwarm::create(size_t count, glm::vec3 const& home, float home_radius) {
+    clear();
+    this->count = std::min(count, max_size());
+    if (this->count < count)
+        std::cerr << "Swarm of " << count << " fireflies is over the limit of this GPU, using " << this->count << '\n';
+    count = this->count;
+    this->home = home;
+    this->home_radius = home_radius;
+    time = 0.0f;
+    compute = ShaderProgram("firefly_swarm.comp");
+    glow = ShaderProgram("firefly_glow.vert", "firefly_glow.frag");
+
+    // grid over the home circle and a margin, 32 cells high around the home height; positions outside are clamped
+    const int side = static_cast<int>(std::ceil(2.0f * home_radius / cell_size)) + 8;
+    grid_size = glm::ivec3(side, 32, side);
+    grid_origin = home - glm::vec3(side * 0.5f, 12.0f, side * 0.5f) * cell_size;
+    cells = static_cast<GLuint>(grid_size.x * grid_size.y * grid_size.z);
+
+    // the same swarm in every run
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Firefly> fireflies(count);
+    for (Firefly& f : fireflies) {
+        const float r = home_radius * std::sqrt(unit(rng));
+        const float a = 6.2831853f * unit(rng);
+        const float heading = 6.2831853f * unit(rng);
+        f.position = glm::vec4(home + glm::vec3(r * std::cos(a), hover.x + (hover.y - hover.x) * unit(rng), r * std::sin(a)), unit(rng));
+        f.velocity = glm::vec4(std::cos(heading) * min_speed, 0.0f, std::sin(heading) * min_speed, 0.0f);
+    }
+    const size_t capacity = std::max<size_t>(count, 1);
+    glCreateBuffers(1, &firefly_buffer);
+    glObjectLabel(GL_BUFFER, firefly_buffer, -1, "Fireflies");
+    glNamedBufferStorage(firefly_buffer, capacity * sizeof(Firefly), fireflies.data(), 0);
+    glCreateBuffers(1, &sorted_buffer);
+    glObjectLabel(GL_BUFFER, sorted_buffer, -1, "FirefliesSorted");
+    glNamedBufferStorage(sorted_buffer, capacity * sizeof(Firefly), nullptr, 0);
+    glCreateBuffers(1, &grid_buffer);
+    glObjectLabel(GL_BUFFER, grid_buffer, -1, "FireflyGrid");
+    glNamedBufferStorage(grid_buffer, (2 * static_cast<size_t>(cells) + capacity) * sizeof(GLuint), nullptr, 0);
+    glCreateBuffers(1, &selection_buffer);
+    glObjectLabel(GL_BUFFER, selection_buffer, -1, "FireflySelection");
+    glNamedBufferStorage(selection_buffer, (selection_header + histogram_bins) * sizeof(GLuint), nullptr, 0);
+    glCreateBuffers(1, &instance_buffer);
+    glObjectLabel(GL_BUFFER, instance_buffer, -1, "FireflyInstances");
+    glNamedBufferStorage(instance_buffer, capacity * sizeof(glm::vec4), nullptr, 0);
+    glCreateBuffers(1, &command_buffer);
+    glObjectLabel(GL_BUFFER, command_buffer, -1, "FireflyCommands");
+    glNamedBufferStorage(command_buffer, max_commands * command_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    create_lights();
+    const GLuint zero = 0;
+    glClearNamedBufferData(command_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glCreateVertexArrays(1, &empty_vao);
+    command_model = nullptr;
+}
+
+// one SSBO binding of the swarm, one invocation per firefly in the x groups of a dispatch, and the int 'firefly_count'
+size_t FireflySwarm::max_size(void) {
+    GLint64 block_bytes = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &block_bytes);
+    GLint groups = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &groups);
+    return std::min({ static_cast<size_t>(std::max<GLint64>(block_bytes, 0)) / sizeof(Firefly),
+        static_cast<size_t>(std::max(groups, 0)) * group_size, static_cast<size_t>(std::numeric_limits<int>::max()) });
+}
+
+void FireflySwarm::create_lights(void) {
+    if (light_buffer)
+        glDeleteBuffers(1, &light_buffer);
+    glCreateBuffers(1, &light_buffer);
+    glObjectLabel(GL_BUFFER, light_buffer, -1, "FireflyLights");
+    glNamedBufferStorage(light_buffer, 4 * sizeof(GLuint) + static_cast<size_t>(std::max(lights, 1)) * light_bytes, nullptr, 0);
+    const GLuint zero = 0;
+    glClearNamedBufferData(light_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);    // no lights before the next update
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, light_binding, light_buffer);                    // in place of the deleted one
+}
+
+void FireflySwarm::set_light_count(int lights) {
+    lights = std::max(lights, 0);
+    if (lights == this->lights)
+        return;
+    this->lights = lights;
+    if (ready())
+        create_lights();
+}
+
+void FireflySwarm::clear(void) {
+    GLuint buffers[] = { firefly_buffer, sorted_buffer, grid_buffer, selection_buffer, instance_buffer, command_buffer, light_buffer };
+    for (GLuint& buffer : buffers) {
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    }
+    if (empty_vao)
+        glDeleteVertexArrays(1, &empty_vao);
+    if (compute.getID())
+        compute.clear();
+    if (glow.getID())
+        glow.clear();
+    firefly_buffer = sorted_buffer = grid_buffer = selection_buffer = instance_buffer = command_buffer = light_buffer = empty_vao = 0;
+    command_model = nullptr;
+    count = 0;
+    terrain_texture = 0;
+}
+
+void FireflySwarm::set_terrain(GLuint height_map, glm::vec2 const& size, glm::vec2 const& range, glm::mat4 const& model) {
+    terrain_texture = height_map;
+    terrain_size = size;
+    terrain_range = range;
+    terrain_model = model;
+}
+
+void FireflySwarm::update(float delta_t, glm::mat4 const& model_matrix, glm::vec3 const& eye) {
+    if (!ready())
+        return;
+    delta_t = std::min(delta_t, 1.0f / 20.0f);     // a long frame does not throw the swarm apart
+    time += delta_t;
+
+    const GLuint zero = 0;
+    glClearNamedBufferSubData(grid_buffer, GL_R32UI, 0, cells * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glClearNamedBufferData(selection_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    compute.activate();
+    compute.setUniform("firefly_count", static_cast<int>(count));
+    compute.setUniform("delta_t", delta_t);
+    compute.setUniform("time", time);
+    compute.setUniform("grid_size", glm::vec3(grid_size));      // cells, whole numbers
+    compute.setUniform("grid_origin", grid_origin);
+    compute.setUniform("cell_size", cell_size);
+    compute.setUniform("max_neighbours", max_neighbours);
+    compute.setUniform("separation_distance", separation_distance);
+    compute.setUniform("weights", glm::vec4(separation, alignment, cohesion, wander));
+    compute.setUniform("speed", glm::vec2(min_speed, max_speed));
+    compute.setUniform("home", glm::vec4(home, home_radius));
+    compute.setUniform("hover", hover);
+    compute.setUniform("blink", glm::vec2(1.0f / blink_period, coupling));
+    compute.setUniform("eye", glm::vec3(glm::inverse(model_matrix) * glm::vec4(eye, 1.0f)));
+    compute.setUniform("light_transform", model_matrix);
+    compute.setUniform("lod_distance", lod_distance);
+    compute.setUniform("scale", scale);
+    compute.setUniform("instance_transform", glm::inverse(orientation));   // draw() applies the orientation again
+    compute.setUniform("light_count", lights);
+    compute.setUniform("light_color", color * light_intensity);
+    compute.setUniform("light_falloff", light_falloff);
+    compute.setUniform("command_count", max_commands);
+    compute.setUniform("terrain_enabled", terrain_texture ? 1 : 0);
+    if (terrain_texture) {
+        compute.setUniform("height_map_size", terrain_size);
+        compute.setUniform("height_map_range", terrain_range);
+        compute.setUniform("terrain_model", terrain_model);
+        compute.setUniform("terrain_inverse", glm::inverse(terrain_model));
+        glBindTextureUnit(1, terrain_texture);  // height_map, binding 1 as in lighting_shader
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, firefly_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sorted_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, grid_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, selection_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, instance_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, light_binding, light_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, command_buffer);
+
+    const GLuint groups = static_cast<GLuint>((count + group_size - 1) / group_size);
+    auto pass = [&](int pass, GLuint pass_groups, GLbitfield barrier) {
+        compute.setUniform("swarm_pass", pass);
+        glDispatchCompute(pass_groups, 1, 1);
+        glMemoryBarrier(barrier);
+    };
+    pass(bin_pass, groups, GL_SHADER_STORAGE_BARRIER_BIT);
+    pass(scan_pass, 1, GL_SHADER_STORAGE_BARRIER_BIT);
+    pass(scatter_pass, groups, GL_SHADER_STORAGE_BARRIER_BIT);
+    pass(flock_pass, groups, GL_SHADER_STORAGE_BARRIER_BIT);
+    pass(classify_pass, groups, GL_SHADER_STORAGE_BARRIER_BIT);
+    pass(select_pass, 1, GL_SHADER_STORAGE_BARRIER_BIT);
+    // the lights are read by the scene shaders, the instances and commands by the draws
+    pass(gather_pass, groups, GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void FireflySwarm::draw(Model& model, glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix) {
+    if (!ready())
+        return;
+    // LOD 0: the model, instanced; the instance count was written by the select pass
+    if (command_model != &model) {
+        for (size_t i = 0; i < model.meshes.size() && i < max_commands; ++i) {
+            const GLuint index_count = static_cast<GLuint>(model.meshes[i].indices.size());
+            const GLuint rest[3] = { 0, 0, 0 };     // first index, base vertex, base instance
+            glNamedBufferSubData(command_buffer, i * command_bytes, sizeof(GLuint), &index_count);
+            glNamedBufferSubData(command_buffer, i * command_bytes + 2 * sizeof(GLuint), sizeof(rest), rest);
+        }
+        command_model = &model;
+    }
+    const glm::mat4 oriented = model_matrix * orientation;
+    const glm::mat3 oriented_normal = normal_matrix * glm::mat3(orientation);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    for (size_t i = 0; i < model.meshes.size() && i < max_commands; ++i)
+        model.meshes[i].draw_instanced_indirect(oriented, oriented_normal, instance_buffer, static_cast<GLintptr>(i * command_bytes));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// LOD 1: every firefly as a glowing quad, added to the scene
+void FireflySwarm::draw_glow(glm::mat4 const& model_matrix, glm::mat4 const& view, glm::mat4 const& projection) {
+    if (!ready())
+        return;
+    glow.activate();
+    glow.setUniform("uM_m", model_matrix);
+    glow.setUniform("uV_m", view);
+    glow.setUniform("uP_m", projection);
+    glow.setUniform("glow_size", glow_size);
+    glow.setUniform("glow_color", color);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, firefly_buffer);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depth_mask = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(empty_vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  // as set up by the application
+    glDepthMask(depth_mask);
+    if (!blend)
+        glDisable(GL_BLEND);
+}
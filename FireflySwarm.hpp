@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+#include "Model.hpp"
+
+// A swarm of fireflies flocking (boids) and blinking entirely on the GPU (firefly_swarm.comp, firefly_glow.vert/frag).
+// Every update() runs over the swarm:
+//  - bin, scan, scatter: counting sort of the fireflies into a uniform grid of cell_size (= the neighbour radius) cells
+//  - flock:    separation, alignment and cohesion over the 27 cells around each firefly (at most max_neighbours), a pull
+//              back into the home circle, a hover band above the terrain height texture; flashing neighbours pull the
+//              blink phase forward, so the swarm slowly synchronizes
+//  - classify: the ones within lod_distance of the eye become instances of the firefly model (LOD 0), all of them
+//              add their light score (brightness as seen from the eye) to a histogram
+//  - select, gather: the light_count brightest go into the light buffer (binding 5) read by lighting_shader.frag
+// Nothing is read back: the model is drawn with indirect instanced draws, every firefly also as a glowing quad (LOD 1).
+// Coordinates are those of the model matrix passed to draw() (the world root of the scene).
+//
+//   swarm.create(4096, home, 30.0f);
+//   swarm.set_terrain(height_map, size, range, terrain_to_swarm);
+//   swarm.update(delta_t, world, eye);           // once per frame, before the scene is drawn
+//   swarm.draw(model, world, normal_matrix);
+//   swarm.draw_glow(world, view, projection);    // with the transparent objects
+class FireflySwarm {
+public:
+    static constexpr int group_size = 256;          // local size of firefly_swarm.comp
+    static constexpr int max_commands = 8;          // meshes of the firefly model
+    static constexpr GLuint light_binding = 5;      // SSBO of the selected lights in lighting_shader.frag
+
+    // flocking
+    float cell_size = 1.5f;                         // neighbour radius
+    int max_neighbours = 32;                        // per firefly and step, bounds the cost in dense clusters
+    float separation_distance = 0.5f;
+    float separation = 1.5f;                        // weights of the three boid rules
+    float alignment = 0.6f;
+    float cohesion = 0.4f;
+    float wander = 1.2f;                            // a slowly changing flow field, keeps the swarm moving
+    float min_speed = 0.4f, max_speed = 2.0f;
+    glm::vec2 hover{ 0.5f, 4.0f };                  // height band above the terrain
+    // blinking
+    float blink_period = 3.0f;                      // seconds
+    float coupling = 0.3f;                          // phase pull of flashing neighbours
+    // drawing and lights
+    float scale = 0.05f;                            // of the model
+    float glow_size = 0.25f;                        // of the glowing quad
+    glm::vec3 color{ 0.55f, 1.0f, 0.25f };
+    float lod_distance = 15.0f;                     // model instances up to this distance from the eye
+    glm::mat4 orientation{ 1.0f };                  // of the model, e.g. its Z-up axes to Y-up
+    float light_intensity = 1.5f;
+    float light_falloff = 10.0f;                    // distance from the eye where a flash scores half
+
+    void create(size_t count, glm::vec3 const& home, float home_radius);   // random fireflies in the home circle (at most max_size())
+    static size_t max_size(void);                   // largest swarm of the current GL context's GPU
+    void clear(void);
+    bool ready(void) const { return firefly_buffer != 0; }
+    size_t size(void) const { return count; }
+    // lights in the light buffer (default 8), each one costs every lit fragment; a ready swarm reallocates the buffer
+    void set_light_count(int lights);
+    int light_count(void) const { return lights; }
+
+    // terrain heights as TerrainLod::height_map(), model = local space of the terrain -> coordinates of the swarm
+    void set_terrain(GLuint height_map, glm::vec2 const& size, glm::vec2 const& range, glm::mat4 const& model);
+
+    // all passes (GPU only); model_matrix: coordinates of the swarm -> world (lights), eye in world coordinates
+    void update(float delta_t, glm::mat4 const& model_matrix, glm::vec3 const& eye);
+    // the light buffer stays bound to light_binding after update()
+    void draw(Model& model, glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix);    // near ones, opaque pass
+    void draw_glow(glm::mat4 const& model_matrix, glm::mat4 const& view, glm::mat4 const& projection);   // all, additive
+
+    ~FireflySwarm() { clear(); }
+
+private:
+    static constexpr int histogram_bins = 1024;     // of the light scores
+
+    size_t count = 0;
+    int lights = 8;                                 // the size of light_buffer
+    glm::vec3 home{ 0.0f };
+    float home_radius = 0.0f;
+    glm::ivec3 grid_size{ 0 };
+    glm::vec3 grid_origin{ 0.0f };
+    GLuint cells = 0;
+    float time = 0.0f;
+
+    GLuint firefly_buffer = 0;                      // the state of the swarm
+    GLuint sorted_buffer = 0;                       // sorted by cell, input of the flocking
+    GLuint grid_buffer = 0;                         // counts and first firefly per cell, rank per firefly
+    GLuint selection_buffer = 0;                    // near count, light threshold and histogram
+    GLuint instance_buffer = 0;                     // near ones: offset xyz, scale (Mesh::draw_instanced layout)
+    GLuint command_buffer = 0;                      // indirect draws of the model meshes
+    GLuint light_buffer = 0;                        // count + selected lights
+    GLuint empty_vao = 0;
+    Model const* command_model = nullptr;           // the model the commands were written for
+
+    ShaderProgram compute;
+    ShaderProgram glow;
+
+    void create_lights(void);                       // light_buffer for 'lights', no lights until the next update()
+
+    GLuint terrain_texture = 0;
+    glm::vec2 terrain_size{ 0.0f };
+    glm::vec2 terrain_range{ 0.0f, 1.0f };
+    glm::mat4 terrain_model{ 1.0f };
+};
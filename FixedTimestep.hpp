@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+
+// Fixed-step simulation clock ("fix your timestep"): the rendered frame time is accumulated and consumed
+// in steps of exactly 'step' seconds, so the simulation gives the same results at any frame rate.
+// The remainder is returned as alpha, for interpolating between the previous and the current simulated state.
+//
+//   int steps = clock.advance(frame_dt);
+//   for (int i = 0; i < steps; ++i) { previous = current; simulate(current, clock.step); }
+//   render(mix(previous, current, clock.alpha()));
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double hz = 120.0, int max_steps = 8) : step(1.0 / hz), max_steps(max_steps) {}
+
+    double step;        // seconds of one simulation step
+    int max_steps;      // per frame; after a long stall the simulation slows down instead of spiralling
+
+    // number of steps to simulate for a rendered frame of 'frame_dt' seconds
+    int advance(double frame_dt) {
+        accumulator += std::max(frame_dt, 0.0);
+        int steps = static_cast<int>(accumulator / step);
+        if (steps > max_steps) {
+            dropped += steps - max_steps;
+            steps = max_steps;
+            accumulator = 0.0;      // forget the backlog: a partial step would show as a jump
+        }
+        else {
+            accumulator -= steps * step;
+        }
+        total_steps += steps;
+        return steps;
+    }
+
+    // position of the rendered frame between the last two simulated states, 0..1
+    float alpha(void) const { return static_cast<float>(std::clamp(accumulator / step, 0.0, 1.0)); }
+
+    long long simulated_steps(void) const { return total_steps; }
+    long long dropped_steps(void) const { return dropped; }
+
+private:
+    double accumulator = 0.0;
+    long long total_steps = 0;
+    long long dropped = 0;
+};
@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "FrameGraph.hpp"
+
+namespace {
+
+const char* access_name(FrameGraph::Access access) {
+    switch (access) {
+    case FrameGraph::Access::Attachment: return "attachment";
+    case FrameGraph::Access::Sampled:    return "sampled";
+    case FrameGraph::Access::Image:      return "image";
+    case FrameGraph::Access::Transfer:   return "transfer";
+    }
+    return "?";
+}
+
+std::string format_name(GLenum format) {
+    switch (format) {
+    case GL_RGBA8:                  return "RGBA8";
+    case GL_RGBA16F:                return "RGBA16F";
+    case GL_RGBA32F:                return "RGBA32F";
+    case GL_R11F_G11F_B10F:         return "R11F_G11F_B10F";
+    case GL_R8:                     return "R8";
+    case GL_R32F:                   return "R32F";
+    case GL_RG16F:                  return "RG16F";
+    case GL_DEPTH_COMPONENT16:      return "DEPTH16";
+    case GL_DEPTH_COMPONENT24:      return "DEPTH24";
+    case GL_DEPTH_COMPONENT32F:     return "DEPTH32F";
+    case GL_DEPTH24_STENCIL8:       return "DEPTH24_STENCIL8";
+    case GL_DEPTH32F_STENCIL8:      return "DEPTH32F_STENCIL8";
+    }
+    std::ostringstream name;
+    name << "0x" << std::hex << format;
+    return name.str();
+}
+
+// barrier needed before an access of a texture that was written by imageStore()
+GLbitfield barrier_bit(FrameGraph::Access access) {
+    switch (access) {
+    case FrameGraph::Access::Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+    case FrameGraph::Access::Sampled:    return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case FrameGraph::Access::Image:      return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case FrameGraph::Access::Transfer:   return GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+    }
+    return 0;
+}
+
+bool has_stencil(GLenum format) {
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+} // namespace
+
+//------ TextureDesc ------
+bool FrameGraph::TextureDesc::is_depth(void) const {
+    switch (format) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+        return true;
+    }
+    return false;
+}
+
+size_t FrameGraph::TextureDesc::bytes(void) const {
+    size_t texel = 4;
+    switch (format) {
+    case GL_R8:                 texel = 1; break;
+    case GL_DEPTH_COMPONENT16:  texel = 2; break;
+    case GL_RGBA16F:            texel = 8; break;
+    case GL_DEPTH32F_STENCIL8:  texel = 8; break;
+    case GL_RGBA32F:            texel = 16; break;
+    }
+    return texel * static_cast<size_t>(width) * static_cast<size_t>(height);
+}
+
+//------ PassBuilder ------
+FrameGraph::ResourceId FrameGraph::PassBuilder::create(std::string const& name, TextureDesc const& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.desc.width = std::max<GLsizei>(desc.width, 1);    // minimized window
+    resource.desc.height = std::max<GLsizei>(desc.height, 1);
+    graph.resources.push_back(resource);
+    return write(static_cast<ResourceId>(graph.resources.size() - 1), Access::Attachment);
+}
+
+FrameGraph::ResourceId FrameGraph::PassBuilder::read(ResourceId id, Access access) {
+    graph.passes[pass].reads.push_back({ id, access });
+    return id;
+}
+
+FrameGraph::ResourceId FrameGraph::PassBuilder::write(ResourceId id, Access access) {
+    graph.passes[pass].writes.push_back({ id, access });
+    return id;
+}
+
+void FrameGraph::PassBuilder::side_effect(void) {
+    graph.passes[pass].side_effect = true;
+}
+
+//------ Building ------
+void FrameGraph::reset(void) {
+    passes.clear();
+    resources.clear();
+}
+
+FrameGraph::ResourceId FrameGraph::import_backbuffer(std::string const& name, GLsizei width, GLsizei height, GLuint fbo) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = { std::max<GLsizei>(width, 1), std::max<GLsizei>(height, 1), GL_RGBA8 };
+    resource.imported = true;
+    resource.backbuffer = true;
+    resource.fbo = fbo;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+FrameGraph::ResourceId FrameGraph::import_texture(std::string const& name, GLuint texture, TextureDesc const& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.texture = texture;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+void FrameGraph::add_pass(std::string const& name, Setup const& setup, Execute const& execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    passes.push_back(std::move(pass));
+    PassBuilder builder(*this, static_cast<int>(passes.size() - 1));
+    setup(builder);
+}
+
+//------ Compile ------
+void FrameGraph::compile(void) {
+    const int pass_count = static_cast<int>(passes.size());
+
+    // cull: walk backwards from the roots, a pass is needed if it writes something a later needed pass reads
+    std::vector<bool> needed(resources.size(), false);
+    for (int p = pass_count - 1; p >= 0; --p) {
+        Pass& pass = passes[p];
+        bool keep = pass.side_effect;
+        for (Use const& w : pass.writes)
+            keep = keep || resources[w.id].imported || needed[w.id];
+        pass.culled = !keep;
+        if (pass.culled)
+            continue;
+        for (Use const& w : pass.writes)    // overwritten here: earlier writers are only needed if this pass reads it too
+            needed[w.id] = false;
+        for (Use const& r : pass.reads)
+            needed[r.id] = true;
+    }
+
+    // lifetimes of the transient textures
+    for (int p = 0; p < pass_count; ++p) {
+        if (passes[p].culled)
+            continue;
+        for (auto const* uses : { &passes[p].reads, &passes[p].writes }) {
+            for (Use const& use : *uses) {
+                Resource& resource = resources[use.id];
+                if (resource.first < 0)
+                    resource.first = p;
+                resource.last = p;
+            }
+        }
+    }
+
+    // aliasing: a texture returns to the pool after the last pass using it, later resources with the same description reuse it
+    prune_pool();
+    for (int p = 0; p < pass_count; ++p) {
+        for (Resource& resource : resources) {
+            if (!resource.imported && resource.first == p)
+                resource.physical = allocate(resource.desc);
+        }
+        for (Resource& resource : resources) {
+            if (!resource.imported && resource.last == p)
+                pool[resource.physical].in_use = false;
+        }
+    }
+
+    // barriers: only image stores are incoherent, everything else is ordered by GL
+    std::vector<bool> pending_image_write(resources.size(), false);
+    for (Pass& pass : passes) {
+        pass.barriers = 0;
+        if (pass.culled)
+            continue;
+        for (auto const* uses : { &pass.reads, &pass.writes }) {
+            for (Use const& use : *uses) {
+                if (pending_image_write[use.id])
+                    pass.barriers |= barrier_bit(use.access);
+            }
+        }
+        if (pass.barriers) {
+            for (auto const* uses : { &pass.reads, &pass.writes })
+                for (Use const& use : *uses)
+                    pending_image_write[use.id] = false;
+        }
+        for (Use const& w : pass.writes) {
+            if (w.access == Access::Image)
+                pending_image_write[w.id] = true;
+        }
+    }
+
+    // framebuffer of every pass: color attachments in declaration order, then depth
+    for (Pass& pass : passes) {
+        pass.bind_fbo = false;
+        if (pass.culled)
+            continue;
+        std::vector<ResourceId> colors, depth;
+        bool backbuffer = false;
+        for (auto const* uses : { &pass.writes, &pass.reads }) {
+            for (Use const& use : *uses) {
+                if (use.access != Access::Attachment)
+                    continue;
+                Resource const& resource = resources[use.id];
+                if (resource.backbuffer) {
+                    backbuffer = true;
+                    pass.fbo = resource.fbo;
+                    pass.viewport = resource.desc;
+                    continue;
+                }
+                auto& list = resource.desc.is_depth() ? depth : colors;
+                if (std::find(list.begin(), list.end(), use.id) == list.end())
+                    list.push_back(use.id);
+            }
+        }
+        if (backbuffer) {
+            pass.bind_fbo = true;
+        }
+        else if (!colors.empty() || !depth.empty()) {
+            pass.bind_fbo = true;
+            pass.viewport = resources[colors.empty() ? depth[0] : colors[0]].desc;
+            colors.insert(colors.end(), depth.begin(), depth.end());
+            pass.fbo = attachment_framebuffer(colors);
+        }
+    }
+}
+
+void FrameGraph::prune_pool(void) {
+    // textures not used by the last frame (e.g. old window size) are deleted
+    bool removed = false;
+    for (Physical& physical : pool) {
+        if (!physical.used && physical.texture) {
+            glDeleteTextures(1, &physical.texture);
+            physical.texture = 0;
+            removed = true;
+        }
+    }
+    pool.erase(std::remove_if(pool.begin(), pool.end(), [](Physical const& physical) { return physical.texture == 0; }), pool.end());
+    if (removed) {  // cached framebuffers may reference deleted textures
+        for (auto& [attachments, fbo] : framebuffers)
+            glDeleteFramebuffers(1, &fbo);
+        framebuffers.clear();
+    }
+    for (Physical& physical : pool) {
+        physical.in_use = false;
+        physical.used = false;
+    }
+}
+
+int FrameGraph::allocate(TextureDesc const& desc) {
+    for (size_t i = 0; i < pool.size(); ++i) {
+        if (!pool[i].in_use && pool[i].desc == desc) {
+            pool[i].in_use = true;
+            pool[i].used = true;
+            return static_cast<int>(i);
+        }
+    }
+    Physical physical;
+    physical.desc = desc;
+    glCreateTextures(GL_TEXTURE_2D, 1, &physical.texture);
+    glTextureStorage2D(physical.texture, 1, desc.format, desc.width, desc.height);
+    glTextureParameteri(physical.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(physical.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    physical.in_use = true;
+    physical.used = true;
+    pool.push_back(physical);
+    return static_cast<int>(pool.size() - 1);
+}
+
+GLuint FrameGraph::attachment_framebuffer(std::vector<ResourceId> const& attachments) {
+    std::vector<GLuint> key;
+    for (ResourceId id : attachments)
+        key.push_back(texture(id));
+    auto found = framebuffers.find(key);
+    if (found != framebuffers.end())
+        return found->second;
+
+    GLuint fbo = 0;
+    glCreateFramebuffers(1, &fbo);
+    std::vector<GLenum> draw_buffers;
+    for (ResourceId id : attachments) {
+        TextureDesc const& d = resources[id].desc;
+        if (d.is_depth()) {
+            glNamedFramebufferTexture(fbo, has_stencil(d.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, texture(id), 0);
+        }
+        else {
+            GLenum attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(draw_buffers.size());
+            glNamedFramebufferTexture(fbo, attachment, texture(id), 0);
+            draw_buffers.push_back(attachment);
+        }
+    }
+    if (draw_buffers.empty())
+        glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+    else
+        glNamedFramebufferDrawBuffers(fbo, static_cast<GLsizei>(draw_buffers.size()), draw_buffers.data());
+
+    if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Frame graph: incomplete framebuffer for " << resources[attachments[0]].name << '\n';
+    framebuffers.emplace(key, fbo);
+    return fbo;
+}
+
+//------ Execute ------
+void FrameGraph::execute(void) {
+    for (Pass& pass : passes) {
+        if (pass.culled)
+            continue;
+        auto run = [&] {
+            if (pass.barriers)
+                glMemoryBarrier(pass.barriers);
+            if (pass.bind_fbo) {
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+                glViewport(0, 0, pass.viewport.width, pass.viewport.height);
+            }
+            pass.execute(*this);
+        };
+        if (profiler) {
+            auto scope = profiler->scope(pass.name);    // GPU time + debug group
+            run();
+        }
+        else {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, pass.name.c_str());
+            run();
+            glPopDebugGroup();
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint FrameGraph::texture(ResourceId id) const {
+    Resource const& resource = resources[id];
+    if (resource.imported)
+        return resource.texture;
+    return (resource.physical >= 0) ? pool[resource.physical].texture : 0;
+}
+
+GLuint FrameGraph::framebuffer(ResourceId id) {
+    if (resources[id].backbuffer)
+        return resources[id].fbo;
+    return attachment_framebuffer({ id });
+}
+
+//------ Debugging ------
+std::string FrameGraph::dump(void) const {
+    std::ostringstream out;
+    int culled = static_cast<int>(std::count_if(passes.begin(), passes.end(), [](Pass const& p) { return p.culled; }));
+    out << "Frame graph: " << passes.size() << " passes (" << culled << " culled), " << resources.size() << " resources\n";
+
+    double total_gpu_ms = 0.0;
+    for (size_t p = 0; p < passes.size(); ++p) {
+        Pass const& pass = passes[p];
+        out << "  pass " << p << " '" << pass.name << "'";
+        if (pass.culled) {
+            out << " [culled]\n";
+            continue;
+        }
+        GpuProfiler::ScopeStats const* timing = profiler ? profiler->find(pass.name) : nullptr;
+        double gpu_ms = timing ? timing->average_ms : 0.0;
+        total_gpu_ms += gpu_ms;
+        out << std::fixed << std::setprecision(3) << "  gpu " << gpu_ms << " ms";
+        if (pass.barriers)
+            out << "  barrier 0x" << std::hex << pass.barriers << std::dec;
+        out << '\n';
+        for (Use const& r : pass.reads)
+            out << "      read  " << resources[r.id].name << " (" << access_name(r.access) << ")\n";
+        for (Use const& w : pass.writes)
+            out << "      write " << resources[w.id].name << " (" << access_name(w.access) << ")\n";
+    }
+
+    size_t requested = 0;
+    for (Resource const& resource : resources) {
+        out << "  resource '" << resource.name << "' " << resource.desc.width << "x" << resource.desc.height << " " << format_name(resource.desc.format);
+        if (resource.backbuffer)
+            out << " backbuffer";
+        else if (resource.imported)
+            out << " imported texture " << resource.texture;
+        else if (resource.first < 0)
+            out << " unused";
+        else {
+            requested += resource.desc.bytes();
+            out << " passes " << resource.first << ".." << resource.last << " -> pool texture " << resource.physical
+                << " (" << resource.desc.bytes() / 1024 << " KiB)";
+        }
+        out << '\n';
+    }
+
+    size_t allocated = 0;
+    for (Physical const& physical : pool) {
+        if (physical.used)
+            allocated += physical.desc.bytes();
+    }
+    out << std::fixed << std::setprecision(2)
+        << "  transient memory: " << requested / (1024.0 * 1024.0) << " MiB requested, "
+        << allocated / (1024.0 * 1024.0) << " MiB allocated (" << pool.size() << " textures)\n"
+        << "  total gpu time: " << std::setprecision(3) << total_gpu_ms << " ms\n";
+    return out.str();
+}
+
+void FrameGraph::clear(void) {
+    for (Physical& physical : pool)
+        glDeleteTextures(1, &physical.texture);
+    pool.clear();
+    for (auto& [attachments, fbo] : framebuffers)
+        glDeleteFramebuffers(1, &fbo);
+    framebuffers.clear();
+    reset();
+}
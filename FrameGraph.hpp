@@ -0,0 +1,133 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GpuProfiler.hpp"
+
+// Render passes of one frame.
+// Every frame the passes are declared again: each pass tells which resources it reads and writes in its setup
+// function, the graph then
+//  - culls passes whose results are never used (only passes writing an imported resource, e.g. the backbuffer, or
+//    marked with side_effect() are roots),
+//  - computes the lifetime of the transient textures and aliases textures with the same description onto one
+//    GL texture when their lifetimes don't overlap (the GL textures are kept between frames),
+//  - inserts glMemoryBarrier() only after image (load/store) writes, framebuffer writes are coherent in GL,
+//  - binds the framebuffer of the attachments and the viewport, and measures every pass as a GpuProfiler scope.
+// Passes execute in declaration order (a pass can only read resources declared before it).
+class FrameGraph {
+public:
+    using ResourceId = int;
+    static constexpr ResourceId no_resource = -1;
+
+    // how a pass accesses a resource
+    enum class Access {
+        Attachment, // rendered to / depth tested against, bound in the framebuffer of the pass
+        Sampled,    // texture() in a shader
+        Image,      // imageLoad() / imageStore()
+        Transfer    // glBlitNamedFramebuffer(), glCopyImageSubData()
+    };
+
+    struct TextureDesc {
+        GLsizei width = 1;
+        GLsizei height = 1;
+        GLenum format = GL_RGBA8;
+
+        bool operator==(TextureDesc const& other) const { return width == other.width && height == other.height && format == other.format; }
+        bool is_depth(void) const;
+        size_t bytes(void) const;
+    };
+
+    class PassBuilder {
+    public:
+        ResourceId create(std::string const& name, TextureDesc const& desc);    // new transient texture, written by this pass
+        ResourceId read(ResourceId id, Access access = Access::Sampled);
+        ResourceId write(ResourceId id, Access access = Access::Attachment);
+        void side_effect(void);     // the pass is never culled
+
+    private:
+        friend class FrameGraph;
+        PassBuilder(FrameGraph& graph, int pass) : graph(graph), pass(pass) {}
+        FrameGraph& graph;
+        int pass;
+    };
+
+    using Setup = std::function<void(PassBuilder&)>;
+    using Execute = std::function<void(FrameGraph&)>;
+
+    FrameGraph(void) = default;
+    FrameGraph(FrameGraph const&) = delete;
+    FrameGraph& operator=(FrameGraph const&) = delete;
+    ~FrameGraph() { clear(); }
+
+    //------ Building the graph (every frame) ------
+    void reset(void);   // forget the passes of the last frame, the GL textures stay in the pool
+    ResourceId import_backbuffer(std::string const& name, GLsizei width, GLsizei height, GLuint fbo = 0);  // fbo: framebuffer of the window (0) or of a headless context
+    ResourceId import_texture(std::string const& name, GLuint texture, TextureDesc const& desc);
+    void add_pass(std::string const& name, Setup const& setup, Execute const& execute);
+
+    void compile(void);
+    void execute(void);
+    void set_profiler(GpuProfiler* gpu_profiler) { profiler = gpu_profiler; }
+
+    //------ Used by the passes while executing ------
+    GLuint texture(ResourceId id) const;
+    GLuint framebuffer(ResourceId id);  // framebuffer with only this texture attached (e.g. blit source), or the imported backbuffer
+    TextureDesc const& desc(ResourceId id) const { return resources[id].desc; }
+
+    //------ Debugging ------
+    std::string dump(void) const;   // compiled graph: passes, resources, lifetimes, aliasing, barriers, GPU time and memory
+
+    void clear(void);   // delete all GL objects
+
+private:
+    struct Use {
+        ResourceId id;
+        Access access;
+    };
+
+    struct Pass {
+        std::string name;
+        Execute execute;
+        std::vector<Use> reads{};
+        std::vector<Use> writes{};
+        bool side_effect = false;
+        bool culled = false;
+        GLbitfield barriers = 0;    // glMemoryBarrier() bits needed before the pass
+        GLuint fbo = 0;
+        bool bind_fbo = false;      // the pass has attachments
+        TextureDesc viewport{};
+    };
+
+    struct Resource {
+        std::string name;
+        TextureDesc desc{};
+        bool imported = false;
+        bool backbuffer = false;
+        GLuint texture = 0;         // imported texture
+        GLuint fbo = 0;             // imported backbuffer
+        int first = -1, last = -1;  // lifetime: first and last (not culled) pass using the resource
+        int physical = -1;          // index into the texture pool (transient resources)
+    };
+
+    struct Physical {
+        TextureDesc desc{};
+        GLuint texture = 0;
+        bool in_use = false;        // taken by a living resource while compiling
+        bool used = false;          // used by the last compiled frame
+    };
+
+    std::vector<Pass> passes{};
+    std::vector<Resource> resources{};
+    std::vector<Physical> pool{};
+    std::map<std::vector<GLuint>, GLuint> framebuffers{};   // attachments -> framebuffer object
+    GpuProfiler* profiler = nullptr;
+
+    void prune_pool(void);
+    int allocate(TextureDesc const& desc);
+    GLuint attachment_framebuffer(std::vector<ResourceId> const& attachments);
+};
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")   // timeBeginPeriod
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include "FramePacer.hpp"
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+    if (timer_period_set)
+        timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::init(GLFWwindow* window) {
+    this->window = window;
+#ifdef _WIN32
+    // 1 ms scheduler tick instead of the default 15.6 ms, otherwise the limiter has to spin most of the frame
+    if (!timer_period_set)
+        timer_period_set = timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+    if (!window)
+        return;
+
+    tear_supported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+    if (!monitor)
+        monitor = glfwGetPrimaryMonitor();
+    if (monitor) {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        refresh_hz = mode ? mode->refreshRate : 0.0;
+    }
+    set_vsync(vsync_mode);
+}
+
+void FramePacer::set_vsync(Vsync mode) {
+    if (mode == Vsync::Adaptive && !tear_supported)
+        mode = Vsync::On;
+    vsync_mode = mode;
+    if (window)
+        glfwSwapInterval(mode == Vsync::Off ? 0 : (mode == Vsync::On ? 1 : -1));
+}
+
+void FramePacer::cycle_vsync(void) {
+    switch (vsync_mode) {
+    case Vsync::Off:
+        set_vsync(Vsync::On);
+        break;
+    case Vsync::On:
+        set_vsync(tear_supported ? Vsync::Adaptive : Vsync::Off);
+        break;
+    case Vsync::Adaptive:
+        set_vsync(Vsync::Off);
+        break;
+    }
+}
+
+void FramePacer::set_target_hz(double hz) {
+    target = std::max(hz, 0.0);
+    deadline = Clock::time_point{};     // restart the schedule
+}
+
+double FramePacer::frame_period(void) const {
+    double period = (target > 0.0) ? 1.0 / target : 0.0;
+    if (vsync_mode != Vsync::Off && refresh_hz > 0.0)
+        period = std::max(period, 1.0 / refresh_hz);    // vsync can not go faster than the monitor
+    return period;
+}
+
+double FramePacer::begin_frame(void) {
+    Clock::time_point now = Clock::now();
+    double period = frame_period();
+    if (first_frame) {
+        raw_dt = (period > 0.0) ? period : 1.0 / 60.0;
+        first_frame = false;
+    }
+    else {
+        raw_dt = std::chrono::duration<double>(now - last_frame).count();
+    }
+    last_frame = now;
+
+    deltas[delta_head] = std::clamp(raw_dt, 0.0, max_delta);
+    delta_head = (delta_head + 1) % smooth_frames;
+    delta_count = std::min(delta_count + 1, smooth_frames);
+    double sum = 0.0;
+    for (int i = 0; i < delta_count; ++i)
+        sum += deltas[i];
+    double smoothed = sum / delta_count;
+
+    // paced frames: the scheduling jitter is not real motion time, use the exact period
+    if (period > 0.0 && std::abs(smoothed - period) < 0.05 * period)
+        return period;
+    return smoothed;
+}
+
+void FramePacer::limit(void) {
+    if (target <= 0.0)
+        return;
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target));
+    Clock::time_point now = Clock::now();
+
+    if (deadline == Clock::time_point{} || now - deadline > period) {
+        deadline = now;     // first frame or a frame late by more than a period: restart instead of rushing to catch up
+    }
+    else {
+        const auto margin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spin_margin));
+        Clock::time_point wake = deadline - margin;
+        if (now < wake) {
+            std::this_thread::sleep_until(wake);
+            double oversleep = std::chrono::duration<double>(Clock::now() - wake).count();
+            // follow the worst recent oversleep, slowly forget it
+            spin_margin = std::clamp(std::max(oversleep * 1.25, spin_margin * 0.99), 0.0002, 0.004);
+        }
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+    deadline += period;
+}
+
+std::string FramePacer::status(void) const {
+    static const char* names[] = { "off", "on", "adaptive" };
+    std::ostringstream out;
+    out << "Vsync: " << names[static_cast<int>(vsync_mode)];
+    if (target > 0.0)
+        out << " Limit: " << target << " Hz";
+    return out.str();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+
+struct GLFWwindow;
+
+// Frame pacing: swap interval (vsync off / on / adaptive), an optional frame limiter and a smoothed frame delta.
+//
+//   pacer.init(window);                 // after the context is current
+//   loop:
+//       double dt = pacer.begin_frame();    // smoothed seconds since the last frame, for camera and movers
+//       ...update, render...
+//       pacer.limit();                      // before glfwSwapBuffers: waits for the limiter deadline
+//
+// The limiter sleeps until shortly before the deadline and spins the rest, the sleep margin follows the
+// measured oversleep of the OS timer, so the frame start lands within a few microseconds of the target.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Vsync { Off, On, Adaptive };     // Adaptive: swap interval -1, late frames tear instead of waiting a whole refresh
+
+    FramePacer(void) = default;
+    FramePacer(FramePacer const&) = delete;
+    FramePacer& operator=(FramePacer const&) = delete;
+    ~FramePacer();
+
+    void init(GLFWwindow* window);              // window == nullptr: headless, no swap interval
+    void set_vsync(Vsync mode);
+    Vsync vsync(void) const { return vsync_mode; }
+    void cycle_vsync(void);                     // Off -> On -> Adaptive (when supported) -> Off
+    bool adaptive_supported(void) const { return tear_supported; }
+
+    void set_target_hz(double hz);              // 0: no limiter
+    double target_hz(void) const { return target; }
+
+    double begin_frame(void);                   // smoothed delta time in seconds
+    double raw_delta(void) const { return raw_dt; }
+    void limit(void);
+
+    std::string status(void) const;             // for the window title
+
+private:
+    static constexpr int smooth_frames = 8;     // frames in the delta average
+    static constexpr double max_delta = 0.1;    // longer frames (breakpoint, window drag) count as this, so nothing jumps
+
+    GLFWwindow* window = nullptr;
+    Vsync vsync_mode = Vsync::On;
+    bool tear_supported = false;
+    double refresh_hz = 0.0;                    // of the monitor, 0 when unknown
+    bool timer_period_set = false;
+
+    double target = 0.0;
+    Clock::time_point deadline{};
+    double spin_margin = 0.002;                 // seconds spun before the deadline instead of sleeping
+
+    Clock::time_point last_frame{};
+    bool first_frame = true;
+    double raw_dt = 0.0;
+    std::array<double, smooth_frames> deltas{};
+    int delta_head = 0;
+    int delta_count = 0;
+
+    double frame_period(void) const;            // expected frame time from vsync and limiter, 0 when free running
+};
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+#include "FrameStats.hpp"
+
+void FrameStats::add(Histogram& h, double ms) {
+    int bin = static_cast<int>(ms / bin_ms);
+    h.bins[std::clamp(bin, 0, bin_count - 1)]++;
+    h.count++;
+    h.sum_ms += ms;
+    h.max_ms = std::max(h.max_ms, ms);
+    if (ms > hitch_ms)
+        h.hitches++;
+}
+
+void FrameStats::record(double frame_ms, double cpu_ms, double gpu_ms) {
+    add(histograms[static_cast<int>(Series::Frame)], frame_ms);
+    add(histograms[static_cast<int>(Series::Cpu)], cpu_ms);
+    if (gpu_ms >= 0.0)
+        add(histograms[static_cast<int>(Series::Gpu)], gpu_ms);
+
+    recent[head] = static_cast<float>(frame_ms);
+    head = (head + 1) % graph_size;
+}
+
+void FrameStats::reset(void) {
+    histograms = {};
+    recent = {};
+    head = 0;
+}
+
+double FrameStats::percentile(Series series, double p) const {
+    Histogram const& h = histograms[static_cast<int>(series)];
+    if (h.count == 0)
+        return 0.0;
+    // rank of the sample, 1-based: p50 of 100 frames is the 50th fastest
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * h.count));
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t seen = 0;
+    for (int i = 0; i < bin_count; ++i) {
+        seen += h.bins[i];
+        if (seen >= rank)
+            return std::min((i + 1) * bin_ms, h.max_ms);   // the upper edge of the bin is never above the slowest frame
+    }
+    return h.max_ms;
+}
+
+FrameStats::Summary FrameStats::summary(Series series) const {
+    Histogram const& h = histograms[static_cast<int>(series)];
+    Summary s;
+    s.frames = h.count;
+    if (h.count == 0)
+        return s;
+    s.average_ms = h.sum_ms / h.count;
+    s.p50_ms = percentile(series, 50.0);
+    s.p95_ms = percentile(series, 95.0);
+    s.p99_ms = percentile(series, 99.0);
+    s.max_ms = h.max_ms;
+    s.hitches = h.hitches;
+    return s;
+}
+
+std::string FrameStats::text_graph(int rows) const {
+    // columns of 3 frames (the slowest of them, so a single hitch is not averaged away), newest on the right
+    constexpr int frames_per_column = 3;
+    constexpr int columns = graph_size / frames_per_column;
+    std::array<float, columns> column{};
+    for (int c = 0; c < columns; ++c) {
+        for (int k = 0; k < frames_per_column; ++k)
+            column[c] = std::max(column[c], recent[(head + c * frames_per_column + k) % graph_size]);
+    }
+    float top = std::max(static_cast<float>(hitch_ms), *std::max_element(column.begin(), column.end()));
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (int r = rows; r > 0; --r) {
+        float level = top * (r - 0.5f) / rows;
+        out << std::setw(7) << top * r / rows << " ms |";
+        for (float ms : column)
+            out << (ms >= level ? (ms > hitch_ms ? '!' : '#') : ' ');
+        out << '\n';
+    }
+    out << "           +" << std::string(columns, '-') << " last " << graph_size << " frames\n";
+    return out.str();
+}
+
+std::string FrameStats::report(void) const {
+    static const char* names[series_count] = { "frame", "cpu", "gpu" };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << "Frame times (hitch > " << hitch_ms << " ms):\n";
+    for (int i = 0; i < series_count; ++i) {
+        Summary s = summary(static_cast<Series>(i));
+        out << "  " << std::left << std::setw(6) << names[i] << std::right << std::setw(8) << s.frames << " frames"
+            << "   avg " << std::setw(7) << s.average_ms << "   p50 " << std::setw(7) << s.p50_ms
+            << "   p95 " << std::setw(7) << s.p95_ms << "   p99 " << std::setw(7) << s.p99_ms
+            << "   max " << std::setw(7) << s.max_ms << " ms   hitches " << s.hitches << '\n';
+    }
+    out << text_graph(8);
+    return out.str();
+}
+
+bool FrameStats::write_results(std::filesystem::path const& file) const {
+    static const char* names[series_count] = { "frame", "cpu", "gpu" };
+    nlohmann::json results;
+#ifdef NDEBUG
+    results["build"] = { { "config", "release" }, { "date", __DATE__ " " __TIME__ } };
+#else
+    results["build"] = { { "config", "debug" }, { "date", __DATE__ " " __TIME__ } };
+#endif
+    results["hitch_ms"] = hitch_ms;
+    results["bin_ms"] = bin_ms;
+    for (int i = 0; i < series_count; ++i) {
+        Summary s = summary(static_cast<Series>(i));
+        nlohmann::json series = {
+            { "frames", s.frames }, { "average_ms", s.average_ms },
+            { "p50_ms", s.p50_ms }, { "p95_ms", s.p95_ms }, { "p99_ms", s.p99_ms }, { "max_ms", s.max_ms },
+            { "hitches", s.hitches }
+        };
+        // sparse histogram: [bin start in ms, frames]
+        nlohmann::json bins = nlohmann::json::array();
+        Histogram const& h = histograms[i];
+        for (int b = 0; b < bin_count; ++b) {
+            if (h.bins[b])
+                bins.push_back({ b * bin_ms, h.bins[b] });
+        }
+        series["histogram"] = bins;
+        results[names[i]] = series;
+    }
+
+    std::ofstream out(file);
+    if (!out) {
+        std::cerr << "Can not write frame statistics: " << file << '\n';
+        return false;
+    }
+    out << results.dump(2) << '\n';
+    std::cout << "Frame statistics written to " << file << '\n';
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Frame time statistics: every frame goes into fixed-size histograms, so percentiles stay exact
+// (to the bin width) over a run of any length without storing the frames.
+// A 100 ms hitch inside an otherwise smooth second reads 60 FPS, but shows up in p99, max and the hitch count.
+//
+//   frame_stats.record(interval_ms, cpu_ms, gpu_ms);    // gpu_ms < 0: no GPU result this frame
+//   frame_stats.summary(FrameStats::Series::Frame).p99_ms
+class FrameStats {
+public:
+    static constexpr double bin_ms = 0.1;           // histogram resolution
+    static constexpr int bin_count = 2000;          // 0 .. 200 ms, slower frames go to the last bin (max is kept exactly)
+    static constexpr int graph_size = 240;          // frames in the rolling graph
+
+    enum class Series { Frame, Cpu, Gpu };          // frame to frame interval, CPU work of the frame, GPU time of the frame
+    static constexpr int series_count = 3;
+
+    struct Summary {
+        std::uint64_t frames = 0;
+        double average_ms = 0.0;
+        double p50_ms = 0.0;
+        double p95_ms = 0.0;
+        double p99_ms = 0.0;
+        double max_ms = 0.0;
+        std::uint64_t hitches = 0;                  // frames over hitch_ms
+    };
+
+    double hitch_ms = 1000.0 / 30.0;                // a frame slower than this is a hitch (missed two vsyncs at 60 Hz)
+
+    void record(double frame_ms, double cpu_ms, double gpu_ms);
+    void reset(void);
+
+    Summary summary(Series series) const;
+    double percentile(Series series, double p) const;   // p in 0..100, upper edge of the bin
+    std::array<float, graph_size> const& graph(void) const { return recent; }   // last frame intervals, oldest at graph_head()
+    int graph_head(void) const { return head; }
+
+    std::string report(void) const;                     // summaries + text graph of the last frames
+    bool write_results(std::filesystem::path const& file) const;    // JSON, for comparing builds
+
+private:
+    struct Histogram {
+        std::array<std::uint32_t, bin_count> bins{};
+        std::uint64_t count = 0;
+        double sum_ms = 0.0;
+        double max_ms = 0.0;
+        std::uint64_t hitches = 0;
+    };
+
+    std::array<Histogram, series_count> histograms{};
+    std::array<float, graph_size> recent{};
+    int head = 0;
+
+    void add(Histogram& h, double ms);
+    std::string text_graph(int rows) const;
+};
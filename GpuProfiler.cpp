@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "GpuProfiler.hpp"
+
+void GpuProfiler::begin_frame(void) {
+    current = (current + 1) % ring_size;
+    Frame& frame = frames[current];
+    if (frame.pending)
+        collect(frame);     // results of ring_size frames ago
+    frame.used = 0;
+    frame.records.clear();
+    frame.pending = false;
+    depth = 0;
+}
+
+void GpuProfiler::end_frame(void) {
+    Frame& frame = frames[current];
+    frame.pending = !frame.records.empty();
+}
+
+GpuProfiler::Scope GpuProfiler::scope(std::string const& name) {
+    if (!enabled)
+        return Scope(nullptr, -1);
+
+    auto found = scope_index.find(name);
+    int index;
+    if (found == scope_index.end()) {
+        index = static_cast<int>(scopes.size());
+        scope_index.emplace(name, index);
+        scopes.emplace_back();
+        scopes.back().name = name;
+        scopes.back().depth = depth;
+    }
+    else {
+        index = found->second;
+    }
+
+    Frame& frame = frames[current];
+    Record record{ index, next_query(frame), next_query(frame) };
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name.c_str());
+    glQueryCounter(record.begin_query, GL_TIMESTAMP);
+    frame.records.push_back(record);
+    ++depth;
+    return Scope(this, static_cast<int>(frame.records.size() - 1));
+}
+
+void GpuProfiler::end(int record) {
+    glQueryCounter(frames[current].records[record].end_query, GL_TIMESTAMP);
+    glPopDebugGroup();
+    --depth;
+}
+
+GLuint GpuProfiler::next_query(Frame& frame) {
+    if (frame.used == frame.queries.size()) {
+        GLuint query = 0;
+        glCreateQueries(GL_TIMESTAMP, 1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queries[frame.used++];
+}
+
+void GpuProfiler::collect(Frame& frame) {
+    // commands complete in order: when the last timestamp is available, all of the frame are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.records.back().end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        ++dropped;
+        return;
+    }
+
+    ++measured;
+    frame_sum.assign(scopes.size(), -1.0);
+    for (Record const& record : frame.records) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(record.begin_query, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(record.end_query, GL_QUERY_RESULT, &end);
+        double ms = (end - begin) / 1.0e6;
+        frame_sum[record.scope] = std::max(frame_sum[record.scope], 0.0) + ms;  // a scope may run several times per frame
+    }
+
+    for (size_t i = 0; i < scopes.size(); ++i) {
+        ScopeStats& s = scopes[i];
+        if (frame_sum[i] < 0.0 && s.samples == 0)
+            continue;   // created after this frame was recorded
+        s.idle = frame_sum[i] < 0.0 ? s.idle + 1 : 0;
+        s.last_ms = std::max(frame_sum[i], 0.0);
+        s.history[s.head] = static_cast<float>(s.last_ms);
+        s.head = (s.head + 1) % history_size;
+        s.samples = std::min(s.samples + 1, history_size);
+
+        double sum = 0.0, max = 0.0;
+        for (int k = 0; k < s.samples; ++k) {
+            sum += s.history[k];
+            max = std::max(max, static_cast<double>(s.history[k]));
+        }
+        s.average_ms = sum / s.samples;
+        s.max_ms = max;
+    }
+}
+
+GpuProfiler::ScopeStats const* GpuProfiler::find(std::string const& name) const {
+    auto found = scope_index.find(name);
+    return (found != scope_index.end()) ? &scopes[found->second] : nullptr;
+}
+
+double GpuProfiler::frame_ms(void) const {
+    double sum = 0.0;
+    for (ScopeStats const& s : scopes) {
+        if (s.depth == 0)
+            sum += s.last_ms;
+    }
+    return sum;
+}
+
+std::string GpuProfiler::report(void) const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << "GPU scopes (last " << history_size << " frames, " << dropped << " dropped):\n";
+    for (ScopeStats const& s : scopes) {
+        out << "  " << std::string(2 * s.depth, ' ') << std::left << std::setw(24 - 2 * s.depth) << s.name << std::right
+            << " avg " << std::setw(8) << s.average_ms << " ms   max " << std::setw(8) << s.max_ms << " ms   last " << std::setw(8) << s.last_ms << " ms";
+        if (s.idle > 0)
+            out << "   not issued for " << s.idle << " frames";
+        out << '\n';
+    }
+    return out.str();
+}
+
+void GpuProfiler::clear(void) {
+    for (Frame& frame : frames) {
+        if (!frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        frame = Frame{};
+    }
+    scopes.clear();
+    scope_index.clear();
+}
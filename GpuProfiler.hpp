@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+// GPU time of named scopes (render passes), measured with GL_TIMESTAMP query pairs.
+// The queries of a frame are read back ring_size frames later and only when they are available,
+// so the profiler never stalls the pipeline (a frame whose results are still not ready is dropped).
+// A scope that was not issued in a measured frame counts as 0 ms there: a pass that stops running fades out of the
+// averages instead of reporting its last time forever.
+// Scopes may be nested; every scope is also a glPushDebugGroup, so RenderDoc/Nsight captures show the same names.
+//
+//   gpu_profiler.begin_frame();
+//   { auto scope = gpu_profiler.scope("terrain");  ...draw... }
+//   gpu_profiler.end_frame();
+class GpuProfiler {
+public:
+    static constexpr int ring_size = 4;         // frames in flight
+    static constexpr int history_size = 64;     // frames in the rolling average and max
+
+    struct ScopeStats {
+        std::string name;
+        int depth = 0;                          // nesting level of the scope
+        double last_ms = 0.0;
+        double average_ms = 0.0;                // rolling, over the last history_size frames
+        double max_ms = 0.0;                    // dtto
+        std::array<float, history_size> history{};
+        int samples = 0;
+        int head = 0;
+        int idle = 0;                           // measured frames in a row without this scope
+    };
+
+    // RAII scope: begins on construction, ends on destruction
+    class Scope {
+    public:
+        Scope(Scope&& other) noexcept : profiler(other.profiler), record(other.record) { other.profiler = nullptr; }
+        ~Scope() { if (profiler) profiler->end(record); }
+    private:
+        friend class GpuProfiler;
+        Scope(GpuProfiler* profiler, int record) : profiler(profiler), record(record) {}
+        GpuProfiler* profiler;
+        int record;
+    };
+
+    GpuProfiler(void) = default;
+    GpuProfiler(GpuProfiler const&) = delete;
+    GpuProfiler& operator=(GpuProfiler const&) = delete;
+    ~GpuProfiler() { clear(); }
+
+    bool enabled = true;
+
+    void begin_frame(void);
+    void end_frame(void);
+    Scope scope(std::string const& name);
+
+    std::vector<ScopeStats> const& stats(void) const { return scopes; }
+    ScopeStats const* find(std::string const& name) const;
+    double frame_ms(void) const;        // sum of the outermost scopes of the last measured frame
+    size_t dropped_frames(void) const { return dropped; }
+    size_t measured_frames(void) const { return measured; }    // frames read back so far, frame_ms() changes when this does
+    std::string report(void) const;
+
+    void clear(void);   // delete the query objects
+
+private:
+    struct Record {
+        int scope;
+        GLuint begin_query;
+        GLuint end_query;
+    };
+    struct Frame {
+        std::vector<GLuint> queries{};  // pool of timestamp queries, grows to the number needed per frame
+        size_t used = 0;
+        std::vector<Record> records{};
+        bool pending = false;
+    };
+
+    std::array<Frame, ring_size> frames{};
+    int current = 0;
+    int depth = 0;
+    size_t dropped = 0;
+    size_t measured = 0;
+    std::vector<ScopeStats> scopes{};
+    std::unordered_map<std::string, int> scope_index{};
+    std::vector<double> frame_sum{};    // per scope, while reading one frame
+
+    GLuint next_query(Frame& frame);
+    void end(int record);
+    void collect(Frame& frame);
+};
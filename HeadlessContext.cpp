@@ -0,0 +1,111 @@
+#include <cstring>
+#include <iostream>
+
+#include "HeadlessContext.hpp"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+bool HeadlessContext::create(void) {
+    // prefer the Mesa surfaceless platform: no X11/Wayland connection and no GPU device is needed
+    EGLDisplay egl_display = EGL_NO_DISPLAY;
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display)
+        egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (egl_display == EGL_NO_DISPLAY)
+        egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major = 0, minor = 0;
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+        std::cerr << "Headless: no EGL display\n";
+        return false;
+    }
+    display = egl_display;
+    std::cout << "Headless: EGL " << major << '.' << minor << " (" << eglQueryString(egl_display, EGL_VENDOR) << ")\n";
+
+    const char* extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context")) {
+        std::cerr << "Headless: EGL_KHR_surfaceless_context not supported\n";
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(egl_display, config_attribs, &config, 1, &config_count) || config_count == 0)
+        config = nullptr;   // EGL_KHR_no_config_context: rendering goes to our own framebuffer anyway
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "Headless: desktop OpenGL not supported by EGL\n";
+        return false;
+    }
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attribs);
+    if (egl_context == EGL_NO_CONTEXT) {
+        std::cerr << "Headless: can not create OpenGL 4.6 core context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")\n"
+            << "  (llvmpipe before Mesa 23 exposes 4.5 only: set MESA_GL_VERSION_OVERRIDE=4.6 MESA_GLSL_VERSION_OVERRIDE=460)\n";
+        return false;
+    }
+    context = egl_context;
+
+    if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+        std::cerr << "Headless: eglMakeCurrent failed\n";
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext::destroy(void) {
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &color);
+        glDeleteTextures(1, &depth);
+        fbo = color = depth = 0;
+    }
+    if (display) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = nullptr;
+        context = nullptr;
+    }
+}
+
+#else
+
+bool HeadlessContext::create(void) {
+    std::cerr << "Headless: not available on this platform\n";
+    return false;
+}
+
+void HeadlessContext::destroy(void) {
+}
+
+#endif
+
+bool HeadlessContext::create_framebuffer(GLsizei width, GLsizei height) {
+    glCreateTextures(GL_TEXTURE_2D, 1, &color);
+    glTextureStorage2D(color, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth);
+    glTextureStorage2D(depth, 1, GL_DEPTH_COMPONENT32F, width, height);
+
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, color, 0);
+    glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depth, 0);
+    if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Headless: incomplete framebuffer\n";
+        return false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return true;
+}
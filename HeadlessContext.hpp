@@ -0,0 +1,34 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// EGL is used on Linux (with Mesa: llvmpipe when there is no GPU). Other platforms have no headless backend.
+#if defined(__linux__) && !defined(HEADLESS_NO_EGL)
+#define HEADLESS_EGL 1
+#endif
+
+// OpenGL 4.6 core context without a window (EGL surfaceless) that renders into its own framebuffer.
+// Used for automated performance runs on machines without a display, e.g.
+//   EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 ./my_app --headless 600
+class HeadlessContext {
+public:
+    HeadlessContext(void) = default;
+    HeadlessContext(HeadlessContext const&) = delete;
+    HeadlessContext& operator=(HeadlessContext const&) = delete;
+    ~HeadlessContext() { destroy(); }
+
+    // create the context and make it current (call before glewInit)
+    bool create(void);
+    // color + depth framebuffer used instead of the window backbuffer (call after glewInit)
+    bool create_framebuffer(GLsizei width, GLsizei height);
+    GLuint framebuffer(void) const { return fbo; }
+
+    void destroy(void);
+
+private:
+    GLuint fbo = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    void* display = nullptr;    // EGLDisplay
+    void* context = nullptr;    // EGLContext
+};
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+
+#include "HeightPyramid.hpp"
+#include "JobSystem.hpp"
+
+namespace {
+    // 1 / d without infinities: rays along an axis get huge slab distances instead of inf * 0 = NaN
+    float safe_inverse(float d) { return std::abs(d) > 1e-30f ? 1.0f / d : std::copysign(1e30f, d); }
+
+    // slab test of the ray against an axis aligned box, narrows [t0, t1]. The height range is grown a little: the boxes of
+    // flat blocks have no height, a ray would only touch them at one (rounded) t
+    bool clip(glm::vec3 const& lo, glm::vec3 const& hi, glm::vec3 const& o, glm::vec3 const& inv, float& t0, float& t1) {
+        constexpr float tolerance = 1e-3f;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float grow = axis == 1 ? tolerance : 0.0f;
+            float ta = (lo[axis] - grow - o[axis]) * inv[axis];
+            float tb = (hi[axis] + grow - o[axis]) * inv[axis];
+            if (ta > tb)
+                std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+        }
+        return t0 <= t1;
+    }
+}
+
+void HeightPyramid::build(Heightfield const& heights) {
+    clear();
+    if (heights.rows() < 2 || heights.columns() < 2)
+        return;
+    field = &heights;
+    Level level;
+    level.rows = heights.rows() / 2;        // ceil((rows - 1) / 2) cells
+    level.columns = heights.columns() / 2;
+    for (;;) {
+        level.resize();
+        levels.push_back(level);
+        if (level.rows == 1 && level.columns == 1)
+            break;
+        level.rows = (level.rows + 1) / 2;
+        level.columns = (level.columns + 1) / 2;
+    }
+    update(HeightRegion{ 0, 0, heights.rows(), heights.columns() });
+}
+
+void HeightPyramid::update(HeightRegion const& samples) {
+    if (levels.empty())
+        return;
+    const HeightRegion r = samples.clipped(field->columns(), field->rows());
+    if (r.empty())
+        return;
+    // the cells around the samples, then the blocks over them on every level
+    int x0 = std::max(r.row - 1, 0) / 2;
+    int x1 = std::min(r.row + r.rows - 1, field->rows() - 2) / 2;
+    int z0 = std::max(r.column - 1, 0) / 2;
+    int z1 = std::min(r.column + r.columns - 1, field->columns() - 2) / 2;
+    for (int level = 0; level < static_cast<int>(levels.size()); ++level) {
+        JobSystem::instance().parallel_for(static_cast<size_t>(x0), static_cast<size_t>(x1) + 1, 16, [&](size_t first, size_t last) {
+            for (int x = static_cast<int>(first); x < static_cast<int>(last); ++x)
+                for (int z = z0; z <= z1; ++z)
+                    levels[level].range[levels[level].index(x, z)] = block_range(level, x, z);
+            });
+        x0 /= 2;
+        x1 /= 2;
+        z0 /= 2;
+        z1 /= 2;
+    }
+}
+
+glm::vec2 HeightPyramid::block_range(int level, int x, int z) const {
+    glm::vec2 range(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+    if (level == 0) {
+        // 2x2 cells = 3x3 samples (the samples on a block border belong to both blocks)
+        const int last_row = std::min(x * 2 + 2, field->rows() - 1);
+        const int last_column = std::min(z * 2 + 2, field->columns() - 1);
+        for (int row = x * 2; row <= last_row; ++row)
+            for (int column = z * 2; column <= last_column; ++column) {
+                const float h = field->at(row, column);
+                range.x = std::min(range.x, h);
+                range.y = std::max(range.y, h);
+            }
+        return range;
+    }
+    Level const& finer = levels[level - 1];
+    for (int child = 0; child < 4; ++child) {
+        const int cx = x * 2 + (child >> 1);
+        const int cz = z * 2 + (child & 1);
+        if (cx < finer.rows && cz < finer.columns) {
+            glm::vec2 const& r = finer.range[finer.index(cx, cz)];
+            range.x = std::min(range.x, r.x);
+            range.y = std::max(range.y, r.y);
+        }
+    }
+    return range;
+}
+
+void HeightPyramid::clear(void) {
+    field = nullptr;
+    levels.clear();
+}
+
+size_t HeightPyramid::memory_bytes(void) const {
+    size_t bytes = 0;
+    for (Level const& level : levels)
+        bytes += level.range.capacity() * sizeof(glm::vec2);
+    return bytes;
+}
+
+bool HeightPyramid::intersect_cell(int row, int column, glm::vec3 const& o, glm::vec3 const& d, float t0, float t1, float& t) const {
+    // h(u, v) = a + b u + c v + e u v over the cell (u along the rows, v along the columns)
+    const float h00 = field->at(row, column);
+    const float b = field->at(row + 1, column) - h00;
+    const float c = field->at(row, column + 1) - h00;
+    const float e = field->at(row + 1, column + 1) - h00 - b - c;
+
+    // y(s) - h(s) = A s^2 + B s + C, s = t - t0 (relative to the entry point: small numbers)
+    const glm::vec3 p = o + d * t0;
+    const float u = p.x - static_cast<float>(row);
+    const float v = p.z - static_cast<float>(column);
+    const float A = -e * d.x * d.z;
+    const float B = d.y - (b * d.x + c * d.z + e * (u * d.z + v * d.x));
+    const float C = p.y - (h00 + b * u + c * v + e * u * v);
+    if (C <= 0.0f) {
+        t = t0;     // enters the cell below the surface
+        return true;
+    }
+    float s;
+    if (A == 0.0f) {
+        if (B >= 0.0f)
+            return false;
+        s = -C / B;
+    }
+    else {
+        const float discriminant = B * B - 4.0f * A * C;
+        if (discriminant < 0.0f)
+            return false;
+        // smallest non-negative root, without cancellation
+        const float q = -0.5f * (B + std::copysign(std::sqrt(discriminant), B));
+        const float r0 = q / A;
+        const float r1 = q != 0.0f ? C / q : r0;
+        s = std::numeric_limits<float>::max();
+        if (r0 >= 0.0f) s = r0;
+        if (r1 >= 0.0f) s = std::min(s, r1);
+    }
+    if (s > t1 - t0)
+        return false;
+    t = t0 + s;
+    return true;
+}
+
+void HeightPyramid::finish(int row, int column, glm::vec3 const& o, glm::vec3 const& d, float t, glm::vec3 const& origin,
+    glm::vec3 const& direction, Hit& hit) const {
+    const glm::vec3 p = o + d * t;
+    const float u = std::min(std::max(p.x - static_cast<float>(row), 0.0f), 1.0f);
+    const float v = std::min(std::max(p.z - static_cast<float>(column), 0.0f), 1.0f);
+    const float h00 = field->at(row, column);
+    const float b = field->at(row + 1, column) - h00;
+    const float c = field->at(row, column + 1) - h00;
+    const float e = field->at(row + 1, column + 1) - h00 - b - c;
+    hit.hit = true;
+    hit.t = t;
+    hit.position = origin + direction * t;
+    hit.normal = glm::normalize(glm::vec3(-(b + e * v), 1.0f, -(c + e * u)));  // as Heightfield::normal()
+}
+
+bool HeightPyramid::raycast(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, Hit& hit) const {
+    hit = Hit{};
+    if (levels.empty())
+        return false;
+    const int rows = field->rows();
+    const int columns = field->columns();
+    const glm::vec3 o(origin.x + rows * 0.5f, origin.y, origin.z + columns * 0.5f);  // sample space
+    const glm::vec3 inv(safe_inverse(direction.x), safe_inverse(direction.y), safe_inverse(direction.z));
+
+    // children front to back: the near half along x and z first
+    const int near_x = inv.x >= 0.0f ? 0 : 1;
+    const int near_z = inv.z >= 0.0f ? 0 : 1;
+    const int order[4][2] = { { near_x, near_z }, { near_x, 1 - near_z }, { 1 - near_x, near_z }, { 1 - near_x, 1 - near_z } };
+
+    struct Node {
+        int level, x, z;
+        float t0;       // where the ray enters the block
+    };
+    Node stack[4 * 32];     // a pop pushes at most 4: 3 per level + 1
+    int top = 0;
+    float best = max_t;
+    int best_row = -1, best_column = -1;
+    auto push = [&](int level, int x, int z) {
+        Level const& l = levels[level];
+        if (x >= l.rows || z >= l.columns)
+            return;
+        const int size = 2 << level;    // cells per block side
+        glm::vec2 const& range = l.range[l.index(x, z)];
+        const glm::vec3 lo(static_cast<float>(x * size), range.x, static_cast<float>(z * size));
+        const glm::vec3 hi(static_cast<float>(std::min((x + 1) * size, rows - 1)), range.y, static_cast<float>(std::min((z + 1) * size, columns - 1)));
+        float t0 = 0.0f, t1 = best;
+        if (clip(lo, hi, o, inv, t0, t1))
+            stack[top++] = Node{ level, x, z, t0 };
+    };
+
+    push(static_cast<int>(levels.size()) - 1, 0, 0);
+    while (top > 0) {
+        const Node node = stack[--top];
+        if (node.t0 > best)
+            continue;   // a nearer hit was found after the push
+        if (node.level > 0) {
+            for (int i = 3; i >= 0; --i)    // the nearest child on top
+                push(node.level - 1, node.x * 2 + order[i][0], node.z * 2 + order[i][1]);
+            continue;
+        }
+        // 2x2 cells: exact
+        glm::vec2 const& range = levels[0].range[levels[0].index(node.x, node.z)];
+        for (auto const& child : order) {
+            const int row = node.x * 2 + child[0];
+            const int column = node.z * 2 + child[1];
+            if (row >= rows - 1 || column >= columns - 1)
+                continue;
+            float t0 = 0.0f, t1 = best, t;
+            if (clip(glm::vec3(static_cast<float>(row), range.x, static_cast<float>(column)),
+                glm::vec3(static_cast<float>(row + 1), range.y, static_cast<float>(column + 1)), o, inv, t0, t1)
+                && intersect_cell(row, column, o, direction, t0, t1, t) && t < best) {
+                best = t;
+                best_row = row;
+                best_column = column;
+            }
+        }
+    }
+    if (best_row < 0)
+        return false;
+    finish(best_row, best_column, o, direction, best, origin, direction, hit);
+    return true;
+}
+
+void HeightPyramid::raycast(Ray const* rays, size_t count, Hit* hits) const {
+    JobSystem::instance().parallel_for(0, count, 1024, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            raycast(rays[i].origin, rays[i].direction, rays[i].max_t, hits[i]);
+        });
+}
+
+bool HeightPyramid::raycast_reference(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, Hit& hit) const {
+    hit = Hit{};
+    if (levels.empty())
+        return false;
+    const int rows = field->rows();
+    const int columns = field->columns();
+    const glm::vec3 o(origin.x + rows * 0.5f, origin.y, origin.z + columns * 0.5f);
+    const glm::vec3 inv(safe_inverse(direction.x), safe_inverse(direction.y), safe_inverse(direction.z));
+    glm::vec2 const& range = levels.back().range[0];
+    float t0 = 0.0f, t1 = max_t;
+    if (!clip(glm::vec3(0.0f, range.x, 0.0f), glm::vec3(static_cast<float>(rows - 1), range.y, static_cast<float>(columns - 1)), o, inv, t0, t1))
+        return false;
+
+    // walk the cells in the order the ray crosses them, the first hit is the nearest
+    const glm::vec3 p = o + direction * t0;
+    int row = std::min(std::max(static_cast<int>(std::floor(p.x)), 0), rows - 2);
+    int column = std::min(std::max(static_cast<int>(std::floor(p.z)), 0), columns - 2);
+    const int step_x = inv.x >= 0.0f ? 1 : -1;
+    const int step_z = inv.z >= 0.0f ? 1 : -1;
+    // t of the next cell borders, from the cell index each time (summing up the steps drifts over long rays)
+    auto border_x = [&](int r) { return (static_cast<float>(step_x > 0 ? r + 1 : r) - o.x) * inv.x; };
+    auto border_z = [&](int c) { return (static_cast<float>(step_z > 0 ? c + 1 : c) - o.z) * inv.z; };
+    float enter = t0;
+    for (;;) {
+        const float next_x = border_x(row);
+        const float next_z = border_z(column);
+        const float exit = std::min(std::min(next_x, next_z), t1);
+        float t;
+        if (intersect_cell(row, column, o, direction, enter, std::max(exit, enter), t)) {
+            finish(row, column, o, direction, t, origin, direction, hit);
+            return true;
+        }
+        if (exit >= t1)
+            return false;
+        if (next_x < next_z)
+            row += step_x;
+        else
+            column += step_z;
+        if (row < 0 || row >= rows - 1 || column < 0 || column >= columns - 1)
+            return false;
+        enter = std::max(enter, exit);
+    }
+}
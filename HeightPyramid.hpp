@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Heightfield.hpp"
+
+// Min/max pyramid over a Heightfield for exact ray and segment queries against the terrain.
+// A cell is the square between four samples; level k of the pyramid stores the height range of blocks of 2^(k+1) x 2^(k+1)
+// cells. A ray descends front to back into the blocks whose box it crosses, and is intersected with the bilinear surface
+// of the cells at the bottom (the surface of Heightfield::height(), the intersection is a quadratic per cell).
+// Coordinates are local terrain coordinates as in Heightfield; the terrain ends at the edge of the map.
+// The pyramid keeps a pointer to the heightfield: build() again when it moves, update() the region of changed heights.
+//
+//   pyramid.build(heightfield);
+//   pyramid.update(region);                                     // after heightfield.set() inside region
+//   HeightPyramid::Hit hit;
+//   if (pyramid.raycast(origin, direction, max_t, hit)) ...     // hit.t in units of direction
+//   pyramid.segment(from, to, hit);                             // e.g. one simulation step of a projectile
+//   pyramid.raycast(rays, count, hits);                         // many rays, split over the job system
+class HeightPyramid {
+public:
+    struct Ray {
+        glm::vec3 origin{ 0.0f };
+        glm::vec3 direction{ 0.0f, -1.0f, 0.0f };
+        float max_t = std::numeric_limits<float>::max();
+    };
+
+    struct Hit {
+        bool hit = false;
+        float t = 0.0f;                     // origin + t * direction
+        glm::vec3 position{ 0.0f };
+        glm::vec3 normal{ 0.0f, 1.0f, 0.0f };   // of the bilinear surface
+    };
+
+    void build(Heightfield const& heights);    // levels in parallel rows (job system)
+    void update(HeightRegion const& samples);  // the blocks over the samples and their parents, cost of the region size
+    void clear(void);
+    bool empty(void) const { return levels.empty(); }
+    size_t memory_bytes(void) const;
+
+    // a ray starting below the surface hits at the point where it enters the map
+    bool raycast(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, Hit& hit) const;
+    bool segment(glm::vec3 const& from, glm::vec3 const& to, Hit& hit) const { return raycast(from, to - from, 1.0f, hit); }
+    void raycast(Ray const* rays, size_t count, Hit* hits) const;
+    bool raycast_reference(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, Hit& hit) const;    // every cell along the ray (2D DDA), no pyramid
+
+private:
+    struct Level {
+        int rows = 0, columns = 0;          // blocks
+        std::vector<glm::vec2> range{};     // (min, max) height per block, row major
+        size_t index(int x, int z) const { return static_cast<size_t>(x) * columns + z; }
+        void resize(void) { range.resize(static_cast<size_t>(rows) * columns); }
+    };
+
+    Heightfield const* field = nullptr;
+    std::vector<Level> levels{};            // finest (2x2 cells) first
+
+    glm::vec2 block_range(int level, int x, int z) const;  // from the samples (level 0) or the finer level
+    // ray in sample space (x = row, z = column coordinate), exact intersection within the cell for t in [t0, t1]
+    bool intersect_cell(int row, int column, glm::vec3 const& o, glm::vec3 const& d, float t0, float t1, float& t) const;
+    void finish(int row, int column, glm::vec3 const& o, glm::vec3 const& d, float t, glm::vec3 const& origin,
+        glm::vec3 const& direction, Hit& hit) const;
+};
@@ -0,0 +1,208 @@
+// Scalar and AVX2 paths of the heightfield queries, see Heightfield.hpp
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Heightfield.hpp"
+
+void Heightfield::resize(int columns, int rows) {
+    column_count = std::max(columns, 0);
+    row_count = std::max(rows, 0);
+    stride = (column_count + 15) / 16 * 16;     // 64 bytes of floats
+    if (stride > 0 && stride % 1024 == 0)       // 4 KB of floats (and 2 KB of 16-bit samples): one more cache line
+        stride += 16;
+    half_rows = row_count * 0.5f;
+    half_columns = column_count * 0.5f;
+    last_row = static_cast<float>(row_count - 1);
+    last_column = static_cast<float>(column_count - 1);
+    quantized.clear();
+    quantized.shrink_to_fit();
+    values.assign(static_cast<size_t>(stride) * row_count, 0.0f);
+    offset = 0.0f;
+    step = 1.0f;
+}
+
+void Heightfield::clear(void) {
+    resize(0, 0);
+    values.shrink_to_fit();
+}
+
+// the samples of the rows only, not the padding behind them
+float Heightfield::min_height(void) const {
+    if (empty())
+        return 0.0f;
+    float lo = std::numeric_limits<float>::max();
+    for (int row = 0; row < row_count; ++row) {
+        const size_t first = static_cast<size_t>(row) * stride;
+        lo = std::min(lo, quantized.empty() ? *std::min_element(values.begin() + first, values.begin() + first + column_count)
+            : offset + static_cast<float>(*std::min_element(quantized.begin() + first, quantized.begin() + first + column_count)) * step);
+    }
+    return lo;
+}
+
+float Heightfield::max_height(void) const {
+    if (empty())
+        return 0.0f;
+    float hi = std::numeric_limits<float>::lowest();
+    for (int row = 0; row < row_count; ++row) {
+        const size_t first = static_cast<size_t>(row) * stride;
+        hi = std::max(hi, quantized.empty() ? *std::max_element(values.begin() + first, values.begin() + first + column_count)
+            : offset + static_cast<float>(*std::max_element(quantized.begin() + first, quantized.begin() + first + column_count)) * step);
+    }
+    return hi;
+}
+
+void Heightfield::quantize(void) {
+    if (!quantized.empty() || values.empty())
+        return;
+    const float lo = min_height();
+    const float hi = max_height();
+    offset = lo;
+    step = hi > lo ? (hi - lo) / 65535.0f : 1.0f;
+    quantized.resize(values.size() + 1, 0);
+    for (size_t i = 0; i < values.size(); ++i)     // the padding too, it is never read
+        quantized[i] = static_cast<std::uint16_t>(std::lround(std::min(std::max((values[i] - lo) / step, 0.0f), 65535.0f)));
+    values.clear();
+    values.shrink_to_fit();
+}
+
+// past h by an eighth of the new range: a crater dug a little deeper at every hit widens it once in a while, not each time
+void Heightfield::widen(float h) {
+    if (!std::isfinite(h))
+        return;
+    float lo = offset;
+    float hi = offset + 65535.0f * step;
+    const float margin = (std::max(hi, h) - std::min(lo, h)) * 0.125f;
+    if (h < lo)
+        lo = h - margin;
+    else
+        hi = h + margin;
+    const float widened = (hi - lo) / 65535.0f;
+    for (std::uint16_t& q : quantized)
+        q = static_cast<std::uint16_t>(std::lround(std::min(std::max((offset + static_cast<float>(q) * step - lo) / widened, 0.0f), 65535.0f)));
+    offset = lo;
+    step = widened;
+}
+
+glm::vec3 Heightfield::normal(float x, float z) const {
+    glm::vec3 n(0.0f, 1.0f, 0.0f);
+    sample_scalar(&x, &z, 1, nullptr, &n.x, &n.y, &n.z);
+    return n;
+}
+
+void Heightfield::sample_scalar(float const* x, float const* z, size_t count, float* heights, float* nx, float* ny, float* nz) const {
+    if (row_count < 2 || column_count < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            if (heights) heights[i] = empty() ? 0.0f : at(0, 0);
+            if (nx) { nx[i] = 0.0f; ny[i] = 1.0f; nz[i] = 0.0f; }
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // sample space, clamped to the map
+        const float fx = std::min(std::max(0.0f, x[i] + half_rows), last_row);
+        const float fz = std::min(std::max(0.0f, z[i] + half_columns), last_column);
+        const int ix = std::min(static_cast<int>(fx), row_count - 2);
+        const int iz = std::min(static_cast<int>(fz), column_count - 2);
+        const float tx = fx - static_cast<float>(ix);
+        const float tz = fz - static_cast<float>(iz);
+
+        float h00, h01, h10, h11;
+        corners(ix, iz, h00, h01, h10, h11);
+
+        const float h0 = h00 + (h10 - h00) * tx;
+        const float h1 = h01 + (h11 - h01) * tx;
+        if (heights)
+            heights[i] = h0 + (h1 - h0) * tz;
+        if (nx) {
+            // slopes of the bilinear surface along x and z
+            const float dx = (h10 - h00) + ((h11 - h01) - (h10 - h00)) * tz;
+            const float dz = (h01 - h00) + ((h11 - h10) - (h01 - h00)) * tx;
+            const float inv = 1.0f / std::sqrt(dx * dx + 1.0f + dz * dz);
+            nx[i] = -dx * inv;
+            ny[i] = inv;
+            nz[i] = -dz * inv;
+        }
+    }
+}
+
+int Heightfield::lanes(void) {
+#ifdef __AVX2__
+    return 8;
+#else
+    return 1;
+#endif
+}
+
+void Heightfield::sample(float const* x, float const* z, size_t count, float* heights, float* nx, float* ny, float* nz) const {
+    size_t i = 0;
+#ifdef __AVX2__
+    if (row_count >= 2 && column_count >= 2) {
+        const __m256 half_rows_8 = _mm256_set1_ps(half_rows);
+        const __m256 half_columns_8 = _mm256_set1_ps(half_columns);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 last_row_8 = _mm256_set1_ps(last_row);
+        const __m256 last_column_8 = _mm256_set1_ps(last_column);
+        const __m256i max_ix = _mm256_set1_epi32(row_count - 2);
+        const __m256i max_iz = _mm256_set1_epi32(column_count - 2);
+        const __m256i row_step = _mm256_set1_epi32(stride);
+        const __m256i next = _mm256_set1_epi32(1);
+        const __m256i low16 = _mm256_set1_epi32(0xffff);
+        const __m256 q_offset = _mm256_set1_ps(offset);
+        const __m256 q_step = _mm256_set1_ps(step);
+        const bool is_quantized = !quantized.empty();
+        const float* fdata = values.data();
+        const int* qdata = reinterpret_cast<const int*>(quantized.data());
+
+        // 32-bit gather of 16-bit samples: the upper half belongs to the next sample (or the padding), masked off
+        auto gather = [&](__m256i index) {
+            if (!is_quantized)
+                return _mm256_i32gather_ps(fdata, index, 4);
+            __m256i q = _mm256_and_si256(_mm256_i32gather_epi32(qdata, index, 2), low16);
+            return _mm256_add_ps(q_offset, _mm256_mul_ps(_mm256_cvtepi32_ps(q), q_step));
+        };
+        // same operation order as sample_scalar(), so both paths give the same results
+        auto lerp = [](__m256 a, __m256 b, __m256 t) { return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t)); };
+
+        for (; i + 8 <= count; i += 8) {
+            const __m256 fx = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(x + i), half_rows_8), zero), last_row_8);
+            const __m256 fz = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(z + i), half_columns_8), zero), last_column_8);
+            const __m256i ix = _mm256_min_epi32(_mm256_cvttps_epi32(fx), max_ix);
+            const __m256i iz = _mm256_min_epi32(_mm256_cvttps_epi32(fz), max_iz);
+            const __m256 tx = _mm256_sub_ps(fx, _mm256_cvtepi32_ps(ix));
+            const __m256 tz = _mm256_sub_ps(fz, _mm256_cvtepi32_ps(iz));
+
+            const __m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(ix, row_step), iz);
+            const __m256i i10 = _mm256_add_epi32(i00, row_step);
+            const __m256 h00 = gather(i00);
+            const __m256 h01 = gather(_mm256_add_epi32(i00, next));
+            const __m256 h10 = gather(i10);
+            const __m256 h11 = gather(_mm256_add_epi32(i10, next));
+
+            const __m256 h0 = lerp(h00, h10, tx);
+            const __m256 h1 = lerp(h01, h11, tx);
+            if (heights)
+                _mm256_storeu_ps(heights + i, lerp(h0, h1, tz));
+            if (nx) {
+                const __m256 dx = lerp(_mm256_sub_ps(h10, h00), _mm256_sub_ps(h11, h01), tz);
+                const __m256 dz = lerp(_mm256_sub_ps(h01, h00), _mm256_sub_ps(h11, h10), tx);
+                const __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), one), _mm256_mul_ps(dz, dz));
+                const __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(length2));
+                const __m256 sign = _mm256_set1_ps(-0.0f);
+                _mm256_storeu_ps(nx + i, _mm256_mul_ps(_mm256_xor_ps(dx, sign), inv));
+                _mm256_storeu_ps(ny + i, inv);
+                _mm256_storeu_ps(nz + i, _mm256_mul_ps(_mm256_xor_ps(dz, sign), inv));
+            }
+        }
+    }
+#endif
+    // remaining queries
+    sample_scalar(x + i, z + i, count - i, heights ? heights + i : nullptr,
+        nx ? nx + i : nullptr, ny ? ny + i : nullptr, nz ? nz + i : nullptr);
+}
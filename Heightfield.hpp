@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// std::vector storage on cache line boundaries
+template <class T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator(void) = default;
+    template <class U> AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template <class U> bool operator==(AlignedAllocator<U, Alignment> const&) const { return true; }
+    template <class U> bool operator!=(AlignedAllocator<U, Alignment> const&) const { return false; }
+};
+
+// Rectangle of samples: rows [row, row + rows), columns [column, column + columns)
+struct HeightRegion {
+    int row = 0, column = 0;
+    int rows = 0, columns = 0;
+
+    bool empty(void) const { return rows <= 0 || columns <= 0; }
+    HeightRegion clipped(int map_columns, int map_rows) const {
+        HeightRegion r;
+        r.row = std::max(row, 0);
+        r.column = std::max(column, 0);
+        r.rows = std::min(row + rows, map_rows) - r.row;
+        r.columns = std::min(column + columns, map_columns) - r.column;
+        return r;
+    }
+};
+
+// Terrain heights in one contiguous, aligned array (row major: row = x, column = z, as the Heightmap mesh),
+// either as floats or quantized to 16 bits (half the memory, step = (max - min) / 65535).
+// A set() outside the range of the 16 bits widens it: every sample is quantized again (cost of the map, not of the
+// edit, and each sample moves by up to half a step); quantization_offset() / quantization_step() then change.
+// Rows start row_stride() samples apart: the columns rounded up to a cache line, never a multiple of 4 KB, so the
+// two rows of a bilinear query do not alias in the L1 cache (the power-of-two maps would, 8 KB apart).
+// Uploads of whole rows need GL_UNPACK_ROW_LENGTH = row_stride().
+// Queries take local terrain coordinates (the mesh is centered: x in [-rows/2, rows/2 - 1]), are bilinear between
+// the samples and clamped at the edges. sample() answers many queries at once, 8 per iteration with AVX2 gathers
+// (when compiled with /arch:AVX2 or -mavx2, as my_app.vcxproj does); its results are identical to the one-by-one
+// height() / normal().
+//
+//   heightfield.resize(columns, rows);  heightfield.set(row, column, h);  ...  heightfield.quantize();
+//   heightfield.set(row, column, h);                       // also later (terrain deformation), either storage
+//   float y = heightfield.height(x, z);
+//   heightfield.sample(xs, zs, count, ys, nx, ny, nz);     // heights or normals (all three) may be nullptr
+class Heightfield {
+public:
+    enum class Storage { Float, Quantized16 };
+
+    void resize(int columns, int rows);             // float storage, all heights 0
+    void quantize(void);                            // float -> 16-bit storage
+    void clear(void);
+
+    int columns(void) const { return column_count; }
+    int rows(void) const { return row_count; }
+    bool empty(void) const { return column_count == 0 || row_count == 0; }
+    Storage storage(void) const { return quantized.empty() ? Storage::Float : Storage::Quantized16; }
+    int row_stride(void) const { return stride; }  // samples from one row to the next, both storages
+    size_t memory_bytes(void) const { return values.capacity() * sizeof(float) + quantized.capacity() * sizeof(std::uint16_t); }
+
+    void set(int row, int column, float h) {
+        const size_t i = static_cast<size_t>(row) * stride + column;
+        if (quantized.empty()) {
+            values[i] = h;
+            return;
+        }
+        if (!(h >= offset && h <= offset + 65535.0f * step))    // rare: deeper or higher than the range
+            widen(h);
+        quantized[i] = static_cast<std::uint16_t>(std::lround(std::min(std::max((h - offset) / step, 0.0f), 65535.0f)));
+    }
+    float* row_data(int row) { return values.data() + static_cast<size_t>(row) * stride; }              // float storage only
+    float const* row_data(int row) const { return values.data() + static_cast<size_t>(row) * stride; }  // float storage only
+    float at(int row, int column) const {
+        const size_t i = static_cast<size_t>(row) * stride + column;
+        return quantized.empty() ? values[i] : offset + static_cast<float>(quantized[i]) * step;
+    }
+    std::uint16_t const* quantized_data(void) const { return quantized.data(); }   // 16-bit storage only, row_stride() apart
+    float quantization_offset(void) const { return offset; }    // height = offset + sample * step
+    float quantization_step(void) const { return step; }
+    float min_height(void) const;
+    float max_height(void) const;
+
+    float height(float x, float z) const {
+        // inline: single queries sit in hot loops (tree placement, camera and collision), same math as sample_scalar()
+        if (row_count < 2 || column_count < 2)
+            return empty() ? 0.0f : at(0, 0);
+        float fx = x + half_rows;
+        float fz = z + half_columns;
+        if (!(fx >= 0.0f && fx <= last_row && fz >= 0.0f && fz <= last_column)) {     // rare: off the map
+            fx = std::min(std::max(0.0f, fx), last_row);
+            fz = std::min(std::max(0.0f, fz), last_column);
+        }
+        const int ix = std::min(static_cast<int>(fx), row_count - 2);
+        const int iz = std::min(static_cast<int>(fz), column_count - 2);
+        const float tx = fx - static_cast<float>(ix);
+        const float tz = fz - static_cast<float>(iz);
+        float h00, h01, h10, h11;
+        corners(ix, iz, h00, h01, h10, h11);
+        const float h0 = h00 + (h10 - h00) * tx;
+        const float h1 = h01 + (h11 - h01) * tx;
+        return h0 + (h1 - h0) * tz;
+    }
+    glm::vec3 normal(float x, float z) const;       // normal of the bilinear surface
+    void sample(float const* x, float const* z, size_t count, float* heights,
+        float* nx = nullptr, float* ny = nullptr, float* nz = nullptr) const;
+    void sample_scalar(float const* x, float const* z, size_t count, float* heights,
+        float* nx = nullptr, float* ny = nullptr, float* nz = nullptr) const;   // reference path
+    static int lanes(void);                         // queries per iteration of sample() in this build: 8 (AVX2) or 1
+
+private:
+    int column_count = 0, row_count = 0;
+    int stride = 0;
+    float half_rows = 0.0f, half_columns = 0.0f;    // map center, sample space
+    float last_row = 0.0f, last_column = 0.0f;      // clamp of the queries
+    std::vector<float, AlignedAllocator<float>> values{};
+    std::vector<std::uint16_t, AlignedAllocator<std::uint16_t>> quantized{};   // one padding sample for the 32-bit gathers
+    float offset = 0.0f;
+    float step = 1.0f;
+
+    void widen(float h);                            // quantized range over h, all samples quantized again
+
+    // the samples (row, column), (row, column + 1), (row + 1, column), (row + 1, column + 1): the storage is checked once
+    void corners(int row, int column, float& h00, float& h01, float& h10, float& h11) const {
+        const size_t i = static_cast<size_t>(row) * stride + column;
+        if (quantized.empty()) {
+            float const* s = values.data() + i;
+            h00 = s[0];
+            h01 = s[1];
+            h10 = s[stride];
+            h11 = s[stride + 1];
+        }
+        else {
+            std::uint16_t const* q = quantized.data() + i;
+            h00 = offset + static_cast<float>(q[0]) * step;
+            h01 = offset + static_cast<float>(q[1]) * step;
+            h10 = offset + static_cast<float>(q[stride]) * step;
+            h11 = offset + static_cast<float>(q[stride + 1]) * step;
+        }
+    }
+};
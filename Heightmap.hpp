@@ -6,160 +6,252 @@
 #include <vector> 
 #include <glm/glm.hpp> 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include "assets.hpp"
-#include "Mesh.hpp"
 #include "ShaderProgram.hpp"
+#include "SceneGraph.hpp"
+#include "JobSystem.hpp"
+#include "TerrainLod.hpp"
+#include "Heightfield.hpp"
+#include "TerrainPager.hpp"
+#include "TerrainNoise.hpp"
+#ifndef HEIGHTMAP_NO_STB_IMPLEMENTATION    // defined by translation units that include this header besides the application
 #define STB_IMAGE_IMPLEMENTATION
+#endif
 #include "stb_image.h"
 
 class Heightmap {
 public:
-    std::vector<Mesh> meshes;
+    enum class Rendering {
+        Lod,            // CDLOD patches (TerrainLod)
+        Full,           // every sample, pulled from the height texture
+        Tessellated     // patches subdivided by their on-screen size, needs the terrain_tess.* program
+    };
+
     std::string name;
     glm::vec3 origin{0.0};
     glm::vec3 orientation{0.0};  //rotation by x,y,z axis, in radians
     glm::vec3 scale{1.0};
-    glm::mat4 local_model_matrix = glm::identity<glm::mat4>();
-    glm::mat3 normal_matrix = glm::identity<glm::mat3>(); //for normals calculation
+    SceneGraph::NodeId node{ SceneGraph::no_node }; // transform node of the terrain
     GLuint texture_id{ 0 };
+    int texture_layer{ 0 };
+    Rendering rendering{ Rendering::Lod };
     ShaderProgram shader;
-    std::vector<vertex> vertices{};
-    GLuint NUM_STRIPS = 0;
-    GLuint NUM_VERTS_PER_STRIP = 0;
+    TerrainLod lod;         // height texture on the GPU and the draws of all modes
     int width = 1;
     int height = 1;
-    std::vector<std::vector<float>> heightmap{};
+    Heightfield heightmap;  // heights for collision queries, also the source of the height texture
 
     Heightmap() 
         :origin(0.0f), 
         orientation(0.0f), 
         scale(1.0f), 
-        local_model_matrix(glm::identity<glm::mat4>()), 
-        normal_matrix(glm::identity<glm::mat3>()),
+        node(SceneGraph::no_node),
         texture_id(0),
-        NUM_STRIPS(0),
-        NUM_VERTS_PER_STRIP(0),
         width(1),
         height(1)
     {}
 
-    Heightmap(const std::filesystem::path& filename, ShaderProgram shader, GLuint const texture_id = 0) {
+    // Only the heights are uploaded (see TerrainLod), no vertex buffer. shader: lighting_shader, or the tessellation
+    // program for Rendering::Tessellated. quantized: 16-bit heights, on the CPU and on the GPU.
+    Heightmap(const std::filesystem::path& filename, ShaderProgram shader, GLuint const texture_id = 0, int texture_layer = 0,
+        Rendering rendering = Rendering::Lod, bool quantized = false)
+        : texture_id(texture_id),
+        texture_layer(texture_layer),
+        rendering(rendering),
+        shader(shader)
+    {
         
-        // 1. load height map texture
+        // 1. load height map texture, 16-bit images (e.g. PNG) at full precision
+        const std::string file = filename.string();
         int nChannels;
         //stbi_set_flip_vertically_on_load(true);
-        unsigned char* data = stbi_load(filename.string().c_str(), &width, &height, &nChannels, 0);
+        const bool wide = stbi_is_16_bit(file.c_str()) != 0;
+        void* data = wide ? static_cast<void*>(stbi_load_16(file.c_str(), &width, &height, &nChannels, 0))
+            : static_cast<void*>(stbi_load(file.c_str(), &width, &height, &nChannels, 0));
         if (!data) {
             std::cerr << "Failed to load heightmap named: " << filename << std::endl;
             return;
         }
-        std::cout << "Loaded heightmap named: " << filename << std::endl;
-        // 2. vertex generation
-        std::vector<std::vector<float>> getheightmap(height, std::vector<float>(width)); // Needed for collision detection
-        float yScale = 64.0f / 255.0f, yShift = 16.0f, xzScale = 1.0f;;  // apply a scale+shift to the height data
-
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {                
-                // computing normals from height differences
-                int xm = std::max(i - 1, 0);
-                int xp = std::min(i + 1, (int)height - 1);
-                int zm = std::max(j - 1, 0);
-                int zp = std::min(j + 1, (int)width - 1);
-
-                // Heights
-                auto getHeight = [&](int row, int col) {
-                    row = glm::clamp(row, 0, height - 1);
-                    col = glm::clamp(col, 0, width - 1);
-                    unsigned char* texel = data + (col + width * row) * nChannels;
-                    return static_cast<float>(texel[0]) * yScale - yShift;
-                    };
+        std::cout << "Loaded heightmap named: " << filename << (wide ? " (16 bit)" : "") << std::endl;
+        // 2. heights
+        if (wide)
+            load_heights(static_cast<stbi_us const*>(data), width, height, nChannels, heightmap);
+        else
+            load_heights(static_cast<stbi_uc const*>(data), width, height, nChannels, heightmap);
+        stbi_image_free(data);
+        if (quantized)
+            heightmap.quantize();
+
+        // 3. height texture and quadtree
+        lod.create(shader, heightmap);
+        const size_t mesh_bytes = static_cast<size_t>(width) * height * sizeof(vertex) + static_cast<size_t>(height - 1) * width * 2 * sizeof(GLuint);
+        std::cout << "Terrain on the GPU: " << lod.gpu_bytes() / 1024 << " KB (a vertex mesh would be " << mesh_bytes / 1024 << " KB)" << std::endl;
+    }
+
+    // Generated instead of loaded: size x size samples of the noise (rows in parallel), otherwise as above
+    Heightmap(TerrainNoise const& noise, int size, ShaderProgram shader, GLuint const texture_id = 0, int texture_layer = 0,
+        Rendering rendering = Rendering::Lod, bool quantized = false)
+        : texture_id(texture_id),
+        texture_layer(texture_layer),
+        rendering(rendering),
+        shader(shader),
+        width(size),
+        height(size)
+    {
+        noise.fill(heightmap, size, size);
+        std::cout << "Generated heightmap: " << size << "x" << size << ", seed " << noise.parameters().seed << std::endl;
+        if (quantized)
+            heightmap.quantize();
+        lod.create(shader, heightmap);
+    }
 
-                float h = getHeight(i,j);
-                // store for later collision queries
-                getheightmap[i][j] = h;
-                float heightscale = 1.0f;
-                glm::vec3 pL = glm::vec3(-height / 2.0f + (i - 1), getHeight(i - 1, j) * heightscale, -width / 2.0f + j);
-                glm::vec3 pR = glm::vec3(-height / 2.0f + (i + 1), getHeight(i + 1, j) * heightscale, -width / 2.0f + j);
-                glm::vec3 pD = glm::vec3(-height / 2.0f + i, getHeight(i, j - 1) * heightscale, -width / 2.0f + (j - 1));
-                glm::vec3 pU = glm::vec3(-height / 2.0f + i, getHeight(i, j + 1) * heightscale, -width / 2.0f + (j + 1));
-                // Build tangent vectors
-                glm::vec3 dX = pR - pL;
-                glm::vec3 dZ = pU - pD;
-                // Normal is perpendicular to both
-                glm::vec3 N = glm::normalize(glm::cross(dZ, dX));
-
-                // vertex
-                vertex v;
-                v.position = glm::vec3(-height / 2.0f + i, h, -width / 2.0f + j);
-                v.normal = N;
-                v.texcoord = glm::vec2(static_cast<float>(j) / (width - 1), static_cast<float>(i) / (height - 1));
-                vertices.push_back(v);               
+    // Heights and CPU vertices (position, normal from the height differences, texcoord) of an 8- or 16-bit height image.
+    // The renderer needs only the heights; the vertices are the same surface as the shaders produce (e.g. for export).
+    template <class Texel>
+    static void generate(Texel const* data, int width, int height, int nChannels,
+        std::vector<vertex>& vertices, Heightfield& heights) {
+        load_heights(data, width, height, nChannels, heights);
+        build_vertices(heights, vertices);
+    }
+
+    // First channel of every texel -> height table (collision queries, LOD patches); both bit depths span the same range.
+    // Rows are converted in parallel by the job system.
+    template <class Texel>
+    static void load_heights(Texel const* data, int width, int height, int nChannels, Heightfield& heights) {
+        const float yScale = 64.0f / static_cast<float>(std::numeric_limits<Texel>::max()), yShift = 16.0f;  // apply a scale+shift to the height data
+
+        heights.resize(width, height);
+        JobSystem::instance().parallel_for(0, static_cast<size_t>(height), 64, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                Texel const* texel = data + i * width * nChannels;
+                float* row = heights.row_data(static_cast<int>(i));
+                for (int j = 0; j < width; j++)
+                    row[j] = static_cast<float>(texel[static_cast<size_t>(j) * nChannels]) * yScale - yShift;
             }
-        }
-        heightmap = getheightmap;
-          
-        stbi_image_free(data);
+            });
+    }
 
-        // 3. index generation
-        std::vector<GLuint> indices;
-        for (GLuint i = 0; i < height - 1; i++)       // for each row a.k.a. each strip
-        {
-            for (GLuint j = 0; j < width; j++)      // for each column
+    // One vertex per sample into a pre-sized array, rows in parallel. Normal from central differences (clamped at the edges):
+    // (-dh/dx, 2, -dh/dz) with dh/dx = h[i+1][j] - h[i-1][j] between rows, dh/dz = h[i][j+1] - h[i][j-1] within a row,
+    // the same as the cross product of the two tangents. The inner loop of a row is branch free.
+    static void build_vertices(Heightfield const& heights, std::vector<vertex>& vertices) {
+        const int width = heights.columns();
+        const int height = heights.rows();
+        vertices.resize(static_cast<size_t>(width) * height);
+        if (width < 2 || height < 2)
+            return;
+
+        JobSystem::instance().parallel_for(0, static_cast<size_t>(height), 16, [&](size_t first, size_t last) {
+            for (int i = static_cast<int>(first); i < static_cast<int>(last); i++)
             {
-                for (GLuint k = 0; k < 2; k++)      // for each side of the strip
-                {
-                    indices.push_back(j + width * (i + k));
-                }
+                float const* above = heights.row_data(std::max(i - 1, 0));
+                float const* row = heights.row_data(i);
+                float const* below = heights.row_data(std::min(i + 1, height - 1));
+                vertex* out = vertices.data() + static_cast<size_t>(i) * width;
+                const float x = -height / 2.0f + i;
+                const float v = static_cast<float>(i) / (height - 1);
+
+                auto emit = [&](int j, float dx, float dz) {
+                    const float inv = 1.0f / std::sqrt(dx * dx + 4.0f + dz * dz);
+                    out[j].position = glm::vec3(x, row[j], -width / 2.0f + j);
+                    out[j].normal = glm::vec3(-dx * inv, 2.0f * inv, -dz * inv);
+                    out[j].texcoord = glm::vec2(static_cast<float>(j) / (width - 1), v);
+                    };
+                emit(0, below[0] - above[0], row[1] - row[0]);
+                for (int j = 1; j < width - 1; j++)
+                    emit(j, below[j] - above[j], row[j + 1] - row[j - 1]);
+                emit(width - 1, below[width - 1] - above[width - 1], row[width - 1] - row[width - 2]);
             }
-        }
+            });
+    }
 
-        NUM_STRIPS = height - 1;
-        NUM_VERTS_PER_STRIP = width * 2;
+    // Heights of an 8- or 16-bit image without anything on the GPU (tools, benchmarks)
+    static bool load_heightfield(const std::filesystem::path& image, Heightfield& heights) {
+        const std::string file = image.string();
+        int w, h, nChannels;
+        const bool wide = stbi_is_16_bit(file.c_str()) != 0;
+        void* data = wide ? static_cast<void*>(stbi_load_16(file.c_str(), &w, &h, &nChannels, 0))
+            : static_cast<void*>(stbi_load(file.c_str(), &w, &h, &nChannels, 0));
+        if (!data) {
+            std::cerr << "Failed to load heightmap named: " << image << std::endl;
+            return false;
+        }
+        if (wide)
+            load_heights(static_cast<stbi_us const*>(data), w, h, nChannels, heights);
+        else
+            load_heights(static_cast<stbi_uc const*>(data), w, h, nChannels, heights);
+        stbi_image_free(data);
+        return true;
+    }
 
-        Mesh Mesh(GL_TRIANGLE_STRIP, shader, vertices, indices, origin, orientation, texture_id, NUM_STRIPS, NUM_VERTS_PER_STRIP);
-        /* Mesh mesh( primitive type, shader to use, vertex list, index list,
-        origin for this mesh (relative to model), orientation for this mesh (relative to model));*/
+    // Height image -> tiled file of TerrainPager (offline, the whole image is in memory while baking)
+    static bool bake_tiles(const std::filesystem::path& image, const std::filesystem::path& tiles) {
+        Heightfield heights;
+        if (!load_heightfield(image, heights))
+            return false;
+        return TerrainPager::bake(tiles, heights.columns(), heights.rows(), [&](int row, float* out) {
+            std::copy_n(heights.row_data(row), heights.columns(), out);
+            });
+    }
 
-        meshes.push_back(std::move(Mesh));
+    long long triangle_count(void) const { return lod.stats().triangles; }
 
+    //------ Deformation ------: the changed samples go to the height texture, nothing else is rebuilt
+    // fn(row, column, h) -> new height of every sample in the (clipped) region. Returns the samples that changed:
+    // the whole map when a 16-bit heightfield had to widen its range (see Heightfield), the region otherwise.
+    template <class Fn>
+    HeightRegion deform(HeightRegion region, Fn&& fn) {
+        region = region.clipped(heightmap.columns(), heightmap.rows());
+        if (region.empty())
+            return region;
+        const float offset = heightmap.quantization_offset();
+        const float step = heightmap.quantization_step();
+        for (int row = region.row; row < region.row + region.rows; ++row)
+            for (int column = region.column; column < region.column + region.columns; ++column)
+                heightmap.set(row, column, fn(row, column, heightmap.at(row, column)));
+        if (heightmap.quantization_offset() != offset || heightmap.quantization_step() != step)
+            region = HeightRegion{ 0, 0, heightmap.rows(), heightmap.columns() };
+        lod.update(heightmap, region);
+        return region;
     }
 
-    void draw(glm::vec3 const& offset = glm::vec3(0.0f),
-        glm::vec3 const& rotation = glm::vec3(0.0f),
-        glm::vec3 const& scale_change = glm::vec3(1.0f)) {
+    // bowl of the given radius and depth around (x, z), local coordinates (as Heightfield::height())
+    HeightRegion crater(float x, float z, float radius, float depth) {
+        const float row = x + heightmap.rows() * 0.5f;
+        const float column = z + heightmap.columns() * 0.5f;
+        HeightRegion region;
+        region.row = static_cast<int>(std::ceil(row - radius));
+        region.column = static_cast<int>(std::ceil(column - radius));
+        region.rows = static_cast<int>(std::floor(row + radius)) - region.row + 1;
+        region.columns = static_cast<int>(std::floor(column + radius)) - region.column + 1;
+        return deform(region, [&](int r, int c, float h) {
+            const float d2 = (r - row) * (r - row) + (c - column) * (c - column);
+            return d2 < radius * radius ? h - depth * (1.0f - d2 / (radius * radius)) : h;
+            });
+    }
 
-        // compute complete transformation
-        
-        glm::mat4 t = glm::translate(glm::mat4(1.0f), origin);
-        glm::mat4 rx = glm::rotate(glm::mat4(1.0f), orientation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 ry = glm::rotate(glm::mat4(1.0f), orientation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 rz = glm::rotate(glm::mat4(1.0f), orientation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::mat4 s = glm::scale(glm::mat4(1.0f), scale);
-
-        glm::mat4 m_off = glm::translate(glm::mat4(1.0f), offset);
-        glm::mat4 m_rx = glm::rotate(glm::mat4(1.0f), rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 m_ry = glm::rotate(glm::mat4(1.0f), rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 m_rz = glm::rotate(glm::mat4(1.0f), rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::mat4 m_s = glm::scale(glm::mat4(1.0f), scale_change);
-        
-        glm::mat4 mv_m = glm::identity<glm::mat4>();
-        glm::mat4 local_model_matrix = mv_m * s * rz * ry * rx * t;
-        glm::mat4 model_matrix = local_model_matrix * m_s * m_rz * m_ry * m_rx * m_off;
-        normal_matrix = glm::mat3(glm::inverseTranspose(model_matrix));
-
-        // call draw() on mesh (all meshes)
-        for (auto& mesh : meshes) {
-            mesh.draw(model_matrix);
-        }
+    void attach(SceneGraph& graph, SceneGraph::NodeId parent = SceneGraph::no_node) {
+        node = graph.create(parent);
+        graph.setLocal(node, origin, orientation, scale);
     }
 
-    void draw() {
-        for (auto& mesh : meshes) {
-            mesh.draw(local_model_matrix);
+    void draw(SceneGraph const& graph, glm::mat4 const& view_projection, glm::vec3 const& eye) {
+        // the terrain is static, its matrices are computed once by the scene graph
+        switch (rendering) {
+        case Rendering::Lod:
+            lod.draw(shader, graph.world(node), graph.normal(node), view_projection, eye, texture_id, texture_layer);
+            break;
+        case Rendering::Full:
+            lod.draw_full(shader, graph.world(node), graph.normal(node), texture_id, texture_layer);
+            break;
+        case Rendering::Tessellated:
+            lod.draw_tessellated(shader, graph.world(node), graph.normal(node), texture_id, texture_layer);
+            break;
         }
     }
 
-};
+};
\ No newline at end of file
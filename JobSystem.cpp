@@ -0,0 +1,179 @@
+#include <string>
+
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+
+thread_local int JobSystem::thread_index = -1;
+
+void JobSystem::start(int worker_count) {
+    stop();
+    if (worker_count < 0)
+        worker_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+    main_thread = std::this_thread::get_id();
+    thread_index = 0;
+    queues.clear();
+    for (int i = 0; i <= worker_count; ++i)
+        queues.push_back(std::make_unique<Queue>());
+
+    running = true;
+    for (int i = 1; i <= worker_count; ++i)
+        workers.emplace_back(&JobSystem::worker_loop, this, i);
+}
+
+void JobSystem::stop(void) {
+    if (!running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        running = false;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+
+    // whatever is left runs here, so no counter stays pending
+    Task task;
+    while (pop(task) || pop_main(task))
+        execute(task);
+    queues.clear();
+}
+
+void JobSystem::worker_loop(int index) {
+    thread_index = index;
+    CpuProfiler::instance().set_thread_name("job worker " + std::to_string(index));
+    while (running) {
+        Task task;
+        if (pop(task)) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [&] { return !running || queued.load() > 0; });
+    }
+}
+
+void JobSystem::run(Job job, Counter* counter, Affinity affinity) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    push(Task{ std::move(job), counter }, affinity);
+}
+
+void JobSystem::run_after(Counter& dependency, Job job, Counter* counter, Affinity affinity) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);   // counts from now, so waiting for it also waits for the dependency
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (!dependency.done()) {
+            dependency.continuations.push_back(Counter::Continuation{ std::move(job), counter, affinity });
+            return;
+        }
+    }
+    push(Task{ std::move(job), counter }, affinity);
+}
+
+void JobSystem::push(Task task, Affinity affinity) {
+    if (queues.empty()) {   // not started: run inline
+        execute(task);
+        return;
+    }
+    if (affinity == Affinity::Main) {
+        if (std::this_thread::get_id() == main_thread) {
+            // already on the main thread: no reason to defer it
+            execute(task);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(main_only.mutex);
+        main_only.tasks.push_back(std::move(task));
+        return;
+    }
+
+    int index = (thread_index >= 0 && thread_index < static_cast<int>(queues.size())) ? thread_index : 0;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+    { std::lock_guard<std::mutex> lock(sleep_mutex); }  // a worker between its check and its wait must not miss the notify
+    wake.notify_one();
+}
+
+bool JobSystem::pop(Task& task) {
+    const int count = static_cast<int>(queues.size());
+    if (count == 0 || queued.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    // own deque: newest first
+    if (thread_index >= 0 && thread_index < count) {
+        Queue& own = *queues[thread_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    // steal: oldest first, starting at the next thread so the victims are spread
+    const int self = std::max(thread_index, 0);
+    for (int k = 1; k <= count; ++k) {
+        Queue& victim = *queues[(self + k) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::pop_main(Task& task) {
+    if (std::this_thread::get_id() != main_thread)
+        return false;
+    std::lock_guard<std::mutex> lock(main_only.mutex);
+    if (main_only.tasks.empty())
+        return false;
+    task = std::move(main_only.tasks.front());
+    main_only.tasks.pop_front();
+    return true;
+}
+
+void JobSystem::execute(Task& task) {
+    task.job();
+    task.job = nullptr;     // release the captures before the counter reports completion
+    finish(task.counter);
+}
+
+void JobSystem::finish(Counter* counter) {
+    if (!counter)
+        return;
+    std::vector<Counter::Continuation> ready;
+    {
+        // decrement under the lock: a waiter takes the lock before returning, so the counter outlives this block
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ready.swap(counter->continuations);
+    }
+    for (Counter::Continuation& c : ready)
+        push(Task{ std::move(c.job), c.counter }, c.affinity);
+}
+
+void JobSystem::wait(Counter& counter) {
+    while (!counter.done()) {
+        Task task;
+        if (pop_main(task) || pop(task))
+            execute(task);
+        else
+            std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(counter.mutex);    // the last finish() has left the counter
+}
+
+void JobSystem::run_main_jobs(void) {
+    Task task;
+    while (pop_main(task))
+        execute(task);
+}
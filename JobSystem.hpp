@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler.
+// Every thread (main thread + workers) has its own deque: the owner pushes and pops at the back (newest first,
+// the data is still in its cache), idle threads steal from the front of the others (oldest = usually the biggest job).
+// Completion is tracked with counters; a waiting thread runs other jobs instead of blocking, so jobs may wait too.
+// GL calls are only allowed on the main thread: run_on_main() jobs are executed by the main thread only
+// (in wait() and run_main_jobs()).
+//
+//   JobSystem& jobs = JobSystem::instance();
+//   JobSystem::Counter done;
+//   jobs.run([&] { load_a(); }, &done);
+//   jobs.run([&] { load_b(); }, &done);
+//   jobs.run_after(done, [&] { upload_to_gl(); }, nullptr, JobSystem::Affinity::Main);
+//   jobs.parallel_for(0, rows, 16, [&](size_t first, size_t last) { ... });
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+    enum class Affinity { Any, Main };
+
+    // Number of unfinished jobs; run_after() jobs start when it drops to zero
+    class Counter {
+    public:
+        Counter(void) = default;
+        Counter(Counter const&) = delete;
+        Counter& operator=(Counter const&) = delete;
+        bool done(void) const { return pending.load(std::memory_order_acquire) == 0; }
+    private:
+        friend class JobSystem;
+        struct Continuation {
+            Job job;
+            Counter* counter;
+            Affinity affinity;
+        };
+        std::atomic<int> pending{ 0 };
+        std::mutex mutex;                           // guards continuations
+        std::vector<Continuation> continuations{};
+    };
+
+    static JobSystem& instance(void) {
+        static JobSystem jobs;
+        return jobs;
+    }
+
+    // (re)start with 'workers' worker threads besides the calling thread, which becomes the main thread.
+    // workers < 0: one per hardware thread minus the main thread
+    void start(int workers = -1);
+    void stop(void);
+    int thread_count(void) const { return static_cast<int>(queues.size()); }   // including the main thread
+
+    void run(Job job, Counter* counter = nullptr, Affinity affinity = Affinity::Any);
+    void run_on_main(Job job, Counter* counter = nullptr) { run(std::move(job), counter, Affinity::Main); }
+    void run_after(Counter& dependency, Job job, Counter* counter = nullptr, Affinity affinity = Affinity::Any);
+    void wait(Counter& counter);                    // runs other jobs until the counter reaches zero
+    void run_main_jobs(void);                       // main thread: execute the pending main-thread jobs
+
+    // fn(first, last) on chunks of at least 'grain' indices, the calling thread takes part; returns when all are done.
+    // Ranges of up to 'grain' indices (or without workers) run inline, without scheduling.
+    template <class Fn>
+    void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn) {
+        if (end <= begin)
+            return;
+        const size_t count = end - begin;
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || queues.size() <= 1) {
+            fn(begin, end);
+            return;
+        }
+        // a few chunks per thread, so stealing can even out chunks of different cost
+        const size_t chunks = std::min((count + grain - 1) / grain, queues.size() * 4);
+        const size_t chunk = (count + chunks - 1) / chunks;
+        Counter counter;
+        for (size_t first = begin + chunk; first < end; first += chunk) {
+            const size_t last = std::min(first + chunk, end);
+            run([&fn, first, last] { fn(first, last); }, &counter);
+        }
+        fn(begin, std::min(begin + chunk, end));    // first chunk on the calling thread
+        wait(counter);
+    }
+
+    ~JobSystem() { stop(); }
+
+private:
+    struct Task {
+        Job job;
+        Counter* counter = nullptr;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    JobSystem(void) = default;
+
+    std::vector<std::unique_ptr<Queue>> queues{};   // [0] = main thread
+    Queue main_only{};                              // Affinity::Main jobs
+    std::vector<std::thread> workers{};
+    std::thread::id main_thread{};
+
+    std::atomic<bool> running{ false };
+    std::atomic<int> queued{ 0 };                   // tasks in the deques, for sleeping workers
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    static thread_local int thread_index;           // index of the own deque, -1 = thread not owned by the system
+
+    void worker_loop(int index);
+    void push(Task task, Affinity affinity);
+    bool pop(Task& task);                           // own deque first, then steal
+    bool pop_main(Task& task);
+    void execute(Task& task);
+    void finish(Counter* counter);
+};
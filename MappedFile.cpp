@@ -0,0 +1,96 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "MappedFile.hpp"
+
+bool MappedFile::open(std::filesystem::path const& file_name) {
+    close();
+#ifdef _WIN32
+    HANDLE f = CreateFileW(file_name.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size{};
+    GetFileSizeEx(f, &file_size);
+    HANDLE m = file_size.QuadPart > 0 ? CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (m)
+            CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+    file = f;
+    mapping = m;
+    base = view;
+    length = static_cast<size_t>(file_size.QuadPart);
+#else
+    int f = ::open(file_name.c_str(), O_RDONLY);
+    if (f < 0)
+        return false;
+    struct stat info {};
+    void* view = fstat(f, &info) == 0 && info.st_size > 0 ? mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, f, 0) : MAP_FAILED;
+    if (view == MAP_FAILED) {
+        ::close(f);
+        return false;
+    }
+    madvise(view, static_cast<size_t>(info.st_size), MADV_RANDOM);     // no read-ahead beyond the touched pages
+    fd = f;
+    base = view;
+    length = static_cast<size_t>(info.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close(void) {
+    if (!base)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    CloseHandle(static_cast<HANDLE>(file));
+    file = mapping = nullptr;
+#else
+    munmap(base, length);
+    ::close(fd);
+    fd = -1;
+#endif
+    base = nullptr;
+    length = 0;
+}
+
+size_t MappedFile::page_size(void) {
+#ifdef _WIN32
+    SYSTEM_INFO system{};
+    GetSystemInfo(&system);
+    return system.dwPageSize;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+void MappedFile::release(size_t offset, size_t count) const {
+    if (!base || offset >= length)
+        return;
+    count = std::min(count, length - offset);
+    const size_t page = page_size();
+    const size_t first = (offset + page - 1) / page * page;
+    const size_t last = (offset + count) / page * page;
+    if (last <= first)
+        return;
+    unsigned char* start = static_cast<unsigned char*>(base) + first;
+#ifdef _WIN32
+    VirtualUnlock(start, last - first);     // not locked: removes the pages from the working set
+#else
+    madvise(start, last - first, MADV_DONTNEED);
+#endif
+}
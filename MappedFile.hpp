@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file (mmap / MapViewOfFile).
+// Pages are read from the file when they are first touched; release() drops a range from the resident set
+// again (touching it later reads it again), so the memory of a large mapping stays bounded by what is in use.
+class MappedFile {
+public:
+    MappedFile(void) = default;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(std::filesystem::path const& file_name);
+    void close(void);
+    bool is_open(void) const { return base != nullptr; }
+
+    unsigned char const* data(void) const { return static_cast<unsigned char const*>(base); }
+    size_t size(void) const { return length; }
+    void release(size_t offset, size_t count) const;    // whole pages inside the range only
+    static size_t page_size(void);
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* file = nullptr;       // HANDLE
+    void* mapping = nullptr;    // HANDLE
+#else
+    int fd = -1;
+#endif
+};
@@ -17,6 +17,7 @@ public:
     glm::vec3 orientation{};
     glm::mat4 model_matrix{};
     GLuint texture_id{0}; // texture id=0  means no texture
+    int texture_layer{0}; // layer of the texture array, used when the draw does not choose one
     GLenum primitive_type = GL_POINT;
     ShaderProgram shader;
     std::vector<vertex> vertices{};
@@ -32,7 +33,7 @@ public:
     float reflectivity{1.0f}; 
     
     // indirect (indexed) draw 
-    Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, GLuint const texture_id = 0, GLuint NUM_STRIPS = 0, GLuint NUM_VERTS_PER_STRIP = 0) :
+    Mesh(GLenum primitive_type, ShaderProgram shader, std::vector<vertex> const& vertices, std::vector<GLuint> const& indices, glm::vec3 const& origin, glm::vec3 const& orientation, GLuint const texture_id = 0, GLuint NUM_STRIPS = 0, GLuint NUM_VERTS_PER_STRIP = 0, int texture_layer = 0) :
         primitive_type(primitive_type),
         shader(shader),
         vertices(vertices),
@@ -40,6 +41,7 @@ public:
         origin(origin),
         orientation(orientation),
         texture_id(texture_id),
+        texture_layer(texture_layer),
         NUM_STRIPS(NUM_STRIPS),
         NUM_VERTS_PER_STRIP(NUM_VERTS_PER_STRIP)
     {
@@ -63,6 +65,15 @@ public:
         glVertexArrayAttribFormat(VAO, texture_attrib_location, 2, GL_FLOAT, GL_FALSE, offsetof(vertex, texcoord));
         glVertexArrayAttribBinding(VAO, texture_attrib_location, 0);
         glEnableVertexArrayAttrib(VAO, texture_attrib_location);
+        // Texture array layer: no buffer, the array stays disabled and the current value is set per draw
+        layer_attrib_location = glGetAttribLocation(shader.getID(), "aLayer");
+        // Instance offset and scale: buffer binding 1, one element per instance, enabled by draw_instanced() only
+        instance_attrib_location = glGetAttribLocation(shader.getID(), "aInstance");
+        if (instance_attrib_location >= 0) {
+            glVertexArrayAttribFormat(VAO, instance_attrib_location, 4, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribBinding(VAO, instance_attrib_location, 1);
+            glVertexArrayBindingDivisor(VAO, 1, 1);
+        }
         // Create and fill data
         glCreateBuffers(1, &VBO); // Vertex Buffer Object
         glObjectLabel(GL_BUFFER, VBO, -1, "MyMeshVBO");
@@ -87,30 +98,49 @@ public:
         shader.activate();
         glObjectLabel(GL_PROGRAM, shader.getID(), -1, "MyMeshShader");
         shader.setUniform("uM_m", model_matrix); //set model matrix
+        draw_elements();
+    }
 
-
-        //if textures are used (texID !=0 for single texture, std::vector<GLuint> textures.count() > 0 for multitexturing), set texture unit
-            // - use in for loop for multitexturing, set all textures and bind to different texture units and shader variable names
-        if (texture_id > 0) {
-            int i = 0;
-            
-            glBindTextureUnit(i, texture_id);
-            shader.setUniform("tex0", i);   //send texture unit number to FS            
+    // layer < 0: the own texture_layer of the mesh
+    void draw(glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix, int layer = -1) {
+        if (VAO == 0) {
+            std::cerr << "VAO not initialized!\n";
+            return;
         }
 
-        //TODO: draw mesh: bind vertex array object, draw all elements with selected primitive type 
+        shader.activate();
+        shader.setUniform("uM_m", model_matrix); //set model matrix
+        shader.setUniform("N_matrix", normal_matrix); //Needed for light calculations
+        draw_elements(layer);
+    }
 
-        glBindVertexArray(VAO);
+    // count copies in one draw, instances: buffer of glm::vec4 (offset xyz, scale w) in the space of model_matrix
+    void draw_instanced(glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix, GLuint instances, GLsizei count, int layer = -1) {
+        if (VAO == 0 || instance_attrib_location < 0 || count <= 0)
+            return;
 
-        if (primitive_type == GL_TRIANGLE_STRIP) {
-            for (GLuint strip = 0; strip < NUM_STRIPS; ++strip)
-            {
-                glDrawElements(GL_TRIANGLE_STRIP, NUM_VERTS_PER_STRIP, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int)* NUM_VERTS_PER_STRIP* strip));
-            }  
-        }
-        else {
-            glDrawElements(primitive_type, indices.size(), GL_UNSIGNED_INT, 0);
-        }
+        shader.activate();
+        shader.setUniform("uM_m", model_matrix);
+        shader.setUniform("N_matrix", normal_matrix);
+        glVertexArrayVertexBuffer(VAO, 1, instances, 0, sizeof(glm::vec4));
+        glEnableVertexArrayAttrib(VAO, instance_attrib_location);
+        draw_elements(layer, count);
+        glDisableVertexArrayAttrib(VAO, instance_attrib_location);  // back to the current value (0, 0, 0, 1) = no offset
+    }
+
+    // as draw_instanced(), the instance count comes from the DrawElementsIndirectCommand at offset in the bound GL_DRAW_INDIRECT_BUFFER
+    // (written on the GPU, e.g. by FireflySwarm); not for strip meshes
+    void draw_instanced_indirect(glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix, GLuint instances, GLintptr offset, int layer = -1) {
+        if (VAO == 0 || instance_attrib_location < 0 || primitive_type == GL_TRIANGLE_STRIP)
+            return;
+
+        shader.activate();
+        shader.setUniform("uM_m", model_matrix);
+        shader.setUniform("N_matrix", normal_matrix);
+        glVertexArrayVertexBuffer(VAO, 1, instances, 0, sizeof(glm::vec4));
+        glEnableVertexArrayAttrib(VAO, instance_attrib_location);
+        draw_elements(layer, 0, offset);
+        glDisableVertexArrayAttrib(VAO, instance_attrib_location);
     }
 
 	void clear(void) {
@@ -138,6 +168,41 @@ public:
     };
 
 private:
+    GLint layer_attrib_location = -1;
+    GLint instance_attrib_location = -1;
+
+    // indirect >= 0: offset of the command in the bound GL_DRAW_INDIRECT_BUFFER, instances is not used
+    void draw_elements(int layer = -1, GLsizei instances = 1, GLintptr indirect = -1) {
+        //if textures are used (texID !=0 for single texture, std::vector<GLuint> textures.count() > 0 for multitexturing), set texture unit
+            // - use in for loop for multitexturing, set all textures and bind to different texture units and shader variable names
+        if (texture_id > 0) {
+            int i = 0;
+            
+            glBindTextureUnit(i, texture_id);
+            shader.setUniform("tex0", i);   //send texture unit number to FS            
+        }
+        if (layer_attrib_location >= 0) {
+            glVertexAttrib1f(layer_attrib_location, static_cast<GLfloat>(layer < 0 ? texture_layer : layer));
+        }
+
+        //TODO: draw mesh: bind vertex array object, draw all elements with selected primitive type 
+
+        glBindVertexArray(VAO);
+
+        if (primitive_type == GL_TRIANGLE_STRIP) {
+            for (GLuint strip = 0; strip < NUM_STRIPS; ++strip)
+            {
+                glDrawElementsInstanced(GL_TRIANGLE_STRIP, NUM_VERTS_PER_STRIP, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int)* NUM_VERTS_PER_STRIP* strip), instances);
+            }  
+        }
+        else if (indirect >= 0) {
+            glDrawElementsIndirect(primitive_type, GL_UNSIGNED_INT, reinterpret_cast<const void*>(indirect));
+        }
+        else {
+            glDrawElementsInstanced(primitive_type, indices.size(), GL_UNSIGNED_INT, 0, instances);
+        }
+    }
+
     // OpenGL buffer IDs
     // ID = 0 is reserved (i.e. uninitalized)
      unsigned int VAO{0}, VBO{0}, EBO{0};
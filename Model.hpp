@@ -9,6 +9,7 @@
 #include "Mesh.hpp"
 #include "ShaderProgram.hpp"
 #include "OBJloader.hpp"
+#include "SceneGraph.hpp"
 
 class Model {
 public:
@@ -17,32 +18,22 @@ public:
     glm::vec3 origin{0.0};
     glm::vec3 orientation{0.0};  //rotation by x,y,z axis, in radians
     glm::vec3 scale{1.0};
-    glm::mat4 model_matrix{};
-    glm::mat4 local_model_matrix{}; //for complex transformations
-    glm::mat3 normal_matrix{}; //for normals calculation
     GLuint texture_id{ 0 };
     ShaderProgram shader;
     std::vector<vertex> vertices{};
-    glm::vec3 velocity;
-    glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
-    bool transparent{ false };// For handling transparent models
-    //transparency = final fragment alpha < 1.0; this can happen usually because -> model has transparent material -> model has transparent texture
-    // (when updating material or texture, check alpha and set to TRUE when needed)
+    glm::vec3 bounds_min{ 0.0f };   // box of the vertices in the space of the model (colliders)
+    glm::vec3 bounds_max{ 0.0f };
 
     Model()
         :origin(0.0f),
         orientation(0.0f),
         scale(1.0f),
-        model_matrix{},
-        local_model_matrix(glm::identity<glm::mat4>()),
-        normal_matrix(glm::identity<glm::mat3>()),
-        texture_id(0),
-        velocity(0.0f),
-        gravity(0.0f, -9.81f, 0.0f)
+        texture_id(0)
     {
     }
 
-    Model(const std::filesystem::path& filename, ShaderProgram shader, GLuint const texture_id = 0) {
+    // texture_layer: layer of the texture array used by the draws that do not choose their own
+    Model(const std::filesystem::path& filename, ShaderProgram shader, GLuint const texture_id = 0, int texture_layer = 0) {
         // load mesh (all meshes) of the model, (in the future: load material of each mesh, load textures...)
         // TODO: call LoadOBJFile, LoadMTLFile (if exist), process data, create mesh and set its properties
         //    notice: you can load multiple meshes and place them to proper positions, 
@@ -63,6 +54,14 @@ public:
             //std::cout << "(" << tex.x << ", " << tex.y << ")\n";
         }
 
+        if (!positions.empty()) {
+            bounds_min = bounds_max = positions[0];
+            for (auto const& p : positions) {
+                bounds_min = glm::min(bounds_min, p);
+                bounds_max = glm::max(bounds_max, p);
+            }
+        }
+
         //std::vector<vertex> vertices{};
         for (size_t i = 0; i < positions.size(); ++i) {
             vertex v;
@@ -77,7 +76,7 @@ public:
             indices[i] = i;
         }
 
-        Mesh Mesh(GL_TRIANGLES, shader, vertices, indices, origin, orientation, texture_id);
+        Mesh Mesh(GL_TRIANGLES, shader, vertices, indices, origin, orientation, texture_id, 0, 0, texture_layer);
         /* Mesh mesh( primitive type, shader to use, vertex list, index list,
         origin for this mesh (relative to model), orientation for this mesh (relative to model));*/
 
@@ -86,76 +85,15 @@ public:
 
     }
 
-    // update position etc. based on running time
-    float angle = 0.0f;       // current angle around the circle
-    void circlepath(float delta_t,float height) {    
-
-            float radius = 10.0f;         // circle radius
-            float angular_speed = 1.0f;  // radians per second
-
-            // advance angle
-            angle += angular_speed * delta_t;
-
-            // wrap around if too large
-            if (angle > glm::two_pi<float>())
-                angle -= glm::two_pi<float>();
-
-            // compute new position
-            origin.x = radius * cos(angle);
-            origin.z = radius * sin(angle);
-            origin.y = height+0.5f;
-    }
-
-    void flyghtpath(float delta_t,glm::vec3 input) {
-        velocity += gravity * delta_t;
-        //origin += velocity * delta_t;
-        /*if (input.x == 0.0f) {
-            origin.x += velocity.x * delta_t;
-        }else{
-            origin.x += input.x;
-        }*/
-        //origin.x += input.x;
-        origin.x += input.x + velocity.x * delta_t;
-        origin.y += velocity.y * delta_t;
-        origin.z += velocity.z * delta_t;
-
-    }
-
-    void draw(glm::vec3 const& offset = glm::vec3(0.0f),
-        glm::vec3 const& rotation = glm::vec3(0.0f),
-        glm::vec3 const& scale_change = glm::vec3(1.0f)) {
-
-        // compute complete transformation
-        
-        glm::mat4 t = glm::translate(glm::mat4(1.0f), origin);
-        glm::mat4 rx = glm::rotate(glm::mat4(1.0f), orientation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 ry = glm::rotate(glm::mat4(1.0f), orientation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 rz = glm::rotate(glm::mat4(1.0f), orientation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::mat4 s = glm::scale(glm::mat4(1.0f), scale);
-
-        glm::mat4 m_off = glm::translate(glm::mat4(1.0f), offset);
-        glm::mat4 m_rx = glm::rotate(glm::mat4(1.0f), rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        glm::mat4 m_ry = glm::rotate(glm::mat4(1.0f), rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 m_rz = glm::rotate(glm::mat4(1.0f), rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        glm::mat4 m_s = glm::scale(glm::mat4(1.0f), scale_change);
-        
-        glm::mat4 mv_m = glm::identity<glm::mat4>();
-        //local_model_matrix = mv_m * s * rz * ry * rx * t;
-        //model_matrix = local_model_matrix * m_s * m_rz * m_ry * m_rx * m_off;
-        local_model_matrix = mv_m * t * rx * ry * rz* s;
-        //model_matrix = local_model_matrix * m_off* m_rx* m_ry* m_rz*m_s;
-        model_matrix = local_model_matrix * m_s * m_rz * m_ry * m_rx * m_off;
-        normal_matrix = glm::mat3(glm::inverseTranspose(model_matrix));
+    // A model is shared by all entities that use it, the entity passes its own transform node (and texture layer, < 0 = the model's own)
+    void draw(SceneGraph const& graph, SceneGraph::NodeId node, int layer = -1) {
+        // the complete transformation is cached in the scene graph, it is only recomputed when the node is dirty
+        glm::mat4 const& model_matrix = graph.world(node);
+        glm::mat3 const& normal_matrix = graph.normal(node);
 
         // call draw() on mesh (all meshes)
         for (auto& mesh : meshes) {
-            mesh.draw(model_matrix);
-        }
-    }
-
-    void draw(glm::mat4 const& model_matrix) {
-        for (auto& mesh : meshes) {
-            mesh.draw(local_model_matrix * model_matrix);
+            mesh.draw(model_matrix, normal_matrix, layer);
         }
     }
 
@@ -1,4 +1,6 @@
 // This whole program was imported from the drive -> updated so it handles quads
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <GL/glew.h> 
 #include <glm/glm.hpp>
@@ -7,6 +9,16 @@
 
 #define MAX_LINE_SIZE 255
 
+#ifndef _MSC_VER
+// the bounds-checked CRT functions are MSVC only (fscanf ignores the buffer size fscanf_s takes after a %s)
+static int fopen_s(FILE** file, const char* path, const char* mode) {
+	*file = std::fopen(path, mode);
+	return *file ? 0 : 1;
+}
+#define fscanf_s std::fscanf
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+#endif
+
 bool loadOBJ(const char * path, std::vector < glm::vec3 > & out_vertices, std::vector < glm::vec2 > & out_uvs, std::vector < glm::vec3 > & out_normals)
 {
 	std::vector< unsigned int > vertexIndices, uvIndices, normalIndices;
@@ -28,7 +40,7 @@ bool loadOBJ(const char * path, std::vector < glm::vec3 > & out_vertices, std::v
 	while (1) {
 
 		char lineHeader[MAX_LINE_SIZE];
-		int res = fscanf_s(file, "%s", lineHeader, MAX_LINE_SIZE);
+		int res = fscanf_s(file, "%254s", lineHeader, MAX_LINE_SIZE);
 		if (res == EOF) {
 			break;
 		}
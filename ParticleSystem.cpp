@@ -0,0 +1,219 @@
+// Buffers, passes and drawing of the GPU particles, see ParticleSystem.hpp
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <glm/ext.hpp>
+
+#include "ParticleSystem.hpp"
+
+namespace {
+    // particles.comp: particle_pass
+    constexpr int simulate_pass = 0;
+    constexpr int compact_pass = 1;
+    constexpr int emit_pass = 2;
+    constexpr int finish_pass = 3;
+}
+
+void ParticleSystem::create(size_t capacity) {
+    clear();
+    budget = std::min(capacity, max_budget());
+    if (budget < capacity)
+        std::cerr << "Particle budget " << capacity << " is over the limit of this GPU, using " << budget << '\n';
+    compute = ShaderProgram("particles.comp");
+    render = ShaderProgram("particle.vert", "particle.frag");
+
+    glCreateBuffers(2, particle_buffers);
+    glObjectLabel(GL_BUFFER, particle_buffers[0], -1, "Particles0");
+    glObjectLabel(GL_BUFFER, particle_buffers[1], -1, "Particles1");
+    for (GLuint buffer : particle_buffers)
+        glNamedBufferStorage(buffer, std::max<size_t>(capacity, 1) * particle_bytes, nullptr, 0);   // written by the GPU only
+
+    // per buffer: draw command (4 vertices, no instances), dispatch command (no groups), dropped
+    const GLuint empty[2][8] = { { 4, 0, 0, 0, 0, 1, 1, 0 }, { 4, 0, 0, 0, 0, 1, 1, 0 } };
+    glCreateBuffers(1, &state_buffer);
+    glObjectLabel(GL_BUFFER, state_buffer, -1, "ParticleStates");
+    glNamedBufferStorage(state_buffer, sizeof(empty), empty, 0);
+
+    glCreateVertexArrays(1, &empty_vao);
+    current = 0;
+    frame = 0;
+    time = 0.0f;
+}
+
+// one SSBO binding per buffer, one invocation per particle in the x groups of a dispatch, and the int 'capacity' of particles.comp
+size_t ParticleSystem::max_budget(void) {
+    GLint64 block_bytes = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &block_bytes);
+    GLint groups = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &groups);
+    return std::min({ static_cast<size_t>(std::max<GLint64>(block_bytes, 0)) / particle_bytes,
+        static_cast<size_t>(std::max(groups, 0)) * group_size, static_cast<size_t>(std::numeric_limits<int>::max()) });
+}
+
+void ParticleSystem::clear(void) {
+    if (particle_buffers[0])
+        glDeleteBuffers(2, particle_buffers);
+    if (state_buffer)
+        glDeleteBuffers(1, &state_buffer);
+    if (emitter_buffer)
+        glDeleteBuffers(1, &emitter_buffer);
+    if (empty_vao)
+        glDeleteVertexArrays(1, &empty_vao);
+    if (compute.getID())
+        compute.clear();
+    if (render.getID())
+        render.clear();
+    particle_buffers[0] = particle_buffers[1] = state_buffer = emitter_buffer = empty_vao = 0;
+    emitter_capacity = 0;
+    budget = 0;
+    pending.clear();
+    pending_count = 0;
+    terrain_texture = 0;
+}
+
+void ParticleSystem::emit(Emitter const& emitter, int count) {
+    if (count <= 0 || !ready())
+        return;
+    GpuEmitter e;
+    e.position = glm::vec4(emitter.position, emitter.radius);
+    e.velocity = glm::vec4(emitter.velocity, emitter.spread);
+    e.params = glm::vec4(emitter.lifetime, emitter.size, static_cast<float>(emitter.kind), 0.0f);
+    // the same emissions give the same particles: the seed depends on the frame and the order of the emitters only
+    e.range = glm::uvec4(pending_count, static_cast<std::uint32_t>(count),
+        frame * 0x9e3779b9u + static_cast<std::uint32_t>(pending.size()) * 0x85ebca6bu, 0u);
+    pending.push_back(e);
+    pending_count += static_cast<std::uint32_t>(count);
+}
+
+int ParticleSystem::due(float& accumulator, float rate, float delta_t) {
+    accumulator += rate * delta_t;
+    const int count = static_cast<int>(accumulator);
+    accumulator -= static_cast<float>(count);
+    return count;
+}
+
+void ParticleSystem::set_terrain(GLuint height_map, glm::vec2 const& size, glm::vec2 const& range, glm::mat4 const& model) {
+    terrain_texture = height_map;
+    terrain_size = size;
+    terrain_range = range;
+    terrain_model = model;
+}
+
+void ParticleSystem::update(float delta_t) {
+    if (!ready())
+        return;
+    time += delta_t;
+    const int source = current;
+    const int target = 1 - current;
+
+    compute.activate();
+    compute.setUniform("source_state", source);
+    compute.setUniform("capacity", static_cast<int>(budget));
+    compute.setUniform("delta_t", delta_t);
+    compute.setUniform("time", time);
+    compute.setUniform("gravity", gravity);
+    compute.setUniform("restitution", restitution);
+    compute.setUniform("friction", friction);
+    compute.setUniform("terrain_enabled", terrain_texture ? 1 : 0);
+    if (terrain_texture) {
+        compute.setUniform("height_map_size", terrain_size);
+        compute.setUniform("height_map_range", terrain_range);
+        compute.setUniform("terrain_model", terrain_model);
+        compute.setUniform("terrain_inverse", glm::inverse(terrain_model));
+        compute.setUniform("terrain_normal", glm::mat3(glm::inverseTranspose(terrain_model)));
+        glBindTextureUnit(1, terrain_texture);  // height_map, binding 1 as in lighting_shader
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particle_buffers[source]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particle_buffers[target]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, state_buffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, state_buffer);
+    const GLintptr source_groups = static_cast<GLintptr>(source * state_bytes + 4 * sizeof(GLuint));
+
+    // one invocation per live particle, the group count was written by the previous finish pass
+    compute.setUniform("particle_pass", simulate_pass);
+    glDispatchComputeIndirect(source_groups);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    compute.setUniform("particle_pass", compact_pass);
+    glDispatchComputeIndirect(source_groups);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    compute.setUniform("emit_total", static_cast<int>(pending_count));
+    if (pending_count > 0) {
+        if (pending.size() > emitter_capacity) {
+            if (emitter_buffer)
+                glDeleteBuffers(1, &emitter_buffer);
+            emitter_capacity = std::max<size_t>(64, emitter_capacity * 2);
+            while (emitter_capacity < pending.size())
+                emitter_capacity *= 2;
+            glCreateBuffers(1, &emitter_buffer);
+            glObjectLabel(GL_BUFFER, emitter_buffer, -1, "ParticleEmitters");
+            glNamedBufferStorage(emitter_buffer, emitter_capacity * sizeof(GpuEmitter), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+        glNamedBufferSubData(emitter_buffer, 0, pending.size() * sizeof(GpuEmitter), pending.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, emitter_buffer);
+        compute.setUniform("emitter_count", static_cast<int>(pending.size()));
+        compute.setUniform("particle_pass", emit_pass);
+        // nothing past the budget can be placed: at most 'budget' invocations, the finish pass counts the rest
+        const size_t emitted = std::min<size_t>(pending_count, budget);
+        glDispatchCompute(static_cast<GLuint>((emitted + group_size - 1) / group_size), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    compute.setUniform("particle_pass", finish_pass);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);    // the commands are read by the next dispatch and draw
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    pending.clear();
+    pending_count = 0;
+    current = target;
+    ++frame;
+}
+
+void ParticleSystem::draw(glm::mat4 const& model, glm::mat4 const& view, glm::mat4 const& projection, GLuint texture_id, int texture_layer) {
+    if (!ready())
+        return;
+    render.activate();
+    render.setUniform("uM_m", model);
+    render.setUniform("uV_m", view);
+    render.setUniform("uP_m", projection);
+    render.setUniform("tex0", 0);
+    render.setUniform("texture_layer", static_cast<float>(texture_layer));
+    glBindTextureUnit(0, texture_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particle_buffers[current]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, state_buffer);
+
+    // premultiplied alpha: alpha 0 adds (fire, sparks), alpha 1 covers (smoke); unsorted, depth tested, no depth writes
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    const GLboolean cull = glIsEnabled(GL_CULL_FACE);
+    GLboolean depth_mask = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+
+    glBindVertexArray(empty_vao);
+    glDrawArraysIndirect(GL_TRIANGLE_STRIP, reinterpret_cast<void const*>(static_cast<GLintptr>(current * state_bytes)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  // as set up by the application
+    glDepthMask(depth_mask);
+    if (!blend)
+        glDisable(GL_BLEND);
+    if (cull)
+        glEnable(GL_CULL_FACE);
+}
+
+ParticleSystem::Stats ParticleSystem::stats(void) const {
+    Stats result;
+    if (!ready())
+        return result;
+    GLuint state[8] = {};
+    glGetNamedBufferSubData(state_buffer, static_cast<GLintptr>(current * state_bytes), sizeof(state), state);
+    result.alive = state[1];
+    result.dropped = state[7];
+    return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+
+// Fire, sparks and smoke simulated and drawn entirely on the GPU (particles.comp, particle.vert/frag).
+// The particles live in two SSBOs of a fixed capacity (the budget, allocated once by create()); every update() runs
+//  - simulate: ages and moves the live particles of the current buffer, collides them with the terrain height texture
+//  - compact:  copies the ones still alive to the front of the other buffer (one atomic per work group)
+//  - emit:     appends the particles queued by emit() behind them, emissions over the budget are dropped
+//  - finish:   one invocation, writes the live count into the indirect draw and dispatch commands of that buffer
+// and the buffers swap. Nothing is read back: the next simulate is an indirect dispatch and draw() an indirect
+// instanced draw of camera-facing quads (4 vertices per particle, no vertex buffer) with premultiplied alpha:
+// fire and sparks add light, smoke darkens. Coordinates are those of the model matrix passed to draw().
+//
+//   particles.create(262144);
+//   particles.set_terrain(height_map, size, range, terrain_to_particles);
+//   particles.emit(burst, 200);                  // any number of emitters per frame
+//   particles.update(delta_t);                   // once per frame, before drawing
+//   particles.draw(model, view, projection, texture_array, fire_layer);   // transparent pass
+class ParticleSystem {
+public:
+    static constexpr int group_size = 256;          // local size of particles.comp
+
+    enum class Kind : int { Fire = 0, Spark = 1, Smoke = 2 };
+
+    struct Emitter {
+        Kind kind = Kind::Fire;
+        glm::vec3 position{ 0.0f };
+        float radius = 0.1f;                        // the particles start inside this sphere
+        glm::vec3 velocity{ 0.0f };
+        float spread = 1.0f;                        // random part of the velocity, per axis
+        float lifetime = 1.0f;                      // seconds, +-25 % per particle
+        float size = 0.5f;                          // side of the quad at the start
+    };
+
+    struct Stats {
+        size_t alive = 0;
+        size_t dropped = 0;                         // emitted over the budget, since create()
+    };
+
+    glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };        // sparks; fire and smoke rise
+    float restitution = 0.35f;                      // sparks bouncing off the terrain
+    float friction = 0.6f;                          // tangential velocity kept at a terrain contact
+
+    void create(size_t capacity);                   // buffers and programs, the capacity is the particle budget (at most max_budget())
+    static size_t max_budget(void);                 // largest budget of the current GL context's GPU
+    void clear(void);
+    bool ready(void) const { return particle_buffers[0] != 0; }
+    size_t capacity(void) const { return budget; }
+
+    // queued until update(); count > 0 particles with the random parts of 'emitter'
+    void emit(Emitter const& emitter, int count);
+    // continuous emitters: particles due in this frame, the fraction is kept in 'accumulator'
+    static int due(float& accumulator, float rate, float delta_t);
+
+    // terrain collisions: height texture as TerrainLod::height_map(), model = local space of the terrain -> particles
+    void set_terrain(GLuint height_map, glm::vec2 const& size, glm::vec2 const& range, glm::mat4 const& model);
+    void clear_terrain(void) { terrain_texture = 0; }
+
+    void update(float delta_t);                     // simulate, compact, emit (GPU only)
+    void draw(glm::mat4 const& model, glm::mat4 const& view, glm::mat4 const& projection, GLuint texture_id, int texture_layer);
+
+    Stats stats(void) const;                        // reads the counters back: waits for the GPU
+
+    ~ParticleSystem() { clear(); }
+
+private:
+    // std430 layouts of particles.comp
+    struct GpuEmitter {
+        glm::vec4 position;                         // xyz, radius
+        glm::vec4 velocity;                         // xyz, spread
+        glm::vec4 params;                           // lifetime, size, kind, -
+        glm::uvec4 range;                           // first particle of this emitter in the emission, count, seed, -
+    };
+    static constexpr size_t particle_bytes = 3 * sizeof(glm::vec4);
+    static constexpr size_t state_bytes = 8 * sizeof(GLuint);     // draw command, dispatch command, dropped
+
+    size_t budget = 0;
+    GLuint particle_buffers[2] = { 0, 0 };
+    GLuint state_buffer = 0;                        // the states of both buffers
+    GLuint emitter_buffer = 0;
+    size_t emitter_capacity = 0;
+    GLuint empty_vao = 0;
+    int current = 0;                                // buffer with the live particles
+    std::uint32_t frame = 0;                        // seeds of the emitters
+    float time = 0.0f;
+
+    std::vector<GpuEmitter> pending{};
+    std::uint32_t pending_count = 0;
+
+    ShaderProgram compute;
+    ShaderProgram render;
+
+    GLuint terrain_texture = 0;
+    glm::vec2 terrain_size{ 0.0f };
+    glm::vec2 terrain_range{ 0.0f, 1.0f };
+    glm::mat4 terrain_model{ 1.0f };
+};
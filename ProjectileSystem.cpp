@@ -0,0 +1,147 @@
+// Pool, integration (scalar and AVX2) and instanced drawing of the projectiles, see ProjectileSystem.hpp
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "ProjectileSystem.hpp"
+
+void ProjectileSystem::create(size_t capacity) {
+    clear();
+    for (Array* a : { &x, &y, &z, &velocity_x, &velocity_y, &velocity_z, &previous_x, &previous_y, &previous_z, &life,
+        &query_x, &query_z, &query_h })
+        a->assign(capacity, 0.0f);
+    rays.assign(capacity, SpatialHash::Ray{});
+    object_hits.assign(capacity, SpatialHash::RayHit{});
+    instances.assign(capacity, glm::vec4(0.0f));
+}
+
+void ProjectileSystem::clear(void) {
+    if (instance_buffer)
+        glDeleteBuffers(1, &instance_buffer);
+    instance_buffer = 0;
+    instance_count = 0;
+    count = 0;
+    for (Array* a : { &x, &y, &z, &velocity_x, &velocity_y, &velocity_z, &previous_x, &previous_y, &previous_z, &life,
+        &query_x, &query_z, &query_h }) {
+        a->clear();
+        a->shrink_to_fit();
+    }
+    rays.clear();
+    rays.shrink_to_fit();
+    object_hits.clear();
+    object_hits.shrink_to_fit();
+    instances.clear();
+    instances.shrink_to_fit();
+}
+
+bool ProjectileSystem::spawn(glm::vec3 const& position, glm::vec3 const& velocity, float lifetime) {
+    if (count >= capacity())
+        return false;
+    const size_t i = count++;
+    x[i] = previous_x[i] = position.x;
+    y[i] = previous_y[i] = position.y;
+    z[i] = previous_z[i] = position.z;
+    velocity_x[i] = velocity.x;
+    velocity_y[i] = velocity.y;
+    velocity_z[i] = velocity.z;
+    life[i] = lifetime;
+    return true;
+}
+
+void ProjectileSystem::remove(size_t i) {
+    const size_t last = --count;
+    x[i] = x[last];
+    y[i] = y[last];
+    z[i] = z[last];
+    velocity_x[i] = velocity_x[last];
+    velocity_y[i] = velocity_y[last];
+    velocity_z[i] = velocity_z[last];
+    previous_x[i] = previous_x[last];
+    previous_y[i] = previous_y[last];
+    previous_z[i] = previous_z[last];
+    life[i] = life[last];
+    query_h[i] = query_h[last];     // update() goes on with the results of the moved one
+    object_hits[i] = object_hits[last];
+}
+
+// as Mover::flyghtpath: velocity first, then the position (the steering moves sideways in x)
+void ProjectileSystem::integrate_scalar(size_t first, float delta_t, glm::vec3 const& steering) {
+    const float side = steering.x * steering_rate * delta_t;
+    const float gx = gravity.x * delta_t, gy = gravity.y * delta_t, gz = gravity.z * delta_t;
+    for (size_t i = first; i < count; ++i) {
+        previous_x[i] = x[i];
+        previous_y[i] = y[i];
+        previous_z[i] = z[i];
+        velocity_x[i] = velocity_x[i] + gx;
+        velocity_y[i] = velocity_y[i] + gy;
+        velocity_z[i] = velocity_z[i] + gz;
+        x[i] = x[i] + (side + velocity_x[i] * delta_t);
+        y[i] = y[i] + velocity_y[i] * delta_t;
+        z[i] = z[i] + velocity_z[i] * delta_t;
+        life[i] = life[i] - delta_t;
+    }
+}
+
+int ProjectileSystem::lanes(void) {
+#ifdef __AVX2__
+    return 8;
+#else
+    return 1;
+#endif
+}
+
+void ProjectileSystem::integrate(float delta_t, glm::vec3 const& steering) {
+    size_t i = 0;
+#ifdef __AVX2__
+    // same operation order as integrate_scalar(); the arrays are 64-byte aligned
+    const __m256 dt = _mm256_set1_ps(delta_t);
+    const __m256 side = _mm256_set1_ps(steering.x * steering_rate * delta_t);
+    const __m256 gx = _mm256_set1_ps(gravity.x * delta_t);
+    const __m256 gy = _mm256_set1_ps(gravity.y * delta_t);
+    const __m256 gz = _mm256_set1_ps(gravity.z * delta_t);
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_load_ps(x.data() + i);
+        const __m256 py = _mm256_load_ps(y.data() + i);
+        const __m256 pz = _mm256_load_ps(z.data() + i);
+        _mm256_store_ps(previous_x.data() + i, px);
+        _mm256_store_ps(previous_y.data() + i, py);
+        _mm256_store_ps(previous_z.data() + i, pz);
+        const __m256 vx = _mm256_add_ps(_mm256_load_ps(velocity_x.data() + i), gx);
+        const __m256 vy = _mm256_add_ps(_mm256_load_ps(velocity_y.data() + i), gy);
+        const __m256 vz = _mm256_add_ps(_mm256_load_ps(velocity_z.data() + i), gz);
+        _mm256_store_ps(velocity_x.data() + i, vx);
+        _mm256_store_ps(velocity_y.data() + i, vy);
+        _mm256_store_ps(velocity_z.data() + i, vz);
+        _mm256_store_ps(x.data() + i, _mm256_add_ps(px, _mm256_add_ps(side, _mm256_mul_ps(vx, dt))));
+        _mm256_store_ps(y.data() + i, _mm256_add_ps(py, _mm256_mul_ps(vy, dt)));
+        _mm256_store_ps(z.data() + i, _mm256_add_ps(pz, _mm256_mul_ps(vz, dt)));
+        _mm256_store_ps(life.data() + i, _mm256_sub_ps(_mm256_load_ps(life.data() + i), dt));
+    }
+#endif
+    // remaining projectiles
+    integrate_scalar(i, delta_t, steering);
+}
+
+void ProjectileSystem::upload(float alpha) {
+    instance_count = static_cast<GLsizei>(count);
+    if (count == 0)
+        return;
+    if (!instance_buffer) {
+        glCreateBuffers(1, &instance_buffer);
+        glObjectLabel(GL_BUFFER, instance_buffer, -1, "ProjectileInstances");
+        glNamedBufferStorage(instance_buffer, instances.size() * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        instances[i] = glm::vec4(previous_x[i] + (x[i] - previous_x[i]) * alpha, previous_y[i] + (y[i] - previous_y[i]) * alpha,
+            previous_z[i] + (z[i] - previous_z[i]) * alpha, scale);
+    }
+    glNamedBufferSubData(instance_buffer, 0, count * sizeof(glm::vec4), instances.data());
+}
+
+void ProjectileSystem::draw(Model& model, glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix, int layer) {
+    if (instance_count == 0)
+        return;
+    for (Mesh& mesh : model.meshes)
+        mesh.draw_instanced(model_matrix, normal_matrix, instance_buffer, instance_count, layer);
+}
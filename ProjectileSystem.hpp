@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Heightfield.hpp"
+#include "Model.hpp"
+#include "SpatialHash.hpp"
+
+// Thrown projectiles in a fixed-capacity pool, structure of arrays (position, velocity, lifetime, previous position).
+// The live projectiles are packed at the front: spawn() appends, a removed one is replaced by the last, so nothing is
+// allocated after create(). update() integrates gravity 8 projectiles at a time when compiled with /arch:AVX2 or -mavx2
+// (as my_app.vcxproj does; one at a time otherwise, same results), asks the terrain for the heights under all of them
+// in one call, casts all steps against the objects of a broadphase in one batch, and reports the projectiles that hit
+// the terrain or an object.
+// All of them are drawn with one instanced draw of the model (lighting_shader, aInstance = position and scale).
+// Coordinates are those of the parent transform passed to draw() (the world root of the scene).
+//
+//   projectiles.create(4096);
+//   projectiles.spawn(position, velocity);
+//   projectiles.update(delta_t, steering, heights, hit, &objects, impacts);  // fixed simulation step
+//   projectiles.upload(alpha);                                      // interpolated instances, once per frame
+//   projectiles.draw(model, world, normal_matrix);
+class ProjectileSystem {
+public:
+    static constexpr float steering_rate = 60.0f;   // as Mover: the steering input is an offset per 1/60 s
+    glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+    float scale = 0.1f;                             // of the model
+    float segment_step = 1.0f;                      // horizontal step from which the whole step is tested (tunneling)
+    float radius = 0.1f;                            // of the sphere cast against the objects
+
+    struct Impact {
+        glm::vec3 position{ 0.0f };
+        std::uint32_t object = SpatialHash::no_object;     // the object that was hit, no_object = the terrain
+    };
+
+    void create(size_t capacity);                   // CPU arrays (the instance buffer comes with the first upload())
+    void clear(void);
+    size_t size(void) const { return count; }
+    size_t capacity(void) const { return x.size(); }
+    static int lanes(void);                         // projectiles per iteration of the integration: 8 (AVX2) or 1
+
+    bool spawn(glm::vec3 const& position, glm::vec3 const& velocity, float lifetime = 10.0f);    // false: pool full
+
+    // One simulation step. heights(x, z, count, out): terrain heights under count points, x and z are scratch copies
+    // the function may change (e.g. into the local space of the terrain). hit(from, to, point): the terrain between two
+    // points, for the projectiles below the surface (exact point) and those with a long step (ridges in between).
+    // objects: the whole steps are cast against its boxes (nullptr = the terrain only), the nearer hit counts.
+    // Projectiles that hit go to 'impacts' and are removed, as are those that outlived their lifetime.
+    template <class HeightsFn, class HitFn>
+    void update(float delta_t, glm::vec3 const& steering, HeightsFn&& heights, HitFn&& hit, SpatialHash const* objects, std::vector<Impact>& impacts) {
+        if (count == 0)
+            return;
+        integrate(delta_t, steering);
+        std::copy_n(x.begin(), count, query_x.begin());
+        std::copy_n(z.begin(), count, query_z.begin());
+        heights(query_x.data(), query_z.data(), count, query_h.data());
+        const bool test_objects = objects && objects->size() > 0;
+        if (test_objects) {
+            for (size_t i = 0; i < count; ++i)
+                rays[i] = SpatialHash::Ray{ glm::vec3(previous_x[i], previous_y[i], previous_z[i]), glm::vec3(x[i], y[i], z[i]), radius };
+            objects->raycast(rays.data(), count, object_hits.data());
+        }
+
+        const float long_step = segment_step * segment_step;
+        for (size_t i = 0; i < count;) {
+            const glm::vec3 from(previous_x[i], previous_y[i], previous_z[i]);
+            const glm::vec3 to(x[i], y[i], z[i]);
+            const float step_x = to.x - from.x, step_z = to.z - from.z;
+            const bool below = to.y < query_h[i];
+            glm::vec3 point = to;
+            const bool ground = (below || step_x * step_x + step_z * step_z >= long_step) && (hit(from, to, point) || below);
+            if (test_objects && object_hits[i].object != SpatialHash::no_object) {
+                SpatialHash::RayHit const& object = object_hits[i];
+                if (!ground || glm::dot(object.point - from, object.point - from) <= glm::dot(point - from, point - from)) {
+                    impacts.push_back(Impact{ object.point, object.object });
+                    remove(i);
+                    continue;
+                }
+            }
+            if (ground) {
+                impacts.push_back(Impact{ point });
+                remove(i);
+                continue;       // the last one moved to i
+            }
+            if (life[i] <= 0.0f) {
+                remove(i);
+                continue;
+            }
+            ++i;
+        }
+    }
+
+    void upload(float alpha);                       // instances between the previous and the current step
+    void draw(Model& model, glm::mat4 const& model_matrix, glm::mat3 const& normal_matrix, int layer = -1);
+
+    ~ProjectileSystem() { clear(); }
+
+private:
+    using Array = std::vector<float, AlignedAllocator<float>>;
+    size_t count = 0;
+    Array x, y, z;
+    Array velocity_x, velocity_y, velocity_z;
+    Array previous_x, previous_y, previous_z;       // before the last step
+    Array life;                                     // seconds left
+    Array query_x, query_z, query_h;                // terrain queries of update()
+    std::vector<SpatialHash::Ray> rays{};           // object queries of update()
+    std::vector<SpatialHash::RayHit> object_hits{};
+
+    std::vector<glm::vec4> instances{};             // position, scale
+    GLuint instance_buffer = 0;
+    GLsizei instance_count = 0;
+
+    void integrate(float delta_t, glm::vec3 const& steering);
+    void integrate_scalar(size_t first, float delta_t, glm::vec3 const& steering);
+    void remove(size_t i);
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "TransformKernel.hpp"
+#include "JobSystem.hpp"
+
+// Transform hierarchy of the scene.
+// Every node keeps its local TRS (relative to its parent) and a cached world + normal matrix.
+// The cached matrices are only rebuilt for nodes that were marked dirty (and their children),
+// so static scenery costs nothing per frame.
+class SceneGraph {
+public:
+    using NodeId = int;
+    static constexpr NodeId no_node = -1;
+
+    //------ Node creation / removal ------
+    NodeId create(NodeId parent = no_node) {
+        NodeId id;
+        if (!free_nodes.empty()) {     // reuse a destroyed slot
+            id = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[id] = Node{};
+        }
+        else {
+            id = static_cast<NodeId>(nodes.size());
+            nodes.emplace_back();
+        }
+        setParent(id, parent);
+        return id;
+    }
+
+    void destroy(NodeId id) {
+        if (!valid(id))
+            return;
+        // orphans are moved up to the parent of the removed node
+        std::vector<NodeId> orphans = nodes[id].children;
+        for (NodeId child : orphans)
+            setParent(child, nodes[id].parent);
+        setParent(id, no_node);
+        nodes[id].alive = false;
+        free_nodes.push_back(id);
+    }
+
+    void setParent(NodeId id, NodeId parent) {
+        Node& node = nodes[id];
+        if (node.parent != no_node) {
+            auto& siblings = nodes[node.parent].children;
+            siblings.erase(std::remove(siblings.begin(), siblings.end(), id), siblings.end());
+        }
+        node.parent = parent;
+        if (parent != no_node)
+            nodes[parent].children.push_back(id);
+        updateDepth(id);
+        markDirty(id);
+    }
+
+    //------ Local transformation (relative to the parent) ------
+    // Only marks the node dirty if something really changed, so it is cheap to call every frame.
+    void setLocal(NodeId id, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& scale) {
+        Node& node = nodes[id];
+        if (node.origin == origin && node.orientation == orientation && node.scale == scale)
+            return;
+        node.origin = origin;
+        node.orientation = orientation;
+        node.scale = scale;
+        node.local_dirty = true;
+        markDirty(id);
+    }
+
+    void markDirty(NodeId id) {
+        if (!nodes[id].dirty) {
+            nodes[id].dirty = true;
+            dirty_nodes.push_back(id);
+        }
+    }
+
+    //------ Recompute the cached matrices of all dirty subtrees ------
+    void update(void) {
+        updated_count = 0;
+        if (dirty_nodes.empty())
+            return;
+
+        // rebuild the local matrices of all nodes whose TRS changed in one SIMD batch
+        changed_ids.clear();
+        for (NodeId id : dirty_nodes) {
+            Node& node = nodes[id];
+            if (node.alive && node.local_dirty) {
+                changed_ids.push_back(id);
+                node.local_dirty = false;
+            }
+        }
+        if (changed_ids == local_batch_ids) {
+            // usually the same movers as in the last update: their slots are updated in place,
+            // so the kernel keeps the sin/cos of the orientations that did not change
+            for (size_t i = 0; i < local_batch_ids.size(); ++i) {
+                Node const& node = nodes[local_batch_ids[i]];
+                local_batch.set(i, node.origin, node.orientation, node.scale);
+            }
+        }
+        else {
+            local_batch.clear();
+            for (NodeId id : changed_ids)
+                local_batch.add(nodes[id].origin, nodes[id].orientation, nodes[id].scale);
+            local_batch_ids.swap(changed_ids);
+        }
+        JobSystem& jobs = JobSystem::instance();
+        local_batch.resize_outputs();
+        jobs.parallel_for(0, local_batch_ids.size(), parallel_grain, [&](size_t first, size_t last) {
+            local_batch.compute_range(first, last);
+            for (size_t i = first; i < last; ++i) {
+                Node& node = nodes[local_batch_ids[i]];
+                node.local = local_batch.model_matrices[i];
+                node.local_normal = local_batch.normal_matrices[i];
+            }
+            });
+
+        // roots of the dirty subtrees: dirty nodes without a dirty ancestor. Their subtrees are disjoint,
+        // so they are updated in parallel, and a subtree is never recomputed twice in one update
+        dirty_roots.clear();
+        for (NodeId id : dirty_nodes) {
+            if (!nodes[id].alive || !nodes[id].dirty)
+                continue;
+            NodeId ancestor = nodes[id].parent;
+            while (ancestor != no_node && !nodes[ancestor].dirty)
+                ancestor = nodes[ancestor].parent;
+            if (ancestor == no_node)
+                dirty_roots.push_back(id);
+        }
+        std::atomic<size_t> updated{ 0 };
+        jobs.parallel_for(0, dirty_roots.size(), parallel_grain / 4, [&](size_t first, size_t last) {
+            size_t count = 0;
+            for (size_t i = first; i < last; ++i)
+                count += updateSubtree(dirty_roots[i]);
+            updated += count;
+            });
+        updated_count = updated;
+        dirty_nodes.clear();
+    }
+
+    //------ Cached results ------
+    glm::mat4 const& local(NodeId id) const { return nodes[id].local; }
+    glm::mat4 const& world(NodeId id) const { return nodes[id].world; }
+    glm::mat3 const& normal(NodeId id) const { return nodes[id].normal; }
+    NodeId parent(NodeId id) const { return nodes[id].parent; }
+    bool valid(NodeId id) const { return id >= 0 && id < static_cast<NodeId>(nodes.size()) && nodes[id].alive; }
+
+    // Convert a world-space point into the local space of a node (e.g. to attach an object without moving it)
+    glm::vec3 toLocalPoint(NodeId id, glm::vec3 const& world_point) const {
+        if (id == no_node)
+            return world_point;
+        return glm::vec3(glm::inverse(nodes[id].world) * glm::vec4(world_point, 1.0f));
+    }
+
+    size_t size(void) const { return nodes.size() - free_nodes.size(); }
+    size_t updatedLastFrame(void) const { return updated_count; } // number of nodes recomputed by the last update()
+
+private:
+    struct Node {
+        glm::vec3 origin{ 0.0f };
+        glm::vec3 orientation{ 0.0f };  //rotation by x,y,z axis, in radians
+        glm::vec3 scale{ 1.0f };
+        glm::mat4 local = glm::identity<glm::mat4>();
+        glm::mat4 world = glm::identity<glm::mat4>();
+        glm::mat3 normal = glm::identity<glm::mat3>(); //for normals calculation
+        glm::mat3 local_normal = glm::identity<glm::mat3>();    // of the local matrix, from the kernel
+        NodeId parent = no_node;
+        std::vector<NodeId> children{};
+        int depth = 0;
+        bool dirty = false;         // world matrix needs to be recomputed
+        bool local_dirty = true;    // local TRS changed since the last update
+        bool alive = true;
+    };
+
+    std::vector<Node> nodes{};
+    std::vector<NodeId> free_nodes{};
+    std::vector<NodeId> dirty_nodes{};
+    TransformKernel local_batch;
+    std::vector<NodeId> dirty_roots{};
+    static constexpr size_t parallel_grain = 1024;  // nodes per job; the usual scene is far below and stays on the calling thread
+    std::vector<NodeId> local_batch_ids{};          // node of each slot of local_batch
+    std::vector<NodeId> changed_ids{};
+    size_t updated_count = 0;
+
+    void updateDepth(NodeId id) {
+        Node& node = nodes[id];
+        node.depth = (node.parent == no_node) ? 0 : nodes[node.parent].depth + 1;
+        for (NodeId child : node.children)
+            updateDepth(child);
+    }
+
+    // returns the number of updated nodes
+    size_t updateSubtree(NodeId id) {
+        Node& node = nodes[id];
+        // inverse transpose of a product = product of the inverse transposes (the translation does not matter)
+        node.world = (node.parent == no_node) ? node.local : nodes[node.parent].world * node.local;
+        node.normal = (node.parent == no_node) ? node.local_normal : nodes[node.parent].normal * node.local_normal;
+        node.dirty = false;
+
+        size_t count = 1;
+        for (NodeId child : node.children)
+            count += updateSubtree(child);
+        return count;
+    }
+};
@@ -22,6 +22,63 @@ ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::fi
     ID = link_shader(shader_ids);
 }
 
+ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& TCS_file, const std::filesystem::path& TES_file, const std::filesystem::path& FS_file) {
+	std::vector<GLuint> shader_ids;
+
+	shader_ids.push_back(compile_shader(VS_file, GL_VERTEX_SHADER));
+	shader_ids.push_back(compile_shader(TCS_file, GL_TESS_CONTROL_SHADER));
+	shader_ids.push_back(compile_shader(TES_file, GL_TESS_EVALUATION_SHADER));
+	shader_ids.push_back(compile_shader(FS_file, GL_FRAGMENT_SHADER));
+
+	ID = link_shader(shader_ids);
+}
+
+ShaderProgram::ShaderProgram(const std::filesystem::path& CS_file) {
+	std::vector<GLuint> shader_ids;
+
+	shader_ids.push_back(compile_shader(CS_file, GL_COMPUTE_SHADER));
+
+	ID = link_shader(shader_ids);
+}
+
+void ShaderProgram::copyUniforms(const ShaderProgram& source) {
+	GLint count = 0;
+	glGetProgramiv(source.ID, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		GLchar name[256];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(source.ID, i, sizeof(name), &length, &size, &type, name);
+		std::string base(name, length);
+		if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+			base.resize(base.size() - 3);	// arrays are copied element by element
+
+		for (GLint element = 0; element < size; ++element) {
+			const std::string element_name = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+			const GLint from = glGetUniformLocation(source.ID, element_name.c_str());
+			const GLint to = glGetUniformLocation(ID, element_name.c_str());
+			if (from == -1 || to == -1)
+				continue;	// not in this program (or in a uniform block)
+			GLfloat f[16];
+			GLint n[4];
+			switch (type) {
+			case GL_FLOAT: glGetUniformfv(source.ID, from, f); glProgramUniform1fv(ID, to, 1, f); break;
+			case GL_FLOAT_VEC2: glGetUniformfv(source.ID, from, f); glProgramUniform2fv(ID, to, 1, f); break;
+			case GL_FLOAT_VEC3: glGetUniformfv(source.ID, from, f); glProgramUniform3fv(ID, to, 1, f); break;
+			case GL_FLOAT_VEC4: glGetUniformfv(source.ID, from, f); glProgramUniform4fv(ID, to, 1, f); break;
+			case GL_FLOAT_MAT3: glGetUniformfv(source.ID, from, f); glProgramUniformMatrix3fv(ID, to, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4: glGetUniformfv(source.ID, from, f); glProgramUniformMatrix4fv(ID, to, 1, GL_FALSE, f); break;
+			case GL_INT:
+			case GL_BOOL:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_2D_ARRAY: glGetUniformiv(source.ID, from, n); glProgramUniform1iv(ID, to, 1, n); break;
+			default: break;		// types the shaders do not use
+			}
+		}
+	}
+}
+
 void ShaderProgram::setUniform(const std::string& name, const float val) {
 	auto loc = glGetUniformLocation(ID, name.c_str());
 	if (loc == -1) {
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <filesystem>
+#include <vector>
 
 #include <GL/glew.h> 
 
@@ -10,6 +11,10 @@ public:
 	// you can add more constructors for pipeline with GS, TS etc.
 	ShaderProgram(void) = default; //does nothing
 	ShaderProgram(const std::filesystem::path & VS_file, const std::filesystem::path & FS_file); // TODO: implementation of load, compile, and link shader
+	// pipeline with tessellation: VS -> TCS -> TES -> FS, drawn with GL_PATCHES
+	ShaderProgram(const std::filesystem::path & VS_file, const std::filesystem::path & TCS_file, const std::filesystem::path & TES_file, const std::filesystem::path & FS_file);
+	// compute program: one compute shader, run with glDispatchCompute
+	explicit ShaderProgram(const std::filesystem::path & CS_file);
 
 	void activate(void) const { glUseProgram(ID); };    // activate shader
 	void deactivate(void) { glUseProgram(0); };   // deactivate current shader program (i.e. activate shader no. 0)
@@ -30,6 +35,10 @@ public:
     void setUniform(const std::string & name, const glm::mat3 val);   
     void setUniform(const std::string & name, const glm::mat4 val);  // TODO: implement
 
+    // set every uniform of this program that 'source' also has to the value it has there
+    // (e.g. the lights of the main shader for a program that shares its fragment shader)
+    void copyUniforms(const ShaderProgram & source);
+
     GLuint getID() const { return ID; }
     
 private:
@@ -0,0 +1,358 @@
+// Spatial hash broadphase, see SpatialHash.hpp
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "SpatialHash.hpp"
+#include "JobSystem.hpp"
+
+namespace {
+    constexpr int max_coordinate = 1 << 20;         // cells per axis and direction, far beyond any scene
+
+    bool boxes_overlap(SpatialHash::Box const& a, SpatialHash::Box const& b) {
+        return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y && a.min.z <= b.max.z && b.min.z <= a.max.z;
+    }
+
+    bool contains(glm::ivec3 const& low, glm::ivec3 const& high, int x, int y, int z) {
+        return x >= low.x && x <= high.x && y >= low.y && y <= high.y && z >= low.z && z <= high.z;
+    }
+
+    // segment from + t * delta, t in [0, 1] against the box grown by radius (slabs); a segment starting inside hits at 0
+    bool segment_box(glm::vec3 const& from, glm::vec3 const& delta, SpatialHash::Box const& box, float radius, float& t) {
+        float t0 = 0.0f, t1 = 1.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float low = box.min[axis] - radius, high = box.max[axis] + radius;
+            if (std::abs(delta[axis]) < 1e-12f) {
+                if (from[axis] < low || from[axis] > high)
+                    return false;
+                continue;
+            }
+            const float inverse = 1.0f / delta[axis];
+            float near = (low - from[axis]) * inverse, far = (high - from[axis]) * inverse;
+            if (near > far)
+                std::swap(near, far);
+            t0 = std::max(t0, near);
+            t1 = std::min(t1, far);
+            if (t0 > t1)
+                return false;
+        }
+        t = t0;
+        return true;
+    }
+}
+
+SpatialHash::SpatialHash(float cell_size, size_t bucket_count) : cell(cell_size), inverse_cell(1.0f / cell_size) {
+    size_t size = 1;
+    while (size < bucket_count)
+        size *= 2;
+    buckets.resize(size);
+}
+
+void SpatialHash::clear(void) {
+    for (auto& b : buckets)
+        b.clear();
+    proxies.clear();
+    free_proxies.clear();
+    large_proxies.clear();
+    entries = 0;
+    live = 0;
+}
+
+int SpatialHash::coordinate(float v) const {
+    const float c = std::floor(v * inverse_cell);
+    return static_cast<int>(std::min(std::max(c, static_cast<float>(-max_coordinate)), static_cast<float>(max_coordinate)));
+}
+
+// Teschner et al.: the cell coordinates times three large primes, combined by xor
+size_t SpatialHash::bucket(int x, int y, int z) const {
+    const std::uint32_t h = (static_cast<std::uint32_t>(x) * 73856093u) ^ (static_cast<std::uint32_t>(y) * 19349663u) ^ (static_cast<std::uint32_t>(z) * 83492791u);
+    return h & (buckets.size() - 1);
+}
+
+void SpatialHash::place(Proxy proxy) {
+    Entry& e = proxies[proxy];
+    e.low = glm::ivec3(coordinate(e.box.min.x), coordinate(e.box.min.y), coordinate(e.box.min.z));
+    e.high = glm::ivec3(coordinate(e.box.max.x), coordinate(e.box.max.y), coordinate(e.box.max.z));
+    const long long cells = static_cast<long long>(e.high.x - e.low.x + 1) * (e.high.y - e.low.y + 1) * (e.high.z - e.low.z + 1);
+    e.large = cells > max_cells;
+    if (e.large) {
+        large_proxies.push_back(proxy);
+        return;
+    }
+    for (int z = e.low.z; z <= e.high.z; ++z)
+        for (int y = e.low.y; y <= e.high.y; ++y)
+            for (int x = e.low.x; x <= e.high.x; ++x)
+                entries += add(bucket(x, y, z), proxy);
+    if (entries > 2 * buckets.size())
+        rehash(buckets.size() * 4);
+}
+
+void SpatialHash::unplace(Proxy proxy) {
+    Entry const& e = proxies[proxy];
+    if (e.large) {
+        large_proxies.erase(std::find(large_proxies.begin(), large_proxies.end(), proxy));
+        return;
+    }
+    for (int z = e.low.z; z <= e.high.z; ++z)
+        for (int y = e.low.y; y <= e.high.y; ++y)
+            for (int x = e.low.x; x <= e.high.x; ++x) {
+                std::vector<Proxy>& b = buckets[bucket(x, y, z)];
+                auto found = std::find(b.begin(), b.end(), proxy);
+                if (found == b.end())
+                    continue;           // two of its cells share the bucket, already removed
+                *found = b.back();      // the order in a bucket does not matter
+                b.pop_back();
+                --entries;
+            }
+}
+
+// once per bucket: cells of one object may collide
+size_t SpatialHash::add(size_t b, Proxy proxy) {
+    std::vector<Proxy>& list = buckets[b];
+    if (std::find(list.begin(), list.end(), proxy) != list.end())
+        return 0;
+    list.push_back(proxy);
+    return 1;
+}
+
+void SpatialHash::rehash(size_t bucket_count) {
+    for (auto& b : buckets)
+        b.clear();
+    buckets.resize(bucket_count);
+    entries = 0;
+    for (Proxy p = 0; p < proxies.size(); ++p) {
+        Entry const& e = proxies[p];
+        if (!e.alive || e.large)
+            continue;
+        for (int z = e.low.z; z <= e.high.z; ++z)
+            for (int y = e.low.y; y <= e.high.y; ++y)
+                for (int x = e.low.x; x <= e.high.x; ++x)
+                    entries += add(bucket(x, y, z), p);
+    }
+}
+
+SpatialHash::Proxy SpatialHash::insert(Box const& box, std::uint32_t object) {
+    Proxy proxy;
+    if (!free_proxies.empty()) {
+        proxy = free_proxies.back();
+        free_proxies.pop_back();
+    }
+    else {
+        proxy = static_cast<Proxy>(proxies.size());
+        proxies.emplace_back();
+    }
+    Entry& e = proxies[proxy];
+    e.box = box;
+    e.object = object;
+    e.alive = true;
+    ++live;
+    place(proxy);
+    return proxy;
+}
+
+void SpatialHash::update(Proxy proxy, Box const& box) {
+    Entry& e = proxies[proxy];
+    const glm::ivec3 low(coordinate(box.min.x), coordinate(box.min.y), coordinate(box.min.z));
+    const glm::ivec3 high(coordinate(box.max.x), coordinate(box.max.y), coordinate(box.max.z));
+    if (low == e.low && high == e.high) {
+        e.box = box;            // same cells: nothing to move
+        return;
+    }
+    unplace(proxy);
+    e.box = box;
+    place(proxy);
+}
+
+void SpatialHash::remove(Proxy proxy) {
+    if (proxy >= proxies.size() || !proxies[proxy].alive)
+        return;
+    unplace(proxy);
+    proxies[proxy].alive = false;
+    free_proxies.push_back(proxy);
+    --live;
+}
+
+// the objects listed in a cell; the ones only there by a hash collision are skipped
+void SpatialHash::test_cell(int x, int y, int z, Ray const& ray, RayHit& hit) const {
+    const glm::vec3 delta = ray.to - ray.from;
+    for (Proxy p : buckets[bucket(x, y, z)]) {
+        Entry const& e = proxies[p];
+        float t;
+        if (contains(e.low, e.high, x, y, z) && segment_box(ray.from, delta, e.box, ray.radius, t) && t < hit.t) {
+            hit.object = e.object;
+            hit.t = t;
+        }
+    }
+}
+
+SpatialHash::RayHit SpatialHash::raycast(Ray const& ray) const {
+    RayHit hit;
+    hit.t = std::numeric_limits<float>::max();
+    const glm::vec3 delta = ray.to - ray.from;
+    for (Proxy p : large_proxies) {
+        float t;
+        if (segment_box(ray.from, delta, proxies[p].box, ray.radius, t) && t < hit.t) {
+            hit.object = proxies[p].object;
+            hit.t = t;
+        }
+    }
+
+    const glm::vec3 low = glm::min(ray.from, ray.to) - ray.radius, high = glm::max(ray.from, ray.to) + ray.radius;
+    const glm::ivec3 first(coordinate(low.x), coordinate(low.y), coordinate(low.z));
+    const glm::ivec3 last(coordinate(high.x), coordinate(high.y), coordinate(high.z));
+    const long long cells = static_cast<long long>(last.x - first.x + 1) * (last.y - first.y + 1) * (last.z - first.z + 1);
+    if (cells <= max_cells) {
+        // short segments (e.g. a simulation step): every cell of its box
+        for (int z = first.z; z <= last.z; ++z)
+            for (int y = first.y; y <= last.y; ++y)
+                for (int x = first.x; x <= last.x; ++x)
+                    test_cell(x, y, z, ray, hit);
+    }
+    else {
+        // long ones: the cells along the segment front to back (3D DDA), each with the cells the sphere reaches from the
+        // part of the segment inside it; a hit before the segment leaves a cell is the nearest one
+        glm::ivec3 c(coordinate(ray.from.x), coordinate(ray.from.y), coordinate(ray.from.z));
+        const glm::ivec3 end(coordinate(ray.to.x), coordinate(ray.to.y), coordinate(ray.to.z));
+        glm::ivec3 step(0);
+        glm::vec3 t_max(std::numeric_limits<float>::max()), t_delta(std::numeric_limits<float>::max());
+        for (int axis = 0; axis < 3; ++axis) {
+            if (delta[axis] > 0.0f) {
+                step[axis] = 1;
+                t_max[axis] = ((c[axis] + 1) * cell - ray.from[axis]) / delta[axis];
+                t_delta[axis] = cell / delta[axis];
+            }
+            else if (delta[axis] < 0.0f) {
+                step[axis] = -1;
+                t_max[axis] = (c[axis] * cell - ray.from[axis]) / delta[axis];
+                t_delta[axis] = -cell / delta[axis];
+            }
+        }
+        float enter = 0.0f;
+        int steps = std::abs(end.x - c.x) + std::abs(end.y - c.y) + std::abs(end.z - c.z) + 1;
+        while (steps-- > 0) {
+            const int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+            const float exit = std::min(t_max[axis], 1.0f);
+            const glm::vec3 a = ray.from + delta * enter, b = ray.from + delta * exit;
+            const glm::vec3 part_low = glm::min(a, b) - ray.radius, part_high = glm::max(a, b) + ray.radius;
+            const glm::ivec3 near_low(coordinate(part_low.x), coordinate(part_low.y), coordinate(part_low.z));
+            const glm::ivec3 near_high(coordinate(part_high.x), coordinate(part_high.y), coordinate(part_high.z));
+            for (int z = near_low.z; z <= near_high.z; ++z)
+                for (int y = near_low.y; y <= near_high.y; ++y)
+                    for (int x = near_low.x; x <= near_high.x; ++x)
+                        test_cell(x, y, z, ray, hit);
+            if (hit.t <= exit || exit >= 1.0f)
+                break;
+            enter = exit;
+            c[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+        }
+    }
+
+    if (hit.object == no_object)
+        return RayHit{};
+    hit.point = ray.from + delta * hit.t;
+    return hit;
+}
+
+void SpatialHash::raycast(Ray const* rays, size_t count, RayHit* hits) const {
+    JobSystem::instance().parallel_for(0, count, 1024, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            hits[i] = raycast(rays[i]);
+        });
+}
+
+SpatialHash::RayHit SpatialHash::raycast_reference(Ray const& ray) const {
+    RayHit hit;
+    hit.t = std::numeric_limits<float>::max();
+    const glm::vec3 delta = ray.to - ray.from;
+    for (Entry const& e : proxies) {
+        float t;
+        if (e.alive && segment_box(ray.from, delta, e.box, ray.radius, t) && t < hit.t) {
+            hit.object = e.object;
+            hit.t = t;
+        }
+    }
+    if (hit.object == no_object)
+        return RayHit{};
+    hit.point = ray.from + delta * hit.t;
+    return hit;
+}
+
+void SpatialHash::overlap(Box const& box, std::uint32_t query, std::vector<Overlap>& overlaps) const {
+    const glm::ivec3 low(coordinate(box.min.x), coordinate(box.min.y), coordinate(box.min.z));
+    const glm::ivec3 high(coordinate(box.max.x), coordinate(box.max.y), coordinate(box.max.z));
+    const long long cells = static_cast<long long>(high.x - low.x + 1) * (high.y - low.y + 1) * (high.z - low.z + 1);
+    if (cells > static_cast<long long>(live)) {
+        // more cells than objects: cheaper to test them all
+        for (Entry const& e : proxies) {
+            if (e.alive && boxes_overlap(e.box, box))
+                overlaps.push_back(Overlap{ query, e.object });
+        }
+        return;
+    }
+    for (int z = low.z; z <= high.z; ++z)
+        for (int y = low.y; y <= high.y; ++y)
+            for (int x = low.x; x <= high.x; ++x) {
+                for (Proxy p : buckets[bucket(x, y, z)]) {
+                    Entry const& e = proxies[p];
+                    // an object in several of the cells is reported in the first cell both ranges share only
+                    if (!contains(e.low, e.high, x, y, z) || x != std::max(e.low.x, low.x) || y != std::max(e.low.y, low.y) || z != std::max(e.low.z, low.z))
+                        continue;
+                    if (boxes_overlap(e.box, box))
+                        overlaps.push_back(Overlap{ query, e.object });
+                }
+            }
+    for (Proxy p : large_proxies) {
+        if (boxes_overlap(proxies[p].box, box))
+            overlaps.push_back(Overlap{ query, proxies[p].object });
+    }
+}
+
+void SpatialHash::overlap(Box const* boxes, size_t count, std::vector<Overlap>& overlaps) const {
+    // batches of boxes over the job system, each into its own list; the lists are joined in the order of the boxes
+    constexpr size_t batch = 256;
+    if (count <= batch) {
+        for (size_t q = 0; q < count; ++q)
+            overlap(boxes[q], static_cast<std::uint32_t>(q), overlaps);
+        return;
+    }
+    std::vector<std::vector<Overlap>> found((count + batch - 1) / batch);
+    JobSystem::instance().parallel_for(0, found.size(), 1, [&](size_t first, size_t last) {
+        if (first == 0 && last == found.size()) {   // not split (one thread): straight into the result
+            for (size_t q = 0; q < count; ++q)
+                overlap(boxes[q], static_cast<std::uint32_t>(q), overlaps);
+            return;
+        }
+        for (size_t b = first; b < last; ++b)
+            for (size_t q = b * batch; q < std::min((b + 1) * batch, count); ++q)
+                overlap(boxes[q], static_cast<std::uint32_t>(q), found[b]);
+        });
+    size_t total = overlaps.size();
+    for (auto const& list : found)
+        total += list.size();
+    overlaps.reserve(total);
+    for (auto const& list : found)
+        overlaps.insert(overlaps.end(), list.begin(), list.end());
+}
+
+SpatialHash::Stats SpatialHash::stats(void) const {
+    Stats s;
+    s.objects = live;
+    s.large = large_proxies.size();
+    s.entries = entries;
+    s.buckets = buckets.size();
+    for (auto const& b : buckets)
+        s.longest = std::max(s.longest, b.size());
+    return s;
+}
+
+SpatialHash::Box SpatialHash::transform(Box const& box, glm::mat4 const& matrix) {
+    // center and half size: the new half size is the sum of the absolute columns scaled by the old one
+    const glm::vec3 center = glm::vec3(matrix * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    const glm::vec3 half = (box.max - box.min) * 0.5f;
+    glm::vec3 extent(0.0f);
+    for (int column = 0; column < 3; ++column)
+        extent += glm::abs(glm::vec3(matrix[column])) * half[column];
+    return Box{ center - extent, center + extent };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Broadphase over axis-aligned boxes: a uniform grid of cell_size cells, hashed into a table of buckets, so the grid has
+// no bounds and its memory follows the objects, not the area (the table doubles when it fills up).
+// An object is listed in every cell its box touches; boxes over max_cells cells go to a short list that every query tests.
+// update() re-bins an object only when its range of cells changes, a moving object mostly just stores its new box.
+// Neighbours and hash collisions in a bucket are rejected by the cell range and the exact box test: a query costs the
+// same with 1k or 100k objects of the same density.
+// The queries are const, any number of threads may query between the changes.
+//
+//   SpatialHash objects(4.0f);
+//   SpatialHash::Proxy proxy = objects.insert(box, entity.index);
+//   objects.update(proxy, moved_box);
+//   objects.raycast(rays, count, hits);         // nearest object along each segment, split over the job system
+//   objects.overlap(boxes, count, overlaps);    // every object touching each box, split over the job system
+class SpatialHash {
+public:
+    using Proxy = std::uint32_t;
+    static constexpr Proxy no_proxy = UINT32_MAX;
+    static constexpr std::uint32_t no_object = UINT32_MAX;
+    static constexpr int max_cells = 64;            // of one object in the buckets, larger ones are tested by every query
+
+    struct Box {
+        glm::vec3 min{ 0.0f };
+        glm::vec3 max{ 0.0f };
+    };
+
+    struct Ray {                                    // segment from -> to swept by a sphere of radius
+        glm::vec3 from{ 0.0f };
+        glm::vec3 to{ 0.0f };
+        float radius = 0.0f;
+    };
+
+    struct RayHit {
+        std::uint32_t object = no_object;           // value given to insert(), no_object = nothing hit
+        float t = 1.0f;                             // from + t * (to - from)
+        glm::vec3 point{ 0.0f };                    // center of the sphere when it touches the box
+    };
+
+    struct Overlap {
+        std::uint32_t query = 0;                    // index of the box of the query
+        std::uint32_t object = 0;
+    };
+
+    struct Stats {
+        size_t objects = 0;
+        size_t large = 0;                           // over max_cells cells
+        size_t entries = 0;                         // proxies in the buckets
+        size_t buckets = 0;
+        size_t longest = 0;                         // entries of the fullest bucket
+    };
+
+    explicit SpatialHash(float cell_size = 4.0f, size_t buckets = 1024);    // buckets: power of two
+    void clear(void);                               // all objects; cell size and table stay
+    float cell_size(void) const { return cell; }
+    size_t size(void) const { return live; }
+
+    Proxy insert(Box const& box, std::uint32_t object);
+    void update(Proxy proxy, Box const& box);
+    void remove(Proxy proxy);
+    Box const& box(Proxy proxy) const { return proxies[proxy].box; }
+
+    // the sphere is tested against the box grown by the radius (slightly larger than the rounded shape at the edges)
+    RayHit raycast(Ray const& ray) const;
+    void raycast(Ray const* rays, size_t count, RayHit* hits) const;
+    RayHit raycast_reference(Ray const& ray) const;    // every object, no grid
+    // each object touching a box once, appended in the order of the boxes; batches of boxes split over the job system
+    void overlap(Box const* boxes, size_t count, std::vector<Overlap>& overlaps) const;
+
+    Stats stats(void) const;
+
+    static Box transform(Box const& box, glm::mat4 const& matrix);     // box around the transformed box
+
+private:
+    struct Entry {
+        Box box{};
+        glm::ivec3 low{ 0 }, high{ 0 };             // range of cells
+        std::uint32_t object = no_object;
+        bool alive = false;
+        bool large = false;
+    };
+
+    float cell = 4.0f;
+    float inverse_cell = 0.25f;
+    std::vector<Entry> proxies{};
+    std::vector<Proxy> free_proxies{};
+    std::vector<Proxy> large_proxies{};
+    std::vector<std::vector<Proxy>> buckets{};
+    size_t entries = 0;                             // proxies in the buckets
+    size_t live = 0;
+
+    int coordinate(float v) const;
+    size_t bucket(int x, int y, int z) const;
+    void place(Proxy proxy);                        // into the buckets (or the large list) of its box
+    void unplace(Proxy proxy);
+    size_t add(size_t bucket, Proxy proxy);
+    void rehash(size_t bucket_count);
+    void test_cell(int x, int y, int z, Ray const& ray, RayHit& hit) const;
+    void overlap(Box const& box, std::uint32_t query, std::vector<Overlap>& overlaps) const;
+};
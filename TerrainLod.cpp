@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <limits>
+
+#include <glm/ext.hpp>
+
+#include "TerrainLod.hpp"
+
+void TerrainLod::create(ShaderProgram const& shader, Heightfield const& heights) {
+    clear();
+    rows = heights.rows();
+    columns = heights.columns();
+    if (rows < 2 || columns < 2)
+        return;
+
+    // ------ Quadtree ------: the root covers the whole map, leaves are patch_size samples wide
+    levels = 1;
+    while ((patch_size << (levels - 1)) < std::max(columns - 1, rows - 1))
+        ++levels;
+    nodes.clear();
+    build(0, 0, levels - 1, heights);
+
+    // ------ Shared patch ------: grid positions 0..patch_size, indices ordered by quadrant so any quadrant is one range
+    std::vector<glm::vec2> grid;
+    grid.reserve((patch_size + 1) * (patch_size + 1));
+    for (int y = 0; y <= patch_size; ++y)
+        for (int x = 0; x <= patch_size; ++x)
+            grid.emplace_back(static_cast<float>(x), static_cast<float>(y));
+
+    const int half = patch_size / 2;
+    std::vector<GLushort> indices;
+    indices.reserve(patch_size * patch_size * 6);
+    for (int q = 0; q < 4; ++q) {
+        const int qx = (q & 1) * half;
+        const int qy = (q >> 1) * half;
+        for (int y = qy; y < qy + half; ++y) {
+            for (int x = qx; x < qx + half; ++x) {
+                GLushort a = static_cast<GLushort>(y * (patch_size + 1) + x);
+                GLushort b = static_cast<GLushort>(a + 1);
+                GLushort c = static_cast<GLushort>(a + patch_size + 1);
+                GLushort d = static_cast<GLushort>(c + 1);
+                // same winding as the triangle strips of the full mesh (the application draws the terrain with GL_CW)
+                indices.insert(indices.end(), { a, c, b, b, c, d });
+            }
+        }
+    }
+    quadrant_indices = static_cast<GLsizei>(indices.size() / 4);
+
+    glCreateVertexArrays(1, &vao);
+    glObjectLabel(GL_VERTEX_ARRAY, vao, -1, "TerrainPatchVAO");
+    glCreateBuffers(1, &vbo);
+    glCreateBuffers(1, &ebo);
+    glNamedBufferStorage(vbo, grid.size() * sizeof(glm::vec2), grid.data(), 0);
+    glNamedBufferStorage(ebo, indices.size() * sizeof(GLushort), indices.data(), 0);
+    GLint position_attrib_location = glGetAttribLocation(shader.getID(), "aPos");  // aPos.xy = grid position
+    if (position_attrib_location >= 0) {
+        glVertexArrayAttribFormat(vao, position_attrib_location, 2, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao, position_attrib_location, 0);
+        glEnableVertexArrayAttrib(vao, position_attrib_location);
+    }
+    glVertexArrayVertexBuffer(vao, 0, vbo, 0, sizeof(glm::vec2));
+    glVertexArrayElementBuffer(vao, ebo);
+    glCreateVertexArrays(1, &empty_vao);
+    glObjectLabel(GL_VERTEX_ARRAY, empty_vao, -1, "TerrainPulledVAO");
+    for (int row = 0; row < rows - 1; ++row) {
+        strip_first.push_back(row * columns * 2);
+        strip_count.push_back(columns * 2);
+    }
+
+    // ------ Heights ------: one texel per sample, straight from the heightfield
+    glCreateTextures(GL_TEXTURE_2D, 1, &height_texture);
+    glObjectLabel(GL_TEXTURE, height_texture, -1, "TerrainHeights");
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, heights.row_stride());
+    if (heights.storage() == Heightfield::Storage::Quantized16) {
+        glTextureStorage2D(height_texture, 1, GL_R16, columns, rows);   // normalized: texel = sample / 65535
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTextureSubImage2D(height_texture, 0, 0, 0, columns, rows, GL_RED, GL_UNSIGNED_SHORT, heights.quantized_data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        height_range = glm::vec2(heights.quantization_offset(), heights.quantization_step() * 65535.0f);
+        height_bytes = static_cast<size_t>(columns) * rows * sizeof(std::uint16_t);
+    }
+    else {
+        glTextureStorage2D(height_texture, 1, GL_R32F, columns, rows);
+        glTextureSubImage2D(height_texture, 0, 0, 0, columns, rows, GL_RED, GL_FLOAT, heights.row_data(0));
+        height_range = glm::vec2(0.0f, 1.0f);
+        height_bytes = static_cast<size_t>(columns) * rows * sizeof(float);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTextureParameteri(height_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);    // morphing vertices sample between texels
+    glTextureParameteri(height_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(height_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(height_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+int TerrainLod::build(int column, int row, int level, Heightfield const& heights) {
+    if (column >= columns - 1 || row >= rows - 1)
+        return -1;      // outside the map
+
+    const int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes[index].column = column;
+    nodes[index].row = row;
+    nodes[index].level = level;
+
+    const int size = patch_size << level;
+    const int half = size / 2;
+    for (int q = 0; q < 4; ++q) {
+        if (column + (q & 1) * half < columns - 1 && row + (q >> 1) * half < rows - 1)
+            nodes[index].quadrants |= 1 << q;
+    }
+
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    if (level == 0) {
+        for (int r = row; r <= std::min(row + size, rows - 1); ++r) {
+            for (int c = column; c <= std::min(column + size, columns - 1); ++c) {
+                lo = std::min(lo, heights.at(r, c));
+                hi = std::max(hi, heights.at(r, c));
+            }
+        }
+    }
+    else {
+        for (int q = 0; q < 4; ++q) {
+            int child = build(column + (q & 1) * half, row + (q >> 1) * half, level - 1, heights);
+            nodes[index].children[q] = child;     // nodes may have been reallocated, no reference kept
+            if (child >= 0) {
+                lo = std::min(lo, nodes[child].min_height);
+                hi = std::max(hi, nodes[child].max_height);
+            }
+        }
+    }
+    nodes[index].min_height = lo;
+    nodes[index].max_height = hi;
+    return index;
+}
+
+void TerrainLod::update(Heightfield const& heights, HeightRegion const& samples) {
+    if (!ready() || heights.rows() != rows || heights.columns() != columns)
+        return;
+    const HeightRegion r = samples.clipped(columns, rows);
+    if (r.empty())
+        return;
+
+    // ------ Heights ------: the rectangle only, rows read out of the full map
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, heights.row_stride());
+    if (heights.storage() == Heightfield::Storage::Quantized16) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTextureSubImage2D(height_texture, 0, r.column, r.row, r.columns, r.rows, GL_RED, GL_UNSIGNED_SHORT,
+            heights.quantized_data() + static_cast<size_t>(r.row) * heights.row_stride() + r.column);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        height_range = glm::vec2(heights.quantization_offset(), heights.quantization_step() * 65535.0f);   // widened by a deep edit
+    }
+    else {
+        glTextureSubImage2D(height_texture, 0, r.column, r.row, r.columns, r.rows, GL_RED, GL_FLOAT, heights.row_data(r.row) + r.column);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    // ------ Bounds ------: the nodes over the rectangle, leaves from the samples, parents from their children
+    refresh(0, r, heights);
+}
+
+void TerrainLod::refresh(int index, HeightRegion const& samples, Heightfield const& heights) {
+    Node& node = nodes[index];
+    const int size = patch_size << node.level;
+    if (samples.row > node.row + size || samples.row + samples.rows <= node.row ||
+        samples.column > node.column + size || samples.column + samples.columns <= node.column)
+        return;     // the node's samples (borders included) are untouched
+
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    if (node.level == 0) {
+        for (int r = node.row; r <= std::min(node.row + size, rows - 1); ++r) {
+            for (int c = node.column; c <= std::min(node.column + size, columns - 1); ++c) {
+                lo = std::min(lo, heights.at(r, c));
+                hi = std::max(hi, heights.at(r, c));
+            }
+        }
+    }
+    else {
+        for (int child : node.children) {
+            if (child < 0)
+                continue;
+            refresh(child, samples, heights);
+            lo = std::min(lo, nodes[child].min_height);
+            hi = std::max(hi, nodes[child].max_height);
+        }
+    }
+    node.min_height = lo;
+    node.max_height = hi;
+}
+
+void TerrainLod::clear(void) {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteTextures(1, &height_texture);
+    glDeleteVertexArrays(1, &empty_vao);
+    glDeleteQueries(1, &primitives_query);
+    vao = vbo = ebo = height_texture = empty_vao = primitives_query = 0;
+    height_bytes = 0;
+    query_pending = false;
+    strip_first.clear();
+    strip_count.clear();
+    nodes.clear();
+    selection.clear();
+    levels = 0;
+}
+
+size_t TerrainLod::gpu_bytes(void) const {
+    return height_bytes + (patch_size + 1) * (patch_size + 1) * sizeof(glm::vec2) + quadrant_indices * 4 * sizeof(GLushort);
+}
+
+float TerrainLod::lod_range(int level) const {
+    if (level >= levels - 1)
+        return std::numeric_limits<float>::max();  // the root is always drawn
+    return detail_distance * static_cast<float>(1 << level);
+}
+
+glm::vec3 TerrainLod::box_min(Node const& node) const {
+    return glm::vec3(-rows / 2.0f + node.row, node.min_height, -columns / 2.0f + node.column);
+}
+
+glm::vec3 TerrainLod::box_max(Node const& node) const {
+    const int size = patch_size << node.level;
+    return glm::vec3(-rows / 2.0f + std::min(node.row + size, rows - 1), node.max_height,
+        -columns / 2.0f + std::min(node.column + size, columns - 1));
+}
+
+// true: the node's area is handled (drawn or culled), false: it is beyond the range of its level, the parent draws it
+bool TerrainLod::select(int index, glm::vec3 const& eye, glm::vec4 const (&planes)[6]) {
+    Node const& node = nodes[index];
+    const glm::vec3 lo = box_min(node);
+    const glm::vec3 hi = box_max(node);
+    const glm::vec3 outside = glm::max(glm::max(lo - eye, eye - hi), glm::vec3(0.0f));
+    const float distance2 = glm::dot(outside, outside);     // squared distance of the camera from the box
+
+    const float range = lod_range(node.level);
+    if (node.level < levels - 1 && distance2 > range * range)
+        return false;
+    ++last.nodes;
+
+    for (glm::vec4 const& plane : planes) {
+        // corner furthest along the plane normal: if it is behind, the whole box is
+        glm::vec3 corner(plane.x > 0.0f ? hi.x : lo.x, plane.y > 0.0f ? hi.y : lo.y, plane.z > 0.0f ? hi.z : lo.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return true;
+    }
+
+    int quadrants = node.quadrants;
+    const float finer = node.level > 0 ? lod_range(node.level - 1) : 0.0f;
+    if (node.level > 0 && distance2 <= finer * finer) {
+        // the finer level reaches into this node: children in their range draw themselves, the rest stays here
+        quadrants = 0;
+        for (int q = 0; q < 4; ++q) {
+            const int child = node.children[q];
+            if (child >= 0 && !select(child, eye, planes))
+                quadrants |= 1 << q;
+        }
+    }
+    if (quadrants)
+        selection.push_back(Patch{ index, quadrants });
+    return true;
+}
+
+void TerrainLod::draw(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix,
+    glm::mat4 const& view_projection, glm::vec3 const& eye, GLuint texture_id, int texture_layer) {
+    last = Stats{};
+    last.levels = levels;
+    selection.clear();
+    if (!ready() || nodes.empty())
+        return;
+
+    // frustum planes in the local space of the terrain (rows of the local -> clip matrix)
+    const glm::mat4 clip = view_projection * model;
+    const glm::vec4 row_w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+        const glm::vec4 row(clip[0][axis], clip[1][axis], clip[2][axis], clip[3][axis]);
+        planes[axis * 2] = row_w + row;
+        planes[axis * 2 + 1] = row_w - row;
+    }
+    const glm::vec3 local_eye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+    select(0, local_eye, planes);
+    if (selection.empty())
+        return;
+
+    bind(shader, model, normal_matrix, texture_id);
+    shader.setUniform("terrain_mode", 1);
+    shader.setUniform("cdlod_eye", local_eye);
+    GLint layer_attrib_location = glGetAttribLocation(shader.getID(), "aLayer");
+    if (layer_attrib_location >= 0)
+        glVertexAttrib1f(layer_attrib_location, static_cast<GLfloat>(texture_layer));
+
+    glBindVertexArray(vao);
+    for (Patch const& patch : selection) {
+        Node const& node = nodes[patch.node];
+        const float end = lod_range(node.level);
+        const float previous = node.level > 0 ? lod_range(node.level - 1) : 0.0f;
+        const float start = previous + (end - previous) * morph_start;
+        const bool morphs = node.level < levels - 1;    // the root level has nothing to morph into
+        shader.setUniform("cdlod_node", glm::vec3(node.column, node.row, static_cast<float>(1 << node.level)));
+        shader.setUniform("cdlod_morph", morphs ? glm::vec2(start, 1.0f / (end - start)) : glm::vec2(0.0f));
+
+        // adjacent quadrants are one index range
+        ++last.patches;
+        for (int q = 0; q < 4;) {
+            if (!(patch.quadrants & (1 << q))) {
+                ++q;
+                continue;
+            }
+            const int first = q;
+            while (q < 4 && (patch.quadrants & (1 << q)))
+                ++q;
+            const GLsizei count = (q - first) * quadrant_indices;
+            glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, reinterpret_cast<void*>(first * quadrant_indices * sizeof(GLushort)));
+            ++last.draws;
+            last.triangles += count / 3;
+        }
+    }
+    shader.setUniform("terrain_mode", 0);
+}
+
+void TerrainLod::bind(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id) {
+    shader.activate();
+    shader.setUniform("uM_m", model);
+    shader.setUniform("N_matrix", normal_matrix);
+    shader.setUniform("height_map_size", glm::vec2(columns, rows));
+    shader.setUniform("height_map_range", height_range);
+    if (texture_id > 0) {
+        glBindTextureUnit(0, texture_id);
+        shader.setUniform("tex0", 0);
+    }
+    glBindTextureUnit(1, height_texture);   // height_map, binding 1 in the shaders
+}
+
+void TerrainLod::draw_full(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id, int texture_layer) {
+    last = Stats{};
+    if (!ready() || strip_first.empty())
+        return;
+
+    bind(shader, model, normal_matrix, texture_id);
+    shader.setUniform("terrain_mode", 2);
+    GLint layer_attrib_location = glGetAttribLocation(shader.getID(), "aLayer");
+    if (layer_attrib_location >= 0)
+        glVertexAttrib1f(layer_attrib_location, static_cast<GLfloat>(texture_layer));
+
+    glBindVertexArray(empty_vao);
+    glMultiDrawArrays(GL_TRIANGLE_STRIP, strip_first.data(), strip_count.data(), static_cast<GLsizei>(strip_first.size()));
+    shader.setUniform("terrain_mode", 0);
+    last.patches = static_cast<int>(strip_first.size());
+    last.draws = 1;
+    last.triangles = static_cast<long long>(rows - 1) * (columns * 2 - 2);
+}
+
+void TerrainLod::draw_tessellated(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id, int texture_layer) {
+    last = Stats{};
+    if (!ready() || nodes.empty())
+        return;
+
+    // triangle count of an earlier frame, read without waiting for the GPU
+    if (primitives_query == 0)
+        glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &primitives_query);
+    if (query_pending) {
+        GLint available = 0;
+        glGetQueryObjectiv(primitives_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 generated = 0;
+            glGetQueryObjectui64v(primitives_query, GL_QUERY_RESULT, &generated);
+            tessellated_triangles = static_cast<long long>(generated);
+            query_pending = false;
+        }
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bind(shader, model, normal_matrix, texture_id);
+    shader.setUniform("terrain_layer", static_cast<float>(texture_layer));
+    shader.setUniform("terrain_bounds", glm::vec2(nodes[0].min_height, nodes[0].max_height));
+    shader.setUniform("viewport_size", glm::vec2(viewport[2], viewport[3]));
+    shader.setUniform("tess_pixels", tess_pixels);
+    shader.setUniform("tess_max_level", static_cast<float>(tess_patch_size));
+    shader.setUniform("tess_patch_size", tess_patch_size);
+
+    const int patches = ((columns - 2) / tess_patch_size + 1) * ((rows - 2) / tess_patch_size + 1);
+    glBindVertexArray(empty_vao);
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
+    if (!query_pending)
+        glBeginQuery(GL_PRIMITIVES_GENERATED, primitives_query);
+    glDrawArrays(GL_PATCHES, 0, patches * 4);
+    if (!query_pending) {
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        query_pending = true;
+    }
+    last.patches = patches;
+    last.draws = 1;
+    last.triangles = tessellated_triangles;
+}
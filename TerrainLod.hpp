@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+#include "Heightfield.hpp"
+
+// Chunked terrain with continuous LOD (CDLOD): a quadtree over the heightmap, every selected node is drawn with
+// the same grid patch of patch_size x patch_size quads (one shared vertex and 16-bit index buffer), scaled to the node.
+// Level L has a sample spacing of 2^L and is used up to lod_range(L) = detail_distance * 2^L from the camera.
+// Over the last part of its range a patch morphs its odd vertices onto the grid of the next level, so the levels
+// meet without cracks and without popping. Nodes outside the view frustum (per-node min/max height bounds) are skipped.
+//
+// The heights are the only per-sample data on the GPU: a texture (R32F, or R16 for a quantized Heightfield) sampled
+// in the vertex shader (lighting_shader.vert, terrain_mode = 1). The same texture also draws the terrain
+//  - at full resolution: draw_full(), positions pulled from gl_VertexID, one triangle strip per pair of rows (terrain_mode = 2)
+//  - tessellated: draw_tessellated() with the terrain_tess.* program, patches of tess_patch_size samples subdivided
+//    by their on-screen size (about tess_pixels per triangle edge)
+// The selection runs in the local space of the terrain (x = row, z = column, as in Heightmap).
+class TerrainLod {
+public:
+    static constexpr int patch_size = 32;           // quads per side of the patch, (patch_size + 1)^2 vertices fit 16-bit indices
+    float detail_distance = 4.0f * patch_size;      // range of level 0, local units
+    float morph_start = 0.66f;                      // part of a level's range (from the previous range) before it starts morphing
+    static constexpr int tess_patch_size = 64;      // samples per side of a tessellation patch = the maximum level
+    float tess_pixels = 8.0f;                       // target on-screen length of a tessellated triangle edge
+
+    struct Stats {
+        int levels = 0;
+        int nodes = 0;
+        int patches = 0;        // drawn nodes (whole or some quadrants)
+        int draws = 0;          // draw calls (a partly drawn node may need more than one)
+        long long triangles = 0;    // tessellated: generated by the previous frame
+    };
+
+    // shader: the program of the CDLOD patches (lighting_shader), for the aPos attribute
+    void create(ShaderProgram const& shader, Heightfield const& heights);
+    void clear(void);
+    bool ready(void) const { return height_texture != 0; }
+    // after heights.set() inside samples: uploads that part of the height texture, refreshes the bounds of the nodes over it
+    void update(Heightfield const& heights, HeightRegion const& samples);
+
+    // select the nodes for the camera and draw them; model = local -> world of the terrain
+    void draw(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix,
+        glm::mat4 const& view_projection, glm::vec3 const& eye, GLuint texture_id, int texture_layer);
+    // every sample, no vertex buffer (lighting_shader)
+    void draw_full(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id, int texture_layer);
+    // tessellation program (terrain_tess.*), the camera uniforms (uP_m, uV_m) are expected to be set
+    void draw_tessellated(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id, int texture_layer);
+
+    // the height texture for other GPU passes (e.g. particle collisions): texel (column, row), height = range.x + texel * range.y
+    GLuint height_map(void) const { return height_texture; }
+    glm::vec2 height_map_size(void) const { return glm::vec2(columns, rows); }
+    glm::vec2 height_map_range(void) const { return height_range; }
+
+    Stats const& stats(void) const { return last; }
+    float lod_range(int level) const;
+    size_t gpu_bytes(void) const;   // height texture and the shared patch
+
+private:
+    struct Node {
+        int column = 0, row = 0;        // first sample
+        int level = 0;                  // size = patch_size << level samples
+        float min_height = 0.0f, max_height = 0.0f;
+        int quadrants = 0;              // bit mask of the quadrants inside the map
+        int children[4] = { -1, -1, -1, -1 };   // quadrants: (column, row) + (0,0), (1,0), (0,1), (1,1) halves
+    };
+    struct Patch {
+        int node;
+        int quadrants;                  // bit mask of the drawn quadrants
+    };
+
+    int columns = 0, rows = 0;
+    int levels = 0;
+    std::vector<Node> nodes{};          // [0] = root
+    std::vector<Patch> selection{};
+    Stats last{};
+
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLuint height_texture = 0;
+    size_t height_bytes = 0;
+    glm::vec2 height_range{ 0.0f, 1.0f };   // height = x + texel * y
+    GLsizei quadrant_indices = 0;
+
+    GLuint empty_vao = 0;               // full grid and tessellation: everything from gl_VertexID
+    std::vector<GLint> strip_first{};   // full grid: one strip per pair of rows
+    std::vector<GLsizei> strip_count{};
+    GLuint primitives_query = 0;        // tessellation: generated triangles
+    bool query_pending = false;
+    long long tessellated_triangles = 0;
+
+    int build(int column, int row, int level, Heightfield const& heights);
+    void refresh(int index, HeightRegion const& samples, Heightfield const& heights);
+    void bind(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix, GLuint texture_id);
+    bool select(int index, glm::vec3 const& eye, glm::vec4 const (&planes)[6]);
+    glm::vec3 box_min(Node const& node) const;
+    glm::vec3 box_max(Node const& node) const;
+};
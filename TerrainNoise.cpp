@@ -0,0 +1,233 @@
+// Scalar and AVX2 paths of the terrain noise, see TerrainNoise.hpp
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "TerrainNoise.hpp"
+#include "JobSystem.hpp"
+
+namespace {
+    constexpr int max_octaves = 16;
+    constexpr std::uint32_t prime_row = 0x27d4eb2du;
+    constexpr std::uint32_t prime_column = 0x165667b1u;
+    constexpr std::uint32_t mix = 0x2c1b3c6du;
+    constexpr std::uint32_t warp_seed_row = 0x68bc21ebu;      // the two warp sums are independent of the terrain sum
+    constexpr std::uint32_t warp_seed_column = 0x02e5be93u;
+
+    // 8 unit gradients, picked by the top 3 bits of the lattice hash
+    alignas(32) constexpr float gradient_row[8] = { 1.0f, -1.0f, 0.0f, 0.0f, 0.70710678f, -0.70710678f, 0.70710678f, -0.70710678f };
+    alignas(32) constexpr float gradient_column[8] = { 0.0f, 0.0f, 1.0f, -1.0f, 0.70710678f, 0.70710678f, -0.70710678f, -0.70710678f };
+
+    // frequency and amplitude per octave, relative to the first one
+    struct Octaves {
+        int count = 0;
+        float frequency[max_octaves];
+        float amplitude[max_octaves];
+        std::uint32_t seed[max_octaves];
+
+        Octaves(TerrainNoise::Settings const& s, int octaves, std::uint32_t seed_base) {
+            count = std::clamp(octaves, 0, max_octaves);
+            float f = 1.0f, a = 1.0f;
+            for (int o = 0; o < count; ++o) {
+                frequency[o] = f;
+                amplitude[o] = a;
+                seed[o] = seed_base + static_cast<std::uint32_t>(o) * 0x9e3779b9u;
+                f *= s.lacunarity;
+                a *= s.gain;
+            }
+        }
+    };
+
+    int gradient(std::int32_t row, std::int32_t column, std::uint32_t seed) {
+        std::uint32_t h = (static_cast<std::uint32_t>(row) * prime_row) ^ (static_cast<std::uint32_t>(column) * prime_column) ^ seed;
+        h ^= h >> 15;
+        h *= mix;
+        h ^= h >> 12;
+        return static_cast<int>(h >> 29);
+    }
+
+    float corner(std::int32_t row, std::int32_t column, std::uint32_t seed, float dr, float dc) {
+        const int g = gradient(row, column, seed);
+        return gradient_row[g] * dr + gradient_column[g] * dc;
+    }
+
+    float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+    float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+    // gradient noise of the lattice of unit cells, about [-0.7, 0.7]
+    float noise(float r, float c, std::uint32_t seed) {
+        const float fr = std::floor(r);
+        const float fc = std::floor(c);
+        const std::int32_t ir = static_cast<std::int32_t>(fr);
+        const std::int32_t ic = static_cast<std::int32_t>(fc);
+        const float tr = r - fr;
+        const float tc = c - fc;
+        const float n00 = corner(ir, ic, seed, tr, tc);
+        const float n10 = corner(ir + 1, ic, seed, tr - 1.0f, tc);
+        const float n01 = corner(ir, ic + 1, seed, tr, tc - 1.0f);
+        const float n11 = corner(ir + 1, ic + 1, seed, tr - 1.0f, tc - 1.0f);
+        const float ur = fade(tr);
+        return lerp(lerp(n00, n10, ur), lerp(n01, n11, ur), fade(tc));
+    }
+
+    float fbm(float r, float c, Octaves const& octaves) {
+        float sum = 0.0f;
+        for (int o = 0; o < octaves.count; ++o)
+            sum = sum + octaves.amplitude[o] * noise(r * octaves.frequency[o], c * octaves.frequency[o], octaves.seed[o]);
+        return sum;
+    }
+
+#ifdef __AVX2__
+    // same operation order as the scalar functions above, so both paths give the same results
+    __m256 lerp8(__m256 a, __m256 b, __m256 t) { return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t)); }
+
+    __m256 fade8(__m256 t) {
+        const __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+        const __m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+        return _mm256_mul_ps(t3, _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10.0f)));
+    }
+
+    __m256 corner8(__m256i row, __m256i column, __m256i seed, __m256 dr, __m256 dc) {
+        __m256i h = _mm256_xor_si256(_mm256_xor_si256(
+            _mm256_mullo_epi32(row, _mm256_set1_epi32(static_cast<int>(prime_row))),
+            _mm256_mullo_epi32(column, _mm256_set1_epi32(static_cast<int>(prime_column)))), seed);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(mix)));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+        const __m256i g = _mm256_srli_epi32(h, 29);
+        const __m256 gr = _mm256_permutevar8x32_ps(_mm256_load_ps(gradient_row), g);
+        const __m256 gc = _mm256_permutevar8x32_ps(_mm256_load_ps(gradient_column), g);
+        return _mm256_add_ps(_mm256_mul_ps(gr, dr), _mm256_mul_ps(gc, dc));
+    }
+
+    __m256 noise8(__m256 r, __m256 c, __m256i seed) {
+        const __m256 fr = _mm256_floor_ps(r);
+        const __m256 fc = _mm256_floor_ps(c);
+        const __m256i ir = _mm256_cvttps_epi32(fr);
+        const __m256i ic = _mm256_cvttps_epi32(fc);
+        const __m256i one_i = _mm256_set1_epi32(1);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 tr = _mm256_sub_ps(r, fr);
+        const __m256 tc = _mm256_sub_ps(c, fc);
+        const __m256i ir1 = _mm256_add_epi32(ir, one_i);
+        const __m256i ic1 = _mm256_add_epi32(ic, one_i);
+        const __m256 tr1 = _mm256_sub_ps(tr, one);
+        const __m256 tc1 = _mm256_sub_ps(tc, one);
+        const __m256 n00 = corner8(ir, ic, seed, tr, tc);
+        const __m256 n10 = corner8(ir1, ic, seed, tr1, tc);
+        const __m256 n01 = corner8(ir, ic1, seed, tr, tc1);
+        const __m256 n11 = corner8(ir1, ic1, seed, tr1, tc1);
+        const __m256 ur = fade8(tr);
+        return lerp8(lerp8(n00, n10, ur), lerp8(n01, n11, ur), fade8(tc));
+    }
+
+    __m256 fbm8(__m256 r, __m256 c, Octaves const& octaves) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int o = 0; o < octaves.count; ++o) {
+            const __m256 f = _mm256_set1_ps(octaves.frequency[o]);
+            const __m256 n = noise8(_mm256_mul_ps(r, f), _mm256_mul_ps(c, f), _mm256_set1_epi32(static_cast<int>(octaves.seed[o])));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(octaves.amplitude[o]), n));
+        }
+        return sum;
+    }
+#endif
+}
+
+float TerrainNoise::bound(void) const {
+    const Octaves octaves(settings, settings.octaves, 0);
+    float sum = 0.0f;
+    for (int o = 0; o < octaves.count; ++o)
+        sum += octaves.amplitude[o];
+    return settings.amplitude * sum * 0.75f;    // a single octave stays within +-sqrt(1/2)
+}
+
+int TerrainNoise::octaves_for(float spacing) const {
+    int count = 1;
+    float wavelength = settings.wavelength / settings.lacunarity;
+    while (count < std::min(settings.octaves, max_octaves) && wavelength >= 2.0f * spacing) {
+        ++count;
+        wavelength /= settings.lacunarity;
+    }
+    return count;
+}
+
+float TerrainNoise::height(float row, float column, int octaves) const {
+    float h = 0.0f;
+    sample_scalar(&row, &column, 1, &h, octaves);
+    return h;
+}
+
+void TerrainNoise::sample_scalar(float const* rows, float const* columns, size_t count, float* heights, int octaves) const {
+    const Octaves terrain(settings, octaves < 0 ? settings.octaves : std::min(octaves, settings.octaves), settings.seed);
+    const Octaves warp_row(settings, settings.warp > 0.0f ? settings.warp_octaves : 0, settings.seed ^ warp_seed_row);
+    const Octaves warp_column(settings, settings.warp > 0.0f ? settings.warp_octaves : 0, settings.seed ^ warp_seed_column);
+    const float inverse_wavelength = 1.0f / settings.wavelength;
+    const float warp = settings.warp * inverse_wavelength;
+    for (size_t i = 0; i < count; ++i) {
+        float r = rows[i] * inverse_wavelength;
+        float c = columns[i] * inverse_wavelength;
+        const float wr = fbm(r, c, warp_row);
+        const float wc = fbm(r, c, warp_column);
+        r = r + warp * wr;
+        c = c + warp * wc;
+        heights[i] = settings.amplitude * fbm(r, c, terrain);
+    }
+}
+
+int TerrainNoise::lanes(void) {
+#ifdef __AVX2__
+    return 8;
+#else
+    return 1;
+#endif
+}
+
+void TerrainNoise::sample(float const* rows, float const* columns, size_t count, float* heights, int octaves) const {
+    size_t i = 0;
+#ifdef __AVX2__
+    const Octaves terrain(settings, octaves < 0 ? settings.octaves : std::min(octaves, settings.octaves), settings.seed);
+    const Octaves warp_row(settings, settings.warp > 0.0f ? settings.warp_octaves : 0, settings.seed ^ warp_seed_row);
+    const Octaves warp_column(settings, settings.warp > 0.0f ? settings.warp_octaves : 0, settings.seed ^ warp_seed_column);
+    const __m256 inverse_wavelength = _mm256_set1_ps(1.0f / settings.wavelength);
+    const __m256 warp = _mm256_set1_ps(settings.warp * (1.0f / settings.wavelength));
+    const __m256 amplitude = _mm256_set1_ps(settings.amplitude);
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(rows + i), inverse_wavelength);
+        __m256 c = _mm256_mul_ps(_mm256_loadu_ps(columns + i), inverse_wavelength);
+        const __m256 wr = fbm8(r, c, warp_row);
+        const __m256 wc = fbm8(r, c, warp_column);
+        r = _mm256_add_ps(r, _mm256_mul_ps(warp, wr));
+        c = _mm256_add_ps(c, _mm256_mul_ps(warp, wc));
+        _mm256_storeu_ps(heights + i, _mm256_mul_ps(amplitude, fbm8(r, c, terrain)));
+    }
+#endif
+    // remaining samples
+    sample_scalar(rows + i, columns + i, count - i, heights + i, octaves);
+}
+
+void TerrainNoise::grid(float const* rows, int row_count, float const* columns, int column_count, float* heights, int octaves) const {
+    std::vector<float> row(static_cast<size_t>(std::max(column_count, 0)));
+    for (int j = 0; j < row_count; ++j) {
+        std::fill(row.begin(), row.end(), rows[j]);
+        sample(row.data(), columns, row.size(), heights + static_cast<size_t>(j) * row.size(), octaves);
+    }
+}
+
+void TerrainNoise::fill(Heightfield& heights, int columns, int rows) const {
+    heights.resize(columns, rows);
+    std::vector<float> column_coordinates(static_cast<size_t>(std::max(columns, 0)));
+    for (int column = 0; column < columns; ++column)
+        column_coordinates[column] = static_cast<float>(column);
+    JobSystem::instance().parallel_for(0, static_cast<size_t>(std::max(rows, 0)), 16, [&](size_t first, size_t last) {
+        std::vector<float> row(column_coordinates.size());
+        for (size_t i = first; i < last; ++i) {
+            std::fill(row.begin(), row.end(), static_cast<float>(i));
+            sample(row.data(), column_coordinates.data(), row.size(), heights.row_data(static_cast<int>(i)));
+        }
+        });
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Heightfield.hpp"
+
+// Procedural terrain heights: gradient noise summed over octaves (fBm), the domain displaced by two more noise sums
+// first (domain warping: bent ridges and valleys instead of round blobs). A pure function of the seed and the sample
+// coordinates, so any chunk can be generated on any thread in any order and a seed always gives the same terrain.
+// sample() computes 8 heights per iteration with AVX2 (when compiled with /arch:AVX2 or -mavx2, as my_app.vcxproj
+// does); its results are identical to height().
+// Coordinates are sample coordinates (row, column), one unit = one sample of level 0.
+//
+//   TerrainNoise noise(settings);
+//   float h = noise.height(row, column);
+//   noise.sample(rows, columns, count, heights);               // many samples at once
+//   noise.grid(rows, row_count, columns, column_count, out);   // every row x every column, e.g. a terrain tile
+//   noise.fill(heightfield, columns, rows);                    // instead of a height image, rows in parallel
+class TerrainNoise {
+public:
+    struct Settings {
+        std::uint32_t seed = 1;
+        int octaves = 8;
+        float wavelength = 512.0f;      // of the first octave, samples
+        float lacunarity = 2.0f;        // frequency factor between octaves
+        float gain = 0.5f;              // amplitude factor between octaves
+        float amplitude = 48.0f;        // of the first octave, height units
+        float warp = 96.0f;             // displacement of the domain, samples (0: no warping)
+        int warp_octaves = 3;
+    };
+
+    TerrainNoise(void) = default;
+    explicit TerrainNoise(Settings const& settings) : settings(settings) {}
+    Settings const& parameters(void) const { return settings; }
+
+    float bound(void) const;                        // |height| <= bound()
+    int octaves_for(float spacing) const;           // octaves not shorter than two samples of that spacing (no aliasing)
+
+    // octaves < 0: all of them
+    float height(float row, float column, int octaves = -1) const;
+    void sample(float const* rows, float const* columns, size_t count, float* heights, int octaves = -1) const;
+    void grid(float const* rows, int row_count, float const* columns, int column_count, float* heights, int octaves = -1) const;
+    void fill(Heightfield& heights, int columns, int rows) const;
+    static int lanes(void);                         // heights per iteration of sample() in this build: 8 (AVX2) or 1
+
+private:
+    Settings settings{};
+
+    void sample_scalar(float const* rows, float const* columns, size_t count, float* heights, int octaves) const;
+};
@@ -0,0 +1,591 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "TerrainPager.hpp"
+
+namespace {
+    constexpr char tile_magic[4] = { 'H', 'T', 'I', 'L' };
+    constexpr std::uint32_t tile_version = 2;   // 2: tiles on page boundaries
+}
+
+std::vector<TerrainPager::Level> TerrainPager::layout(int columns, int rows) {
+    std::vector<Level> result;
+    int first = 0;
+    for (int level = 0;; ++level) {
+        const int spacing = 1 << level;
+        Level l;
+        l.columns = (columns - 1 + spacing - 1) / spacing + 1;  // samples c * spacing, the last one clamped to the edge
+        l.rows = (rows - 1 + spacing - 1) / spacing + 1;
+        l.tiles_x = std::max(1, (l.columns - 1 + tile_size - 1) / tile_size);
+        l.tiles_y = std::max(1, (l.rows - 1 + tile_size - 1) / tile_size);
+        l.first_tile = first;
+        first += l.tiles_x * l.tiles_y;
+        result.push_back(l);
+        if (l.tiles_x == 1 && l.tiles_y == 1)
+            return result;
+    }
+}
+
+bool TerrainPager::bake(std::filesystem::path const& file_name, int columns, int rows,
+    std::function<void(int row, float* heights)> const& sample) {
+    if (columns < 2 || rows < 2)
+        return false;
+
+    // ------ Quantization ------: one range for the whole map
+    std::vector<float> band(static_cast<size_t>(tile_samples) * columns);
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    for (int row = 0; row < rows; ++row) {
+        sample(row, band.data());
+        for (int column = 0; column < columns; ++column) {
+            lo = std::min(lo, band[column]);
+            hi = std::max(hi, band[column]);
+        }
+    }
+    const std::vector<Level> tiled = layout(columns, rows);
+    Header header{};
+    std::memcpy(header.magic, tile_magic, sizeof(tile_magic));
+    header.version = tile_version;
+    header.columns = columns;
+    header.rows = rows;
+    header.tile_size = tile_size;
+    header.levels = static_cast<std::int32_t>(tiled.size());
+    header.offset = lo;
+    header.step = hi > lo ? (hi - lo) / 65535.0f : 1.0f;
+    header.min_height = lo;
+    header.max_height = hi;
+    const size_t page = std::max<size_t>(MappedFile::page_size(), 4096);
+    const size_t bytes = static_cast<size_t>(tile_samples) * tile_samples * sizeof(std::uint16_t);
+    header.tile_stride = static_cast<std::uint32_t>((std::max(bytes, sizeof(Header)) + page - 1) / page * page);
+
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Can not write tiled terrain: " << file_name << '\n';
+        return false;
+    }
+    const std::vector<char> padding(header.tile_stride, 0);
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    out.write(padding.data(), header.tile_stride - sizeof(header));
+
+    // ------ Tiles ------: a band of tile_samples source rows at a time, level by level
+    std::vector<std::uint16_t> tile(static_cast<size_t>(tile_samples) * tile_samples);
+    for (int level = 0; level < header.levels; ++level) {
+        const int spacing = 1 << level;
+        Level const& l = tiled[level];
+        for (int ty = 0; ty < l.tiles_y; ++ty) {
+            for (int j = 0; j < tile_samples; ++j) {
+                const int level_row = std::clamp(ty * tile_size - 1 + j, 0, l.rows - 1);
+                sample(std::min(level_row * spacing, rows - 1), band.data() + static_cast<size_t>(j) * columns);
+            }
+            for (int tx = 0; tx < l.tiles_x; ++tx) {
+                for (int j = 0; j < tile_samples; ++j) {
+                    float const* source = band.data() + static_cast<size_t>(j) * columns;
+                    for (int i = 0; i < tile_samples; ++i) {
+                        const int level_column = std::clamp(tx * tile_size - 1 + i, 0, l.columns - 1);
+                        const float h = source[std::min(level_column * spacing, columns - 1)];
+                        tile[static_cast<size_t>(j) * tile_samples + i] =
+                            static_cast<std::uint16_t>(std::lround(std::min((h - lo) / header.step, 65535.0f)));
+                    }
+                }
+                out.write(reinterpret_cast<char const*>(tile.data()), bytes);
+                out.write(padding.data(), header.tile_stride - bytes);
+            }
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool TerrainPager::open(std::filesystem::path const& file_name, size_t budget_bytes) {
+    close();
+    if (!file.open(file_name)) {
+        std::cerr << "Can not open tiled terrain: " << file_name << '\n';
+        return false;
+    }
+    if (file.size() >= sizeof(Header))
+        std::memcpy(&header, file.data(), sizeof(Header));
+    if (file.size() < sizeof(Header) || std::memcmp(header.magic, tile_magic, sizeof(tile_magic)) != 0
+        || header.version != tile_version || header.tile_size != tile_size) {
+        std::cerr << "Not a tiled terrain of this version / tile size: " << file_name << '\n';
+        close();
+        return false;
+    }
+    levels = layout(header.columns, header.rows);
+    tile_bytes = static_cast<size_t>(tile_samples) * tile_samples * sizeof(std::uint16_t);
+    tile_stride = header.tile_stride;
+    const int tiles = levels.back().first_tile + levels.back().tiles_x * levels.back().tiles_y;
+    if (tile_stride < std::max(tile_bytes, sizeof(Header)) || file.size() < (static_cast<size_t>(tiles) + 1) * tile_stride) {
+        std::cerr << "Tiled terrain is truncated: " << file_name << '\n';
+        close();
+        return false;
+    }
+    if (tile_stride % MappedFile::page_size() != 0)
+        std::cerr << "Tiled terrain baked for smaller pages than " << MappedFile::page_size() << " bytes: " << file_name
+            << " (tiles share pages, some stay resident after a load)\n";
+    return start(budget_bytes, file_name.string());
+}
+
+bool TerrainPager::open(TerrainNoise const& source, int size, size_t budget_bytes) {
+    close();
+    if (size < 2)
+        return false;
+    noise = source;
+    procedural = true;
+    const float bound = noise.bound();
+    std::memcpy(header.magic, tile_magic, sizeof(tile_magic));
+    header.version = tile_version;
+    header.columns = size;
+    header.rows = size;
+    header.tile_size = tile_size;
+    header.offset = -bound;
+    header.step = 2.0f * bound / 65535.0f;
+    header.min_height = -bound;
+    header.max_height = bound;
+    levels = layout(size, size);
+    header.levels = static_cast<std::int32_t>(levels.size());
+    tile_bytes = static_cast<size_t>(tile_samples) * tile_samples * sizeof(std::uint16_t);
+    return start(budget_bytes, "noise, seed " + std::to_string(noise.parameters().seed));
+}
+
+bool TerrainPager::start(size_t budget_bytes, std::string const& source) {
+    const int tiles = levels.back().first_tile + levels.back().tiles_x * levels.back().tiles_y;
+    state.reset(new std::atomic<int>[tiles]);
+    for (int tile = 0; tile < tiles; ++tile)
+        state[tile].store(Absent, std::memory_order_relaxed);
+    slot_of.assign(tiles, -1);
+    last_used.assign(tiles, 0);
+
+    // ------ Slots ------: a tile takes tile_bytes on the CPU (queries) and on the GPU
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    slots = static_cast<int>(std::min<size_t>(budget_bytes / (2 * tile_bytes), static_cast<size_t>(max_layers)));
+    slots = std::max(slots, std::min(64, static_cast<int>(max_layers)));
+    slot_data.assign(static_cast<size_t>(slots) * tile_samples * tile_samples, 0);
+    tile_in_slot.assign(slots, -1);
+    free_slots.clear();
+    for (int slot = slots - 1; slot >= 0; --slot)
+        free_slots.push_back(slot);
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glObjectLabel(GL_TEXTURE, texture, -1, "TerrainTiles");
+    glTextureStorage3D(texture, 1, GL_R16, tile_samples, tile_samples, slots);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // ------ Tile grid ------: tile_samples^2 vertices from gl_VertexID (the outer ring is the skirt), indices only
+    std::vector<GLushort> indices;
+    indices.reserve(static_cast<size_t>(tile_samples - 1) * (tile_samples - 1) * 6);
+    for (int y = 0; y < tile_samples - 1; ++y) {
+        for (int x = 0; x < tile_samples - 1; ++x) {
+            GLushort a = static_cast<GLushort>(y * tile_samples + x);
+            GLushort b = static_cast<GLushort>(a + 1);
+            GLushort c = static_cast<GLushort>(a + tile_samples);
+            GLushort d = static_cast<GLushort>(c + 1);
+            indices.insert(indices.end(), { a, c, b, b, c, d });    // winding of TerrainLod
+        }
+    }
+    index_count = static_cast<GLsizei>(indices.size());
+    glCreateVertexArrays(1, &vao);
+    glObjectLabel(GL_VERTEX_ARRAY, vao, -1, "TerrainTileVAO");
+    glCreateBuffers(1, &ebo);
+    glNamedBufferStorage(ebo, indices.size() * sizeof(GLushort), indices.data(), 0);
+    glVertexArrayElementBuffer(vao, ebo);
+
+    // the coarsest level stays resident
+    last = Stats{};
+    for (int tile = levels.back().first_tile; tile < tiles; ++tile) {
+        const int slot = free_slots.back();
+        free_slots.pop_back();
+        tile_in_slot[slot] = tile;
+        slot_of[tile] = slot;
+        load(tile, slot);
+        upload(tile);
+    }
+    std::cout << "Tiled terrain (" << source << "): " << header.columns << "x" << header.rows << ", " << header.levels << " levels, "
+        << tiles << " tiles, " << slots << " resident at most (" << slots * 2 * tile_bytes / (1024 * 1024) << " MB)\n";
+    return true;
+}
+
+void TerrainPager::close(void) {
+    if (!loads.done())
+        JobSystem::instance().wait(loads);
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &ebo);
+        texture = vao = ebo = 0;
+    }
+    file.close();
+    procedural = false;
+    levels.clear();
+    state.reset();
+    slot_of.clear();
+    last_used.clear();
+    slots = 0;
+    slot_data.clear();
+    slot_data.shrink_to_fit();
+    tile_in_slot.clear();
+    free_slots.clear();
+    loading.clear();
+    requests.clear();
+    selection.clear();
+}
+
+void TerrainPager::tile_coordinates(int tile, int& level, int& x, int& y) const {
+    level = 0;
+    while (level + 1 < static_cast<int>(levels.size()) && tile >= levels[level + 1].first_tile)
+        ++level;
+    const int index = tile - levels[level].first_tile;
+    x = index % levels[level].tiles_x;
+    y = index / levels[level].tiles_x;
+}
+
+float TerrainPager::tile_distance(int level, int x, int y, glm::vec3 const& eye) const {
+    const int size = tile_size << level;    // level-0 samples
+    const glm::vec3 lo(-header.rows / 2.0f + y * size, header.min_height, -header.columns / 2.0f + x * size);
+    const glm::vec3 hi(-header.rows / 2.0f + std::min((y + 1) * size, header.rows - 1), header.max_height,
+        -header.columns / 2.0f + std::min((x + 1) * size, header.columns - 1));
+    return glm::length(glm::max(glm::max(lo - eye, eye - hi), glm::vec3(0.0f)));
+}
+
+bool TerrainPager::request(int tile) {
+    last_used[tile] = frame;
+    const int s = state[tile].load(std::memory_order_acquire);
+    if (s == Absent)
+        requests.push_back(tile);
+    return s == Resident;
+}
+
+// a tile is replaced by its children within the range of their level, once they are all resident
+void TerrainPager::select(int level, int x, int y, glm::vec3 const& eye) {
+    last_used[tile_index(level, x, y)] = frame;
+    if (level > 0 && tile_distance(level, x, y, eye) < lod_range(level - 1)) {
+        Level const& finer = levels[level - 1];
+        bool children = true;
+        for (int q = 0; q < 4; ++q) {
+            const int cx = x * 2 + (q & 1);
+            const int cy = y * 2 + (q >> 1);
+            if (cx < finer.tiles_x && cy < finer.tiles_y)
+                children = request(tile_index(level - 1, cx, cy)) && children;    // all of them are requested
+        }
+        if (children) {
+            for (int q = 0; q < 4; ++q) {
+                const int cx = x * 2 + (q & 1);
+                const int cy = y * 2 + (q >> 1);
+                if (cx < finer.tiles_x && cy < finer.tiles_y)
+                    select(level - 1, cx, cy, eye);
+            }
+            return;
+        }
+    }
+    selection.push_back(tile_index(level, x, y));
+}
+
+bool TerrainPager::start_load(int tile) {
+    int slot = -1;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else {
+        // least recently used resident tile, not one of this frame and not of the coarsest level
+        std::uint32_t oldest = frame;
+        for (int s = 0; s < slots; ++s) {
+            const int t = tile_in_slot[s];
+            if (t < 0 || t >= levels.back().first_tile || state[t].load(std::memory_order_relaxed) != Resident)
+                continue;
+            if (last_used[t] < oldest) {
+                oldest = last_used[t];
+                slot = s;
+            }
+        }
+        if (slot < 0)
+            return false;   // everything in the budget is in use
+        const int victim = tile_in_slot[slot];
+        state[victim].store(Absent, std::memory_order_relaxed);
+        slot_of[victim] = -1;
+        ++last.evicted;
+    }
+    tile_in_slot[slot] = tile;
+    slot_of[tile] = slot;
+    state[tile].store(Loading, std::memory_order_relaxed);
+    loading.push_back(tile);
+
+    JobSystem& jobs = JobSystem::instance();
+    if (jobs.thread_count() > 1)
+        jobs.run([this, tile, slot] { load(tile, slot); }, &loads);
+    else
+        load(tile, slot);   // no workers
+    return true;
+}
+
+void TerrainPager::load(int tile, int slot) {
+    if (procedural) {
+        generate(tile, slot_data.data() + static_cast<size_t>(slot) * tile_samples * tile_samples);
+        state[tile].store(Loaded, std::memory_order_release);
+        return;
+    }
+    const size_t offset = (static_cast<size_t>(tile) + 1) * tile_stride;
+    std::memcpy(slot_data.data() + static_cast<size_t>(slot) * tile_samples * tile_samples, file.data() + offset, tile_bytes);
+    file.release(offset, tile_stride);
+    state[tile].store(Loaded, std::memory_order_release);
+}
+
+// the samples of bake(): the apron and the last samples clamped to the edge of the level
+void TerrainPager::generate(int tile, std::uint16_t* samples) const {
+    int level, x, y;
+    tile_coordinates(tile, level, x, y);
+    const int spacing = 1 << level;
+    Level const& l = levels[level];
+    float rows[tile_samples], columns[tile_samples];
+    for (int j = 0; j < tile_samples; ++j) {
+        rows[j] = static_cast<float>(std::min(std::clamp(y * tile_size - 1 + j, 0, l.rows - 1) * spacing, header.rows - 1));
+        columns[j] = static_cast<float>(std::min(std::clamp(x * tile_size - 1 + j, 0, l.columns - 1) * spacing, header.columns - 1));
+    }
+    float heights[tile_samples * tile_samples];
+    noise.grid(rows, tile_samples, columns, tile_samples, heights, noise.octaves_for(static_cast<float>(spacing)));
+    for (int i = 0; i < tile_samples * tile_samples; ++i)
+        samples[i] = quantize(heights[i]);
+}
+
+std::uint16_t TerrainPager::quantize(float h) const {
+    return static_cast<std::uint16_t>(std::lround(std::min(std::max((h - header.offset) / header.step, 0.0f), 65535.0f)));
+}
+
+void TerrainPager::upload(int tile) {
+    const int slot = slot_of[tile];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTextureSubImage3D(texture, 0, 0, 0, slot, tile_samples, tile_samples, 1, GL_RED, GL_UNSIGNED_SHORT,
+        slot_data.data() + static_cast<size_t>(slot) * tile_samples * tile_samples);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    state[tile].store(Resident, std::memory_order_relaxed);
+    ++last.loaded;
+}
+
+void TerrainPager::update(glm::vec3 const& local_eye) {
+    if (!ready())
+        return;
+    ++frame;
+
+    // finished loads -> texture, a few per frame
+    int uploads = 0;
+    size_t kept = 0;
+    for (int tile : loading) {
+        if (uploads < uploads_per_frame && state[tile].load(std::memory_order_acquire) == Loaded) {
+            upload(tile);
+            ++uploads;
+        }
+        else {
+            loading[kept++] = tile;
+        }
+    }
+    loading.resize(kept);
+
+    selection.clear();
+    requests.clear();
+    select(static_cast<int>(levels.size()) - 1, 0, 0, local_eye);
+
+    // coarse levels first (they replace the most), then the nearest
+    std::vector<std::pair<float, int>> order;
+    order.reserve(requests.size());
+    for (int tile : requests) {
+        int level, x, y;
+        tile_coordinates(tile, level, x, y);
+        order.emplace_back(-static_cast<float>(level) * 1e6f + tile_distance(level, x, y, local_eye), tile);
+    }
+    std::sort(order.begin(), order.end());
+    for (auto const& request : order) {
+        if (static_cast<int>(loading.size()) >= max_loads || !start_load(request.second))
+            break;
+    }
+
+    last.levels = static_cast<int>(levels.size());
+    last.slots = slots;
+    last.loading = static_cast<int>(loading.size());
+    last.resident = slots - static_cast<int>(free_slots.size()) - last.loading;
+}
+
+void TerrainPager::draw(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix,
+    glm::mat4 const& view_projection, GLuint texture_id, int texture_layer) {
+    last.drawn = 0;
+    last.triangles = 0;
+    if (!ready() || selection.empty())
+        return;
+
+    // frustum planes in the local space of the terrain, as TerrainLod
+    const glm::mat4 clip = view_projection * model;
+    const glm::vec4 row_w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+        const glm::vec4 row(clip[0][axis], clip[1][axis], clip[2][axis], clip[3][axis]);
+        planes[axis * 2] = row_w + row;
+        planes[axis * 2 + 1] = row_w - row;
+    }
+
+    shader.activate();
+    shader.setUniform("uM_m", model);
+    shader.setUniform("N_matrix", normal_matrix);
+    shader.setUniform("terrain_mode", 3);
+    shader.setUniform("height_map_size", glm::vec2(header.columns, header.rows));
+    shader.setUniform("height_map_range", glm::vec2(header.offset, header.step * 65535.0f));
+    if (texture_id > 0) {
+        glBindTextureUnit(0, texture_id);
+        shader.setUniform("tex0", 0);
+    }
+    glBindTextureUnit(2, texture);      // terrain_tiles, binding 2 in the shader
+    GLint layer_attrib_location = glGetAttribLocation(shader.getID(), "aLayer");
+    if (layer_attrib_location >= 0)
+        glVertexAttrib1f(layer_attrib_location, static_cast<GLfloat>(texture_layer));
+    const GLboolean culling = glIsEnabled(GL_CULL_FACE);
+    glDisable(GL_CULL_FACE);            // the skirts face either way
+
+    glBindVertexArray(vao);
+    for (int tile : selection) {
+        int level, x, y;
+        tile_coordinates(tile, level, x, y);
+        const int size = tile_size << level;
+        const glm::vec3 lo(-header.rows / 2.0f + y * size, header.min_height, -header.columns / 2.0f + x * size);
+        const glm::vec3 hi(lo.x + size, header.max_height, lo.z + size);
+        bool visible = true;
+        for (glm::vec4 const& plane : planes) {
+            glm::vec3 corner(plane.x > 0.0f ? hi.x : lo.x, plane.y > 0.0f ? hi.y : lo.y, plane.z > 0.0f ? hi.z : lo.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+                visible = false;
+                break;
+            }
+        }
+        if (!visible)
+            continue;
+        shader.setUniform("tile_params", glm::vec4(x * size, y * size, static_cast<float>(1 << level), static_cast<float>(slot_of[tile])));
+        glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr);
+        ++last.drawn;
+        last.triangles += index_count / 3;
+    }
+    if (culling)
+        glEnable(GL_CULL_FACE);
+    shader.setUniform("terrain_mode", 0);
+}
+
+bool TerrainPager::level_height(int level, float fx, float fz, float& h) const {
+    Level const& l = levels[level];
+    const float scale = 1.0f / static_cast<float>(1 << level);
+    const float lx = std::min(fx * scale, static_cast<float>(l.rows - 1));
+    const float lz = std::min(fz * scale, static_cast<float>(l.columns - 1));
+    const int ix = std::min(static_cast<int>(lx), l.rows - 2);
+    const int iz = std::min(static_cast<int>(lz), l.columns - 2);
+
+    // the tile of the sample holds its +1 neighbours too (apron)
+    const int tile_x = std::min(iz / tile_size, l.tiles_x - 1);
+    const int tile_y = std::min(ix / tile_size, l.tiles_y - 1);
+    const int tile = tile_index(level, tile_x, tile_y);
+    if (state[tile].load(std::memory_order_relaxed) != Resident)
+        return false;
+    std::uint16_t const* samples = slot_data.data() + static_cast<size_t>(slot_of[tile]) * tile_samples * tile_samples
+        + static_cast<size_t>(ix - tile_y * tile_size + 1) * tile_samples + (iz - tile_x * tile_size + 1);
+    auto at = [&](int r, int c) { return header.offset + static_cast<float>(samples[r * tile_samples + c]) * header.step; };
+
+    // same interpolation as Heightfield
+    const float tx = lx - static_cast<float>(ix);
+    const float tz = lz - static_cast<float>(iz);
+    const float h00 = at(0, 0);
+    const float h0 = h00 + (at(1, 0) - h00) * tx;
+    const float h01 = at(0, 1);
+    const float h1 = h01 + (at(1, 1) - h01) * tx;
+    h = h0 + (h1 - h0) * tz;
+    return true;
+}
+
+float TerrainPager::height(float x, float z) const {
+    if (levels.empty())
+        return 0.0f;
+    const float fx = std::min(std::max(x + header.rows * 0.5f, 0.0f), static_cast<float>(header.rows - 1));
+    const float fz = std::min(std::max(z + header.columns * 0.5f, 0.0f), static_cast<float>(header.columns - 1));
+    float h = 0.0f;
+    if (level_height(0, fx, fz, h))
+        return h;
+    if (procedural) {
+        // level 0 not resident: the samples as generate() would quantize them
+        const int ix = std::min(static_cast<int>(fx), header.rows - 2);
+        const int iz = std::min(static_cast<int>(fz), header.columns - 2);
+        auto at = [&](int r, int c) {
+            return header.offset + static_cast<float>(quantize(noise.height(static_cast<float>(ix + r), static_cast<float>(iz + c),
+                noise.octaves_for(1.0f)))) * header.step;
+        };
+        const float tx = fx - static_cast<float>(ix);
+        const float tz = fz - static_cast<float>(iz);
+        const float h00 = at(0, 0);
+        const float h0 = h00 + (at(1, 0) - h00) * tx;
+        const float h01 = at(0, 1);
+        const float h1 = h01 + (at(1, 1) - h01) * tx;
+        return h0 + (h1 - h0) * tz;
+    }
+    // the finest coarser level that is resident (the coarsest always is), as drawn there
+    for (int level = 1; level < static_cast<int>(levels.size()); ++level) {
+        if (level_height(level, fx, fz, h))
+            return h;
+    }
+    return h;
+}
+
+bool TerrainPager::raycast(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, HeightPyramid::Hit& hit) const {
+    hit = HeightPyramid::Hit{};
+    if (levels.empty())
+        return false;
+    // the part of the ray over the map, between the lowest and the highest sample
+    const glm::vec3 lo(-header.rows * 0.5f, header.min_height, -header.columns * 0.5f);
+    const glm::vec3 hi(lo.x + header.rows - 1, header.max_height, lo.z + header.columns - 1);
+    float t0 = 0.0f, t1 = max_t;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+                return false;
+            continue;
+        }
+        float near_t = (lo[axis] - origin[axis]) / direction[axis], far_t = (hi[axis] - origin[axis]) / direction[axis];
+        if (near_t > far_t)
+            std::swap(near_t, far_t);
+        t0 = std::max(t0, near_t);
+        t1 = std::min(t1, far_t);
+    }
+    if (t0 > t1)
+        return false;
+
+    auto above = [&](float t) {
+        const glm::vec3 p = origin + direction * t;
+        return p.y - height(p.x, p.z);
+    };
+    float t = t0;
+    if (above(t0) >= 0.0f) {
+        // half a sample horizontally per step (a vertical ray: the whole range, the difference is linear in t)
+        const float horizontal = std::max(std::abs(direction.x), std::abs(direction.z));
+        const float step = horizontal > 0.0f ? 0.5f / horizontal : t1 - t0;
+        float low = t0;                     // above the surface at low, below at t
+        for (;;) {
+            if (low >= t1)
+                return false;
+            t = std::min(low + step, t1);
+            if (above(t) < 0.0f)
+                break;
+            low = t;
+        }
+        for (int i = 0; i < 16; ++i) {
+            const float middle = 0.5f * (low + t);
+            (above(middle) >= 0.0f ? low : t) = middle;
+        }
+    }
+    // else: starts below the surface, hits where it enters the map
+
+    hit.hit = true;
+    hit.t = t;
+    hit.position = origin + direction * t;
+    const float e = 0.5f;
+    const float dx = height(hit.position.x + e, hit.position.z) - height(hit.position.x - e, hit.position.z);
+    const float dz = height(hit.position.x, hit.position.z + e) - height(hit.position.x, hit.position.z - e);
+    hit.normal = glm::normalize(glm::vec3(-dx / (2.0f * e), 1.0f, -dz / (2.0f * e)));
+    return true;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+#include "MappedFile.hpp"
+#include "JobSystem.hpp"
+#include "TerrainNoise.hpp"
+#include "HeightPyramid.hpp"
+
+// Out-of-core terrain: a heightmap baked into a tiled file (bake(), offline), paged in around the camera.
+//
+// File: Header, then the tiles of level 0, 1, ... (level L = every 2^L-th sample of the map), row by row.
+// A tile holds tile_samples^2 16-bit samples: the tile_size + 1 samples of its area plus a one sample apron on every
+// side (normals at the tile edges). height = offset + sample * step, for the whole map.
+// The header and every tile take Header::tile_stride bytes, a multiple of the page size of the machine that baked
+// the file: a tile owns its pages, so releasing them after the copy leaves nothing of it resident.
+//
+// At run time the file is memory mapped. update() selects the tiles for the camera, a quadtree over the levels as in
+// TerrainLod: a tile is replaced by its four children within lod_range() of its level when they are resident.
+// Missing tiles are copied out of the mapping by the job system (the mapped pages are released right after),
+// up to uploads_per_frame of them go into a texture array per frame, and the least recently used tiles are evicted
+// when the slots of the memory budget are used up. The coarsest level is loaded by open() and never evicted, so there
+// is always something to draw. height() answers from the finest resident level, as drawn (level 0 near the camera);
+// it never touches the mapping, so the resident memory stays within the budget however far the camera goes.
+// Tiles of different levels meet with skirts (lighting_shader.vert, terrain_mode = 3).
+// Procedural source: open(noise, size) pages a size x size map of TerrainNoise instead of a file. The tiles are
+// generated by the job system instead of copied (level L with the octaves of its sample spacing), height() evaluates
+// the noise where level 0 is not resident. The same seed gives the same tiles whatever the order of generation.
+// raycast() marches height() half a sample at a time and refines the crossing (no pyramid over an unbounded map);
+// a ridge narrower than that step can be missed. The tiles are read-only: the paged terrain cannot be deformed.
+class TerrainPager {
+public:
+    static constexpr int tile_size = 64;                    // quads per side of a tile (drawn at full resolution)
+    static constexpr int tile_samples = tile_size + 3;      // per side, with the apron
+    float detail_distance = 2.0f * tile_size;               // range of level 0, local units
+    int uploads_per_frame = 16;
+    int max_loads = 32;                                     // loads in flight
+
+    struct Header {
+        char magic[4];                  // "HTIL"
+        std::uint32_t version;
+        std::int32_t columns, rows;     // samples of level 0
+        std::int32_t tile_size;
+        std::int32_t levels;
+        float offset, step;             // height = offset + sample * step
+        float min_height, max_height;
+        std::uint32_t tile_stride;      // bytes from one tile to the next, whole pages; the first tile at tile_stride
+    };
+
+    struct Stats {
+        int levels = 0;
+        int slots = 0;                  // tiles that fit the memory budget
+        int resident = 0;
+        int loading = 0;
+        int drawn = 0;
+        long long triangles = 0;
+        long long loaded = 0;           // since open()
+        long long evicted = 0;
+    };
+
+    // sample(row, heights): one row of the map, 'columns' heights
+    static bool bake(std::filesystem::path const& file_name, int columns, int rows,
+        std::function<void(int row, float* heights)> const& sample);
+
+    // budget: CPU + GPU memory of the resident tiles
+    bool open(std::filesystem::path const& file_name, size_t budget_bytes);
+    bool open(TerrainNoise const& noise, int size, size_t budget_bytes);
+    void close(void);
+    bool ready(void) const { return texture != 0; }
+    int columns(void) const { return header.columns; }
+    int rows(void) const { return header.rows; }
+
+    void update(glm::vec3 const& local_eye);    // main thread: selection, loads, uploads, eviction
+    void draw(ShaderProgram& shader, glm::mat4 const& model, glm::mat3 const& normal_matrix,
+        glm::mat4 const& view_projection, GLuint texture_id, int texture_layer);
+
+    float height(float x, float z) const;       // local coordinates (x = row, z = column, centered), as Heightfield
+    // as HeightPyramid::raycast, local coordinates; any thread (reads as height())
+    bool raycast(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, HeightPyramid::Hit& hit) const;
+    Stats const& stats(void) const { return last; }
+    float lod_range(int level) const { return detail_distance * static_cast<float>(1 << level); }
+
+    ~TerrainPager() { close(); }
+
+private:
+    enum State : int { Absent, Loading, Loaded, Resident };    // Loaded: in the slot, not uploaded yet
+
+    struct Level {
+        int columns = 0, rows = 0;      // samples
+        int tiles_x = 0, tiles_y = 0;
+        int first_tile = 0;             // index of its first tile in the file
+    };
+
+    Header header{};
+    std::vector<Level> levels{};
+    MappedFile file;
+    TerrainNoise noise{};
+    bool procedural = false;                    // tiles from noise instead of file
+    size_t tile_bytes = 0;
+    size_t tile_stride = 0;                     // in the file
+
+    // per tile
+    std::unique_ptr<std::atomic<int>[]> state{};
+    std::vector<int> slot_of{};
+    std::vector<std::uint32_t> last_used{};
+
+    // per slot
+    int slots = 0;
+    std::vector<std::uint16_t> slot_data{};     // tile_samples^2 per slot
+    std::vector<int> tile_in_slot{};
+    std::vector<int> free_slots{};
+
+    std::vector<int> loading{};                 // tiles being loaded or waiting for the upload
+    std::vector<int> requests{};
+    std::vector<int> selection{};               // tiles to draw
+    JobSystem::Counter loads;
+    std::uint32_t frame = 0;
+    Stats last{};
+
+    GLuint texture = 0;                         // R16 array, one layer per slot
+    GLuint vao = 0, ebo = 0;
+    GLsizei index_count = 0;
+
+    static std::vector<Level> layout(int columns, int rows);   // levels down to a single tile
+    bool start(size_t budget_bytes, std::string const& source); // after the header: slots, texture, coarsest level
+    int tile_index(int level, int x, int y) const { return levels[level].first_tile + y * levels[level].tiles_x + x; }
+    void tile_coordinates(int tile, int& level, int& x, int& y) const;
+    void select(int level, int x, int y, glm::vec3 const& eye);
+    bool request(int tile);                     // true: resident
+    bool start_load(int tile);
+    void load(int tile, int slot);              // copy out of the mapping or generate, any thread
+    void generate(int tile, std::uint16_t* samples) const;
+    bool level_height(int level, float fx, float fz, float& h) const;  // bilinear in a resident tile of the level
+    std::uint16_t quantize(float h) const;
+    void upload(int tile);
+    float tile_distance(int level, int x, int y, glm::vec3 const& eye) const;
+};
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "TextureArray.hpp"
+
+cv::Mat TextureArray::load(std::filesystem::path const& file_name) {
+    cv::Mat image = cv::imread(file_name.string(), cv::IMREAD_UNCHANGED);  // Read with (potential) Alpha
+    if (image.empty()) {
+        throw std::runtime_error("No texture in file: " + file_name.string());
+    }
+    return image;
+}
+
+int TextureArray::add_texture(std::filesystem::path const& file_name) {
+    auto found = lookup.find(file_name.string());
+    if (found != lookup.end())
+        return found->second;
+    int layer = add_image(load(file_name));
+    lookup.emplace(file_name.string(), layer);
+    return layer;
+}
+
+int TextureArray::add_atlas_tile(std::filesystem::path const& atlas_name, int tiles_per_row, std::pair<int, int> tile) {
+    const std::string key = atlas_name.string() + "#" + std::to_string(tile.first) + "," + std::to_string(tile.second);
+    auto found = lookup.find(key);
+    if (found != lookup.end())
+        return found->second;
+
+    auto atlas = atlases.find(atlas_name.string());
+    if (atlas == atlases.end())
+        atlas = atlases.emplace(atlas_name.string(), load(atlas_name)).first;
+
+    cv::Mat const& image = atlas->second;
+    const int tile_width = image.cols / tiles_per_row;
+    const int tile_height = image.rows / tiles_per_row;
+    if (tile.first < 0 || tile.second < 0 || tile.first >= tiles_per_row || tile.second >= tiles_per_row) {
+        throw std::runtime_error("Atlas tile out of range: " + key);
+    }
+    // same orientation as the whole atlas: uploaded from the first OpenCV row, tile row 0 = top of the image
+    int layer = add_image(image(cv::Rect(tile.first * tile_width, tile.second * tile_height, tile_width, tile_height)));
+    lookup.emplace(key, layer);
+    return layer;
+}
+
+int TextureArray::add_image(cv::Mat const& image) {
+    if (image.empty()) {
+        throw std::runtime_error("Image empty?\n");
+    }
+    if (texture != 0) {
+        throw std::runtime_error("Texture array already built, layers can not be added");
+    }
+
+    cv::Mat bgra;
+    switch (image.channels()) {
+    case 1:
+        cv::cvtColor(image, bgra, cv::COLOR_GRAY2BGRA);
+        break;
+    case 3:
+        cv::cvtColor(image, bgra, cv::COLOR_BGR2BGRA);
+        break;
+    case 4:
+        bgra = image.clone();   // also makes a tile of the atlas continuous
+        break;
+    default:
+        throw std::runtime_error("unsupported channel cnt. in texture:" + std::to_string(image.channels()));
+    }
+    if (bgra.cols != layer_size || bgra.rows != layer_size) {
+        const bool shrink = bgra.cols > layer_size || bgra.rows > layer_size;
+        cv::Mat resized;
+        cv::resize(bgra, resized, cv::Size(layer_size, layer_size), 0, 0, shrink ? cv::INTER_AREA : cv::INTER_CUBIC);
+        bgra = resized;
+    }
+    pending.push_back(bgra);
+    return layer_count++;
+}
+
+void TextureArray::build(void) {
+    if (pending.empty())
+        return;
+    clear();
+
+    GLsizei levels = 1;     // full mip chain of one layer
+    for (int s = layer_size; s > 1; s /= 2)
+        ++levels;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glObjectLabel(GL_TEXTURE, texture, -1, "TextureArray");
+    glTextureStorage3D(texture, levels, GL_RGBA8, layer_size, layer_size, layer_count);
+    for (int layer = 0; layer < layer_count; ++layer) {
+        glTextureSubImage3D(texture, 0, 0, 0, layer, layer_size, layer_size, 1, GL_BGRA, GL_UNSIGNED_BYTE, pending[layer].data);
+    }
+
+    // mips are generated per layer, a layer never filters into another one
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // bilinear magnifying
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // trilinear minifying
+    glGenerateTextureMipmap(texture);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    pending.clear();
+    atlases.clear();
+}
+
+void TextureArray::clear(void) {
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+
+// All textures of the scene as the layers of one GL_TEXTURE_2D_ARRAY, so a draw selects its texture
+// with a layer index instead of a texture bind (draws with different textures can share one batch).
+// Atlas tiles are cut out into their own layers: every layer gets its own mip chain and REPEAT wrap,
+// so the mips of a tile never mix in the neighbouring tiles of the atlas.
+// All layers have the same size; images of a different size are resized to it.
+//
+//   TextureArray textures(512);
+//   int grass = textures.add_atlas_tile("tex_2048.png", 16, { 14, 4 });
+//   int wall = textures.add_texture("stone-wall.png");
+//   textures.build();   // GL upload, the layer indices stay valid
+class TextureArray {
+public:
+    explicit TextureArray(int layer_size = 512) : layer_size(layer_size) {}
+
+    // Both return the layer index; adding the same file (or tile) again returns the existing layer
+    int add_texture(std::filesystem::path const& file_name);
+    int add_atlas_tile(std::filesystem::path const& atlas_name, int tiles_per_row, std::pair<int, int> tile);   // tile = (column, row)
+    int add_image(cv::Mat const& image);
+
+    void build(void);       // creates the GL texture from all added layers, the CPU copies are released
+    void clear(void);       // deletes the GL texture
+
+    GLuint id(void) const { return texture; }
+    int layers(void) const { return layer_count; }
+    int size(void) const { return layer_size; }
+
+private:
+    int layer_size;
+    int layer_count = 0;
+    GLuint texture = 0;
+    std::vector<cv::Mat> pending{};                 // BGRA8 layers waiting for build()
+    std::map<std::string, int> lookup{};            // file or "file#column,row" -> layer
+    std::map<std::string, cv::Mat> atlases{};       // loaded atlases, until build()
+
+    static cv::Mat load(std::filesystem::path const& file_name);
+};
@@ -0,0 +1,196 @@
+// SIMD paths of the TRS -> matrix kernel, see TransformKernel.hpp
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#define TRANSFORM_KERNEL_SSE 1
+#endif
+
+#include "TransformKernel.hpp"
+
+namespace {
+
+// pointers to the SoA arrays of one batch (sin/cos are already evaluated)
+struct KernelInput {
+    const float *px, *py, *pz;
+    const float *cx, *sx, *cy, *sy, *cz, *sz;
+    const float *scx, *scy, *scz;
+};
+
+#ifdef TRANSFORM_KERNEL_SSE
+// SSE lanes: 4 objects per iteration
+struct Lanes4 {
+    using reg = __m128;
+    static constexpr size_t width = 4;
+    static reg load(const float* p) { return _mm_loadu_ps(p); }
+    static reg set1(float v) { return _mm_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+    static reg neg(reg a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    static __m128 half(reg a, int) { return a; }
+};
+
+#ifdef __AVX2__
+// AVX2 lanes: 8 objects per iteration
+struct Lanes8 {
+    using reg = __m256;
+    static constexpr size_t width = 8;
+    static reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg neg(reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    static __m128 half(reg a, int h) { return h == 0 ? _mm256_castps256_ps128(a) : _mm256_extractf128_ps(a, 1); }
+};
+#endif
+
+// Transpose one column of 4 objects from SoA registers and store it into their matrices.
+// stride is the size of one matrix in floats, width the number of floats stored per column (4 for mat4, 3 for mat3).
+inline void store_column4(__m128 x, __m128 y, __m128 z, __m128 w, float* dst, size_t stride, int width) {
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128 lanes[4] = { x, y, z, w };
+    for (int lane = 0; lane < 4; ++lane) {
+        float* p = dst + lane * stride;
+        if (width == 4) {
+            _mm_storeu_ps(p, lanes[lane]);
+        }
+        else {
+            _mm_storel_pi(reinterpret_cast<__m64*>(p), lanes[lane]);
+            _mm_store_ss(p + 2, _mm_movehl_ps(lanes[lane], lanes[lane]));
+        }
+    }
+}
+
+template <class L>
+inline void store_column(typename L::reg x, typename L::reg y, typename L::reg z, typename L::reg w, float* dst, size_t stride, int width) {
+    for (int h = 0; h < static_cast<int>(L::width / 4); ++h)
+        store_column4(L::half(x, h), L::half(y, h), L::half(z, h), L::half(w, h), dst + h * 4 * stride, stride, width);
+}
+
+// Same operations as TransformKernel::compose_one(), on L::width objects at once
+template <class L>
+void compose_block(KernelInput const& in, size_t i, glm::mat4* model, glm::mat3* normal) {
+    using reg = typename L::reg;
+    const reg one = L::set1(1.0f);
+    const reg zero = L::set1(0.0f);
+
+    reg cx = L::load(in.cx + i), sinx = L::load(in.sx + i);
+    reg cy = L::load(in.cy + i), siny = L::load(in.sy + i);
+    reg cz = L::load(in.cz + i), sinz = L::load(in.sz + i);
+
+    reg cx1 = L::add(cx, L::sub(one, cx));
+    reg cy1 = L::add(cy, L::sub(one, cy));
+    reg cz1 = L::add(cz, L::sub(one, cz));
+
+    reg b00 = L::mul(cx1, cy), b01 = L::mul(sinx, siny), b02 = L::neg(L::mul(cx, siny));
+    reg b11 = L::mul(cx, cy1), b12 = L::mul(sinx, cy1);
+    reg b20 = L::mul(cx1, siny), b21 = L::neg(L::mul(sinx, cy)), b22 = L::mul(cx, cy);
+
+    reg c00 = L::mul(b00, cz);
+    reg c01 = L::add(L::mul(b01, cz), L::mul(b11, sinz));
+    reg c02 = L::add(L::mul(b02, cz), L::mul(b12, sinz));
+    reg c10 = L::neg(L::mul(b00, sinz));
+    reg c11 = L::add(L::neg(L::mul(b01, sinz)), L::mul(b11, cz));
+    reg c12 = L::add(L::neg(L::mul(b02, sinz)), L::mul(b12, cz));
+    reg c20 = L::mul(b20, cz1), c21 = L::mul(b21, cz1), c22 = L::mul(b22, cz1);
+
+    float* m = &model[i][0][0];
+    float* n = &normal[i][0][0];
+    const size_t m_stride = sizeof(glm::mat4) / sizeof(float);
+    const size_t n_stride = sizeof(glm::mat3) / sizeof(float);
+
+    // one column at a time: M = translate * C * scale, N = C * inverse(scale)
+    reg scx = L::load(in.scx + i);
+    store_column<L>(L::mul(c00, scx), L::mul(c01, scx), L::mul(c02, scx), zero, m + 0, m_stride, 4);
+    reg ix = L::div(one, scx);
+    store_column<L>(L::mul(c00, ix), L::mul(c01, ix), L::mul(c02, ix), zero, n + 0, n_stride, 3);
+
+    reg scy = L::load(in.scy + i);
+    store_column<L>(L::mul(c10, scy), L::mul(c11, scy), L::mul(c12, scy), zero, m + 4, m_stride, 4);
+    reg iy = L::div(one, scy);
+    store_column<L>(L::mul(c10, iy), L::mul(c11, iy), L::mul(c12, iy), zero, n + 3, n_stride, 3);
+
+    reg scz = L::load(in.scz + i);
+    store_column<L>(L::mul(c20, scz), L::mul(c21, scz), L::mul(c22, scz), zero, m + 8, m_stride, 4);
+    reg iz = L::div(one, scz);
+    store_column<L>(L::mul(c20, iz), L::mul(c21, iz), L::mul(c22, iz), zero, n + 6, n_stride, 3);
+
+    store_column<L>(L::load(in.px + i), L::load(in.py + i), L::load(in.pz + i), one, m + 12, m_stride, 4);
+}
+#endif
+
+} // namespace
+
+void TransformKernel::resize_outputs(void) {
+    const size_t n = size();
+    if (trig_x.size() != n) {
+        // new objects: force the evaluation of their sin/cos (NaN never compares equal)
+        for (auto* v : { &trig_x, &trig_y, &trig_z })
+            v->resize(n, std::nanf(""));
+        for (auto* v : { &cos_x, &sin_x, &cos_y, &sin_y, &cos_z, &sin_z })
+            v->resize(n);
+    }
+    model_matrices.resize(n);
+    normal_matrices.resize(n);
+}
+
+void TransformKernel::prepare_range(size_t first, size_t last) {
+    // trigonometry stays scalar, so every path uses the same std::cos/std::sin results as glm::rotate(),
+    // and it is only evaluated for the angles that changed since the last compute
+    for (size_t i = first; i < last; ++i) {
+        if (ex[i] != trig_x[i]) { cos_x[i] = std::cos(ex[i]); sin_x[i] = std::sin(ex[i]); trig_x[i] = ex[i]; }
+        if (ey[i] != trig_y[i]) { cos_y[i] = std::cos(ey[i]); sin_y[i] = std::sin(ey[i]); trig_y[i] = ey[i]; }
+        if (ez[i] != trig_z[i]) { cos_z[i] = std::cos(ez[i]); sin_z[i] = std::sin(ez[i]); trig_z[i] = ez[i]; }
+    }
+}
+
+void TransformKernel::compute_range_scalar(size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+        compose_one(px[i], py[i], pz[i],
+            cos_x[i], sin_x[i], cos_y[i], sin_y[i], cos_z[i], sin_z[i],
+            sx[i], sy[i], sz[i], model_matrices[i], normal_matrices[i]);
+    }
+}
+
+void TransformKernel::compute_scalar(void) {
+    resize_outputs();
+    prepare_range(0, size());
+    compute_range_scalar(0, size());
+}
+
+void TransformKernel::compute(void) {
+    resize_outputs();
+    compute_range(0, size());
+}
+
+size_t TransformKernel::lanes(void) {
+#if defined(TRANSFORM_KERNEL_SSE) && defined(__AVX2__)
+    return Lanes8::width;
+#elif defined(TRANSFORM_KERNEL_SSE)
+    return Lanes4::width;
+#else
+    return 1;
+#endif
+}
+
+void TransformKernel::compute_range(size_t first, size_t last) {
+    prepare_range(first, last);
+    size_t i = first;
+
+#ifdef TRANSFORM_KERNEL_SSE
+    KernelInput in{ px.data(), py.data(), pz.data(),
+        cos_x.data(), sin_x.data(), cos_y.data(), sin_y.data(), cos_z.data(), sin_z.data(),
+        sx.data(), sy.data(), sz.data() };
+#ifdef __AVX2__
+    for (; i + Lanes8::width <= last; i += Lanes8::width)
+        compose_block<Lanes8>(in, i, model_matrices.data(), normal_matrices.data());
+#endif
+    for (; i + Lanes4::width <= last; i += Lanes4::width)
+        compose_block<Lanes4>(in, i, model_matrices.data(), normal_matrices.data());
+#endif
+
+    compute_range_scalar(i, last);   // remaining objects
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Builds model and normal matrices of many objects at once from SoA arrays of
+// position, Euler orientation (radians, X then Y then Z like Model) and scale.
+//
+// The product translate * rotateX * rotateY * rotateZ * scale is written out in closed form,
+// using exactly the multiplications and additions glm performs for the general 4x4 chain
+// (the zero terms are dropped). The scalar path is therefore bit-exact with the glm chain,
+// except for the sign of zero entries. The SSE (4 objects) / AVX2 (8 objects) paths do the
+// same operations per lane, sin/cos are evaluated by the same std::sin/std::cos calls
+// (and cached per object until its orientation changes).
+// Note: keep floating point contraction off (MSVC /fp:precise, GCC/Clang -ffp-contract=off),
+// otherwise the compiler may fuse the mul+add pairs and the results differ in the last bit.
+//
+// The normal matrix is computed as rotation * inverse(scale) instead of a full 4x4 inverse,
+// it matches glm::inverseTranspose up to float rounding.
+class TransformKernel {
+public:
+    // ------ SoA input ------
+    std::vector<float> px, py, pz;  // position
+    std::vector<float> ex, ey, ez;  // orientation: rotation by x,y,z axis, in radians
+    std::vector<float> sx, sy, sz;  // scale
+
+    // ------ output ------
+    std::vector<glm::mat4> model_matrices;
+    std::vector<glm::mat3> normal_matrices;
+
+    size_t size(void) const { return px.size(); }
+
+    void clear(void) {
+        for (auto* v : { &px, &py, &pz, &ex, &ey, &ez, &sx, &sy, &sz, &trig_x, &trig_y, &trig_z })
+            v->clear();
+    }
+
+    size_t add(glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& scale) {
+        px.push_back(origin.x); py.push_back(origin.y); pz.push_back(origin.z);
+        ex.push_back(orientation.x); ey.push_back(orientation.y); ez.push_back(orientation.z);
+        sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+        return size() - 1;
+    }
+
+    void set(size_t i, glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& scale) {
+        px[i] = origin.x; py[i] = origin.y; pz[i] = origin.z;
+        ex[i] = orientation.x; ey[i] = orientation.y; ez[i] = orientation.z;
+        sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+    }
+
+    // Compute all matrices, with SIMD when available (SSE2 always on x64, AVX2 when compiled with /arch:AVX2 or -mavx2,
+    // as my_app.vcxproj does)
+    void compute(void);
+    static size_t lanes(void);      // objects per iteration of compute() in this build: 8 (AVX2), 4 (SSE2) or 1
+    // Reference path, one object per iteration
+    void compute_scalar(void);
+
+    // Split computation, e.g. for several threads: resize_outputs() once, then compute_range() on disjoint ranges
+    void resize_outputs(void);
+    void compute_range(size_t first, size_t last);
+
+    // Single object version of the kernel
+    static glm::mat4 compose(glm::vec3 const& origin, glm::vec3 const& orientation, glm::vec3 const& scale) {
+        glm::mat4 m;
+        glm::mat3 n;
+        compose_one(origin.x, origin.y, origin.z,
+            std::cos(orientation.x), std::sin(orientation.x),
+            std::cos(orientation.y), std::sin(orientation.y),
+            std::cos(orientation.z), std::sin(orientation.z),
+            scale.x, scale.y, scale.z, m, n);
+        return m;
+    }
+
+    static void compose_one(float ox, float oy, float oz,
+        float cx, float sinx, float cy, float siny, float cz, float sinz,
+        float scx, float scy, float scz, glm::mat4& m, glm::mat3& n) {
+
+        // glm::rotate() puts c + (1 - c) on the diagonal entry of the rotation axis
+        float cx1 = cx + (1.0f - cx);
+        float cy1 = cy + (1.0f - cy);
+        float cz1 = cz + (1.0f - cz);
+
+        // B = rotateX * rotateY
+        float b00 = cx1 * cy, b01 = sinx * siny, b02 = -(cx * siny);
+        float b11 = cx * cy1, b12 = sinx * cy1;
+        float b20 = cx1 * siny, b21 = -(sinx * cy), b22 = cx * cy;
+
+        // C = B * rotateZ
+        float c00 = b00 * cz, c01 = b01 * cz + b11 * sinz, c02 = b02 * cz + b12 * sinz;
+        float c10 = -(b00 * sinz), c11 = -(b01 * sinz) + b11 * cz, c12 = -(b02 * sinz) + b12 * cz;
+        float c20 = b20 * cz1, c21 = b21 * cz1, c22 = b22 * cz1;
+
+        // M = translate * C * scale
+        m[0] = glm::vec4(c00 * scx, c01 * scx, c02 * scx, 0.0f);
+        m[1] = glm::vec4(c10 * scy, c11 * scy, c12 * scy, 0.0f);
+        m[2] = glm::vec4(c20 * scz, c21 * scz, c22 * scz, 0.0f);
+        m[3] = glm::vec4(ox, oy, oz, 1.0f);
+
+        // N = C * inverse(scale)
+        float ix = 1.0f / scx, iy = 1.0f / scy, iz = 1.0f / scz;
+        n[0] = glm::vec3(c00 * ix, c01 * ix, c02 * ix);
+        n[1] = glm::vec3(c10 * iy, c11 * iy, c12 * iy);
+        n[2] = glm::vec3(c20 * iz, c21 * iz, c22 * iz);
+    }
+
+private:
+    std::vector<float> cos_x, sin_x, cos_y, sin_y, cos_z, sin_z;
+    std::vector<float> trig_x, trig_y, trig_z;     // angles the cached sin/cos belong to
+
+    void prepare_range(size_t first, size_t last);
+    void compute_range_scalar(size_t first, size_t last);
+};
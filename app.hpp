@@ -4,13 +4,35 @@
 #include <opencv2/opencv.hpp>
 #include <unordered_map>
 #include <chrono>
+// Optional parts, left out when their libraries are missing (CMakeLists.txt defines these, my_app.vcxproj has both):
+// APP_NO_AUDIO  no irrKlang sound, APP_NO_FACE_TRACKER  no camera and face detection (steering stays neutral)
+#ifndef APP_NO_AUDIO
 #include <irrKlang/irrKlang.h>
+#endif
 
 #include "assets.hpp"
 #include "Model.hpp"
 #include "camera.hpp"
 #include "Heightmap.hpp"
+#include "TerrainPager.hpp"
+#include "HeightPyramid.hpp"
+#include "ProjectileSystem.hpp"
+#include "ParticleSystem.hpp"
+#include "FireflySwarm.hpp"
+#ifndef APP_NO_FACE_TRACKER
 #include "FaceTracker.hpp"
+#endif
+#include "SceneGraph.hpp"
+#include "EntityStore.hpp"
+#include "FrameGraph.hpp"
+#include "GpuProfiler.hpp"
+#include "FrameStats.hpp"
+#include "FramePacer.hpp"
+#include "FixedTimestep.hpp"
+#include "JobSystem.hpp"
+#include "DynamicResolution.hpp"
+#include "TextureArray.hpp"
+#include "HeadlessContext.hpp"
 
 
 #pragma once
@@ -27,11 +49,28 @@ public:
     void updateFPS(void);
     void update_projection_matrix(void);
     void switch_to_fullscreen(void);
-    float getTerrainHeight(float x, float z, const std::vector<std::vector<float>>& heightmap);
-
-    //------ For textures ------
-    GLuint textureInit(const std::filesystem::path& file_name);
-    GLuint gen_tex(cv::Mat& image);
+    float getTerrainHeight(float x, float z, const Heightfield& heightmap);
+    // first hit of origin + t * direction (t <= max_t) with the terrain, world coordinates as getTerrainHeight
+    // (the pyramid of Ground, or TerrainPager::raycast() for the paged terrain)
+    bool raycastTerrain(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, HeightPyramid::Hit& hit) const;
+    // lowers the terrain around a world position: heights, height texture and ray casts (disabled for the paged terrain)
+    void digCrater(glm::vec3 const& position, float radius, float depth);
+    // render 'frames' frames offscreen without window, audio and face tracking (call before init)
+    void set_headless(int frames, int width, int height) { headless = true; headless_frames = frames; this->width = width; this->height = height; }
+    void set_frame_stats_file(std::filesystem::path const& file) { frame_stats_file = file; }
+    void set_frame_limit(double hz) { pacer.set_target_hz(hz); }
+    void set_job_threads(int workers) { job_workers = workers; }
+    void set_resolution_scale(float scale) { dynamic_resolution.lock(scale); }     // fixed scale, e.g. for benchmarks
+    void set_terrain_file(std::filesystem::path const& file) { terrain_file = file; }
+    void set_terrain_rendering(Heightmap::Rendering rendering) { terrain_rendering = rendering; }
+    void set_quantized_heights(bool quantized) { quantized_heights = quantized; }
+    void set_paged_terrain(std::filesystem::path const& file) { paged_terrain_file = file; }
+    void set_terrain_budget(size_t bytes) { terrain_budget = bytes; }
+    // noise instead of the heightmap image; streamed: paged around the camera (size default 32769), otherwise Ground (2049)
+    void set_procedural_terrain(std::uint32_t seed, bool streamed) { noise_settings.seed = seed; procedural_terrain = true; streamed_noise = streamed; }
+    void set_procedural_size(int samples) { procedural_size = samples; }
+    void set_particle_budget(size_t particles) { particle_budget = particles; }
+    void set_firefly_count(size_t count) { firefly_count = count; }
 
     //------ Functions for video analisys ------
     //void draw_cross_normalized(cv::Mat& img, cv::Point2f center_relative, int size);
@@ -41,14 +80,18 @@ public:
 
     ~App(); //default destructor, called on app instance destruction
 private:
+#ifndef APP_NO_FACE_TRACKER
     cv::CascadeClassifier face_cascade = cv::CascadeClassifier("resources/haarcascade_frontalface_default.xml"); //variable needed for the face tracking
+#endif
     GLfloat r{ 1.0f }, g{ 1.0f }, b{ 1.0f }, a{ 1.0f };
     GLFWwindow* window = NULL;
     bool cursor_state = false;
     bool mute = false;
     bool night = false;
     bool flashlight = false;
-    bool leftclick = false;
+    bool print_frame_graph = false;
+    bool print_frame_stats = false;
+    double cpu_trace_seconds = 10.0;    // length of the written CPU trace
     float brightness = 0.0;
  
     //------Callback funcions start------
@@ -64,6 +107,7 @@ private:
     glm::vec3 translate = glm::vec3(0.0f);
     glm::vec3 rotate = glm::vec3(0.0f);
     glm::vec3 scale = glm::vec3(1.0f);
+    SceneGraph::NodeId world_root = SceneGraph::no_node;   // root node of the scene, uses translate, rotate and scale
 
     //------ For the camera transformation matrix ------
     int width, height;
@@ -80,8 +124,19 @@ private:
     GLFWmonitor* last_window_monitor;
     bool fullscreen = false;
 
-    //------ For vsync ------
-    bool vsync_on = true;
+    //------ For headless runs ------
+    bool headless = false;
+    int headless_frames = 0;
+    HeadlessContext headless_context;
+    bool gl_ready = false;                          // a context is current and GLEW loaded: GL objects can be deleted
+    void release_gl(void);                          // deletes the GL objects of the app, before the context goes away
+
+    //------ For vsync and frame pacing ------
+    FramePacer pacer;                               // swap interval, frame limiter, smoothed delta time
+    FixedTimestep sim_clock{ 120.0 };               // simulation steps of the camera and the movers
+
+    //------ For parallel work ------
+    int job_workers = -1;                           // worker threads of the job system, -1 = one per core besides the main thread
 
     //------ For FPS counting -----
     using Clock = std::chrono::high_resolution_clock;
@@ -90,25 +145,65 @@ private:
     TimePoint last_time;
     int frame_count;
     int fps = 0;
+    FrameStats frame_stats;                         // histograms of the frame, CPU and GPU times of the whole run
+    std::filesystem::path frame_stats_file = "frame_stats.json";    // written at shutdown
     
+#ifndef APP_NO_AUDIO
     //------ For 3D sound ------
     irrklang::ISoundEngine* engine = nullptr;
     irrklang::ISoundEngine* BackgroundEngine = nullptr;
+#endif
 
     glm::vec3 throw_start = glm::vec3(0.0f);
     glm::vec3 throw_dir = glm::vec3(0.0f);
     Model projectile;
+    ProjectileSystem projectiles;                   // thrown projectiles, one instanced draw of 'projectile'
+    ParticleSystem particles;                       // fire, sparks and smoke, simulated and drawn on the GPU
+    size_t particle_budget = 262144;                // particles alive at most, allocated once
+    int fire_layer = -1;                            // fire.png in the texture array
+    SceneGraph::NodeId torch_node = SceneGraph::no_node;   // the torch burns: a continuous fire emitter
+    float torch_emission = 0.0f;                    // fraction of a particle carried to the next frame
+    void emitImpact(glm::vec3 const& position);     // sparks, flames and smoke where a projectile hit the terrain
+    void onProjectileHit(Entity target, glm::vec3 const& position);    // gameplay: a projectile hit an object of the scene
+    size_t projectile_hits = 0;                     // objects hit since the start (stats, key P)
+    FireflySwarm swarm;                             // flocking fireflies around the moving one, simulated and drawn on the GPU
+    size_t firefly_count = 4096;
     glm::vec3 FaceTracResult = glm::vec3(0.0f, 0.0f, 0.0f);
     
 
 protected:
+#ifndef APP_NO_FACE_TRACKER
     cv::VideoCapture capture;  // global variable, move to app class, protected
+#endif
     Camera camera;
     ShaderProgram my_shader;
-    GLuint my_texture;
+    ShaderProgram terrain_shader;                   // tessellated terrain only, shares the uniforms of my_shader
+    TextureArray textures{ 128 };                   // all textures of the scene, one layer each; the size of an atlas tile
+                                                    // (tex_2048.png, 16 x 16): tiles are not upscaled, the other textures shrink to it
     Heightmap Ground;
-    std::unordered_map<std::string, Model> scene;   // all objects of the scene addressable by name
+    std::filesystem::path terrain_file = "resources/heightmaps/ground_v5.jpeg";
+    Heightmap::Rendering terrain_rendering = Heightmap::Rendering::Lod;
+    bool quantized_heights = false;                 // 16-bit heights (collision queries and the height texture)
+    HeightPyramid terrain_pyramid;                  // ray casts against Ground.heightmap (not built for the paged terrain)
+    TerrainPager pager;                             // out-of-core terrain, replaces the heightmap of Ground when open
+    std::filesystem::path paged_terrain_file;       // tiled file (Heightmap::bake_tiles), empty: Ground
+    size_t terrain_budget = 64 * 1024 * 1024;       // memory of the resident tiles
+    bool procedural_terrain = false;                // Ground or the pager from noise_settings
+    bool streamed_noise = false;
+    TerrainNoise::Settings noise_settings{};
+    int procedural_size = 0;                        // samples per side, 0: default
+    SceneGraph scene_graph;                         // transform hierarchy with cached world and normal matrices
+    std::unordered_map<std::string, Model> models;  // loaded models, shared by the entities of the scene
+    EntityStore scene{ scene_graph };               // all objects of the scene: entity handles + component arrays
+#ifndef APP_NO_FACE_TRACKER
     FaceTracker tracker;
+#endif
+    FrameGraph frame_graph;                         // render passes of the frame
+    GpuProfiler gpu_profiler;                       // GPU time of the passes and scopes
+    DynamicResolution dynamic_resolution;           // render scale of the 3D scene, follows the GPU time
+    ShaderProgram upscale_shader;                   // present pass: sharpening upscale of the scene to the window
+    GLuint fullscreen_vao = 0;                      // empty, the fullscreen triangle comes from gl_VertexID
+    GLuint upscale_sampler = 0;                     // bilinear, clamped
 
 };
 
@@ -4,15 +4,25 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>// OpenGL Extension Wrangler: allow all multiplatform GL functions
 #include <GL/glew.h> // WGLEW = Windows GL Extension Wrangler (change for different platform) platform specific functions (in this case Windows)
+#ifdef _WIN32
 #include <GL/wglew.h> // GLFW toolkit. Uses GL calls to open GL context, i.e. GLEW must be first.
+#endif
 #include <GLFW/glfw3.h> // OpenGL math
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <unordered_map>
 #include <chrono>
+#include <algorithm>
+#ifndef APP_NO_AUDIO
 #include <irrKlang/irrKlang.h>
+#endif
+#include <cerrno>
+#include <limits>
 #include <cstdlib>  // For rand() and srand()
 #include <ctime>    // For time()
+#if defined(__AVX2__) && defined(_MSC_VER)
+#include <intrin.h> // __cpuid, _xgetbv
+#endif
 
 #include "assets.hpp"
 #include "app.hpp"
@@ -22,7 +32,11 @@
 #include "Model.hpp"            //creates model from on .obj file using given shaders and calls draw mesh function. The update of the model matrix (translation, rotation and schaling of the loaded model in view space) also happens here.
 #include "camera.hpp"           // handles the movement of the camera (by updating he view matrix)
 #include "Heightmap.hpp"
+#ifndef APP_NO_FACE_TRACKER
 #include "FaceTracker.hpp"
+#endif
+#include "Benchmark.hpp"
+#include "CpuProfiler.hpp"
 
 //---------------------------------------------------------------------
 
@@ -37,35 +51,49 @@ App::App()
 
 bool App::init()
 {
-    //------ Set Error Callback ------ 
-    glfwSetErrorCallback(error_callback);
+    JobSystem::instance().start(job_workers);   // before the assets: the terrain generation uses it
+    if (headless && !dynamic_resolution.locked())
+        dynamic_resolution.lock(1.0f);  // reproducible headless runs: no scale changes from the measured GPU time
+    if (headless) {
+        //------ Context without window: EGL surfaceless, renders into an offscreen framebuffer ------
+        if (!headless_context.create())
+            return false;
+    }
+    else {
+        //------ Set Error Callback ------ 
+        glfwSetErrorCallback(error_callback);
 
-    //------ Initialize the library ------
-    if (!glfwInit())
-        return -1;
+        //------ Initialize the library ------
+        if (!glfwInit())
+            return -1;
 
-    //------ Set the application to use core profile version 4.6 ------
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        //------ Set the application to use core profile version 4.6 ------
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     
-    //------ Create a windowed mode window and its OpenGL context ------
-    window = glfwCreateWindow(640, 480, "Prototype app", NULL, NULL);
-    if (!window)
-    {
-        glfwTerminate();
-        return -1;
-    }
+        //------ Create a windowed mode window and its OpenGL context ------
+        window = glfwCreateWindow(640, 480, "Prototype app", NULL, NULL);
+        if (!window)
+        {
+            glfwTerminate();
+            return -1;
+        }
 
-    glfwSetWindowUserPointer(window, this);
-    glfwSetKeyCallback(window, key_callback);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, key_callback);
 
-    //------ Make the window's context current ------
-    glfwMakeContextCurrent(window);
+        //------ Make the window's context current ------
+        glfwMakeContextCurrent(window);
+    }
 
     //------ Initialise GLEW and WGLEW with error checking ------
     GLenum glew_ret;
     glew_ret = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (headless && glew_ret == GLEW_ERROR_NO_GLX_DISPLAY)
+        glew_ret = GLEW_OK;     // GLEW built for GLX: the GL functions are loaded, only the GLX part fails with an EGL context
+#endif
     if (glew_ret != GLEW_OK) {
         throw std::runtime_error(std::string("GLEW failed with error: ")
             + reinterpret_cast<const char*>(glewGetErrorString(glew_ret)));
@@ -73,7 +101,9 @@ bool App::init()
     else {
         std::cout << "GLEW successfully initialized to version: " << glewGetString(GLEW_VERSION) << std::endl;
     }
+    gl_ready = true;
 
+#ifdef _WIN32
     glew_ret = wglewInit(); // Platform specific init
     if (glew_ret != GLEW_OK) {
         throw std::runtime_error(std::string("WGLEW failed with error: ")
@@ -82,6 +112,9 @@ bool App::init()
     else {
         std::cout << "WGLEW successfully initialized platform specific functions." << std::endl;
     }
+#endif
+
+    pacer.init(window);     // swap interval needs the extensions loaded above
 
     //------ Check if we are in core or compatibility profile ------
     GLint myint;
@@ -114,6 +147,16 @@ bool App::init()
     if (!GLEW_ARB_direct_state_access)
         throw std::runtime_error("No DSA :-(");
 
+    if (headless) {
+        std::cout << "Headless: " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << ", "
+            << width << "x" << height << ", " << headless_frames << " frames" << std::endl;
+        if (!headless_context.create_framebuffer(width, height))
+            return false;
+        init_assets();  // Initialise: shaders, textures, models
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        return true;    // no audio and no face tracking on the benchmark machines
+    }
+
     //------ Get some glfw info ------
     int major, minor, revision;
     glfwGetVersion(&major, &minor, &revision);
@@ -125,15 +168,18 @@ bool App::init()
 
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+#ifndef APP_NO_AUDIO
     engine = irrklang::createIrrKlangDevice();
     if (!engine)
-        throw std::exception("Can not create 3D sound device");
+        throw std::runtime_error("Can not create 3D sound device");
     BackgroundEngine = irrklang::createIrrKlangDevice();
     if (!BackgroundEngine)
-        throw std::exception("Can not create background sound device");
+        throw std::runtime_error("Can not create background sound device");
+#endif
 
-    
+#ifndef APP_NO_FACE_TRACKER
     if (!tracker.init(0)) return -1; // camera index 0
+#endif
 
     return true;
 }
@@ -143,16 +189,50 @@ void App::init_assets(void) {
     // 
     // -----shaders------: load, compile, link, initialize params (may be moved global variables - if all models used same shader)
     my_shader = ShaderProgram("lighting_shader.vert", "lighting_shader.frag");
-
-    //------textures-----
-    my_texture = textureInit("resources/textures/tex_2048.png");
-    GLuint tower = textureInit("resources/textures/stone-wall.png");
-    GLuint glass = textureInit("resources/textures/glass.jpg");
-    GLuint Fireball = textureInit("resources/textures/fire.png");    
+    upscale_shader = ShaderProgram("upscale.vert", "upscale.frag");
+    glCreateVertexArrays(1, &fullscreen_vao);
+    glCreateSamplers(1, &upscale_sampler);
+    glSamplerParameteri(upscale_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(upscale_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(upscale_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(upscale_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    //------textures-----: the used tiles of the 16x16 atlas and the standalone textures, as layers of one texture array
+    const std::filesystem::path atlas = "resources/textures/tex_2048.png";
+    auto tile = [&](int column, int row) { return textures.add_atlas_tile(atlas, 16, { column, row }); };
+    const int ground_layer = tile(14, 4);
+    const int default_tile = tile(5, 8);
+    const int transparent_tile = tile(3, 4);
+    const int crate_tile = tile(4, 0);
+    const int wood_tile = tile(8, 1);
+    const int firefly_tile = tile(0, 3);
+    const int torch_tile = tile(1, 1);
+    const int tower = textures.add_texture("resources/textures/stone-wall.png");
+    const int glass = textures.add_texture("resources/textures/glass.jpg");
+    const int Fireball = textures.add_texture("resources/textures/fire.png");
+    textures.build();
+    const GLuint texture_array = textures.id();
 
     // ------Heightmap------
-    //Ground = Heightmap("resources/heightmaps/iceland_heightmap.png", my_shader, my_texture);
-    Ground = Heightmap("resources/heightmaps/ground_v5.jpeg", my_shader, my_texture);
+    //terrain_file = "resources/heightmaps/iceland_heightmap.png";
+    if (terrain_rendering == Heightmap::Rendering::Tessellated)
+        terrain_shader = ShaderProgram("terrain_tess.vert", "terrain_tess.tesc", "terrain_tess.tese", "lighting_shader.frag");
+    const TerrainNoise noise(noise_settings);
+    if ((procedural_terrain && streamed_noise && pager.open(noise, procedural_size > 0 ? procedural_size : 32769, terrain_budget))
+        || (!procedural_terrain && !paged_terrain_file.empty() && pager.open(paged_terrain_file, terrain_budget))) {
+        // tiles around the camera instead of the whole heightmap, Ground only provides the transform and texture
+        Ground.texture_id = texture_array;
+        Ground.texture_layer = ground_layer;
+        std::cout << "Paged terrain: ray casts march the tiles, impacts leave no craters (read-only tiles)\n";
+    }
+    else {
+        ShaderProgram& shader = terrain_rendering == Heightmap::Rendering::Tessellated ? terrain_shader : my_shader;
+        if (procedural_terrain)
+            Ground = Heightmap(noise, procedural_size > 0 ? procedural_size : 2049, shader, texture_array, ground_layer, terrain_rendering, quantized_heights);
+        else
+            Ground = Heightmap(terrain_file, shader, texture_array, ground_layer, terrain_rendering, quantized_heights);
+        terrain_pyramid.build(Ground.heightmap);
+    }
 
     // ------ Models ------: load model file, assign shader used to draw a model
 
@@ -163,141 +243,124 @@ void App::init_assets(void) {
     const int minborder = -15;
     const int maxborder = 15;
     glm::vec2 treecoords = glm::vec2(0.0f);
-    std::srand(static_cast<unsigned int>(std::time(0)));
+    std::srand(headless ? 1u : static_cast<unsigned int>(std::time(0)));  // headless runs are reproducible
     // --- ---
 
     float positionx = 0.0f;
     float positionz = 0.0f;
     
-    Model my_model = Model("resources/objects/cube_triangles_vnt.obj", my_shader, my_texture);
-    Model base = my_model;
-    Model transparent_model = my_model;
-    Model bottle = Model("resources/objects/bottle.obj", my_shader, glass);
-    Model Trees = Model("resources/objects/fir.obj", my_shader , my_texture);
-    Model Camp = Model("resources/objects/towers.obj", my_shader , tower);
-    Model mini_tower =Camp;
-    Model firefly = Model("resources/objects/firefly.obj", my_shader , my_texture);
-    Model torch = Model("resources/objects/Torch.obj", my_shader, my_texture);
-    projectile = Model("resources/objects/sphere.obj", my_shader, Fireball);
+    // models are loaded once and shared by all entities using them
+    Model& cube = models.emplace("cube", Model("resources/objects/cube_triangles_vnt.obj", my_shader, texture_array, crate_tile)).first->second;
+    Model& bottle = models.emplace("bottle", Model("resources/objects/bottle.obj", my_shader, texture_array, glass)).first->second;
+    Model& fir = models.emplace("fir", Model("resources/objects/fir.obj", my_shader, texture_array, default_tile)).first->second;
+    Model& towers = models.emplace("towers", Model("resources/objects/towers.obj", my_shader, texture_array, tower)).first->second;
+    Model& firefly = models.emplace("firefly", Model("resources/objects/firefly.obj", my_shader, texture_array, firefly_tile)).first->second;
+    Model& torch = models.emplace("torch", Model("resources/objects/Torch.obj", my_shader, texture_array, torch_tile)).first->second;
+    projectile = Model("resources/objects/sphere.obj", my_shader, texture_array, Fireball);
+    projectile.scale = glm::vec3(0.1f);
+    projectiles.create(8192);
+    projectiles.scale = projectile.scale.x;
+    projectiles.segment_step = Ground.scale.x;     // a step over more than one terrain cell may cross a ridge
+    projectiles.radius = projectile.scale.x * projectile.bounds_max.x;
+    particles.create(particle_budget);
+    fire_layer = Fireball;
+
+    // ------ Transform hierarchy ------
+    world_root = scene_graph.create();
+    scene_graph.setLocal(world_root, translate, rotate, scale);
+    Ground.attach(scene_graph, world_root);
+    if (Ground.lod.ready())     // the paged terrain has no single height texture: particles do not collide with it
+        particles.set_terrain(Ground.lod.height_map(), Ground.lod.height_map_size(), Ground.lod.height_map_range(), scene_graph.local(Ground.node));
+
+    // ------ Entities ------: transform + model (+ texture layer, transparency, movement)
+    // layer < 0: the texture of the model, otherwise the entity draws the shared model with its own texture layer
+    auto spawn = [&](std::string const& name, Model& model, glm::vec3 origin, glm::vec3 scale, int layer, SceneGraph::NodeId parent) {
+        Entity e = scene.create(name);
+        Transform t;
+        t.origin = origin;
+        t.scale = scale;
+        scene.add_transform(e, t, parent);
+        scene.renderables.add(e, Renderable{ &model });
+        if (layer >= 0)
+            scene.texture_layers.add(e, layer);
+        return e;
+    };
 
     positionz = -3.0f;
     float terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    my_model.origin = glm::vec3(positionx, terrainYm + 0.7f, positionz);
-    my_model.scale = glm::vec3(1.5f);
+    spawn("my_first_object", cube, glm::vec3(positionx, terrainYm + 0.7f, positionz), glm::vec3(1.5f), -1, world_root);
+    // trees: all positions first, then one batched height query
+    std::vector<float> tree_x(numPoints), tree_z(numPoints), tree_y(numPoints);
     for (int i = 0; i < numPoints; ++i) {
         float x, z;
         do {
             x = minCoordinate + static_cast<float>(std::rand()) / RAND_MAX * (maxCoordinate - minCoordinate);
             z = minCoordinate + static_cast<float>(std::rand()) / RAND_MAX * (maxCoordinate - minCoordinate);
         } while (x > minborder && x < maxborder && z > minborder && z < maxborder);
-        terrainYm = getTerrainHeight(x, z, Ground.heightmap);
-        Trees.origin = glm::vec3(x, terrainYm, z);
-        Trees.scale = glm::vec3(2.0f);
-        scene.insert({ std::string("Tree:").append(std::to_string(i)).c_str(), Trees });
+        tree_x[i] = x / Ground.scale.x;
+        tree_z[i] = z / Ground.scale.x;
+    }
+    if (pager.ready()) {
+        for (int i = 0; i < numPoints; ++i)
+            tree_y[i] = pager.height(tree_x[i], tree_z[i]);
+    }
+    else {
+        Ground.heightmap.sample(tree_x.data(), tree_z.data(), numPoints, tree_y.data());
+    }
+    for (int i = 0; i < numPoints; ++i) {
+        glm::vec3 position(tree_x[i] * Ground.scale.x, tree_y[i], tree_z[i] * Ground.scale.x);
+        spawn(std::string("Tree:").append(std::to_string(i)), fir, position, glm::vec3(2.0f), -1, world_root);
     }
     positionx = 20.0f;
     positionz = 20.0f;
     terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    Camp.origin = glm::vec3(positionx, terrainYm + 10.0f, positionz);
-    Camp.scale = glm::vec3(3.0f);
+    Entity camp = spawn("Tower", towers, glm::vec3(positionx, terrainYm + 10.0f, positionz), glm::vec3(3.0f), -1, world_root);
     positionx = 0.0f;
     positionz = 3.0f;
     terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    mini_tower.origin = glm::vec3(positionx, terrainYm + 1.5f, positionz);
-    mini_tower.scale = glm::vec3(0.05f);
-    base.origin = glm::vec3(positionx, terrainYm + 0.5f, positionz);
-    transparent_model.origin = glm::vec3(positionx, terrainYm + 1.45f, positionz);
-    transparent_model.transparent = true;
+    spawn("minitower", towers, glm::vec3(positionx, terrainYm + 1.5f, positionz), glm::vec3(0.05f), -1, world_root);
+    spawn("wooden_base", cube, glm::vec3(positionx, terrainYm + 0.5f, positionz), glm::vec3(1.0f), wood_tile, world_root);
+    Entity block = spawn("trasparent_block", cube, glm::vec3(positionx, terrainYm + 1.45f, positionz), glm::vec3(1.0f), transparent_tile, world_root);
+    scene.transparency.add(block, Transparency{});
     positionx = 0.0f;
     positionz = -3.5f;
     terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    bottle.origin = glm::vec3(positionx, terrainYm + 1.6f, positionz);
-    bottle.scale = glm::vec3(0.05f);
-    bottle.transparent = true;
+    Entity glass_bottle = spawn("trasparent_bottle", bottle, glm::vec3(positionx, terrainYm + 1.6f, positionz), glm::vec3(0.05f), -1, world_root);
+    scene.transparency.add(glass_bottle, Transparency{});
     positionx = 5.0f;
     positionz = 5.0f;
     terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    firefly.origin = glm::vec3(positionx, terrainYm+0.5f, positionz);
-    firefly.orientation = glm::vec3(glm::radians(-90.0f),0.0f, 0.0f);
-    firefly.scale = glm::vec3(0.05f);
+    Entity moving = spawn("Moving_model", firefly, glm::vec3(positionx, terrainYm + 0.5f, positionz), glm::vec3(0.05f), -1, world_root);
+    scene.transforms.get(moving)->orientation = glm::vec3(glm::radians(-90.0f), 0.0f, 0.0f);
+    scene.update_transform(moving);
+    Mover firefly_path;
+    firefly_path.light = 3;   // the firefly carries light 3
+    scene.movers.add(moving, firefly_path);
+    scene_graph.update();
+    // the swarm flies around the same spot, its model turned like the entity
+    if (firefly_count > 0) {
+        swarm.orientation = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        swarm.create(firefly_count, glm::vec3(positionx, terrainYm, positionz), 30.0f);
+        if (Ground.lod.ready())
+            swarm.set_terrain(Ground.lod.height_map(), Ground.lod.height_map_size(), Ground.lod.height_map_range(), scene_graph.local(Ground.node));
+    }
+
+    // the torch is carried by the tower: place it into the local space of the tower without changing its world position
     positionx = 13.5f;
     positionz = 15.5f;
     terrainYm = getTerrainHeight(positionx, positionz, Ground.heightmap);
-    torch.origin = glm::vec3(positionx, terrainYm + 16.0f, positionz);
-    torch.scale = glm::vec3(0.5f);
-    positionx = 0.0f;
-    positionz = 0.0f;
-    projectile.origin = glm::vec3(positionx, 0.5f, positionz);
-    projectile.scale = glm::vec3(0.1f);
-
-    // put model to scene
-    scene.insert({ "my_first_object", my_model });
-    scene.insert({ "trasparent_block", transparent_model });
-    scene.insert({ "trasparent_bottle", bottle });
-    scene.insert({ "Tower", Camp });
-    scene.insert({ "Moving_model", firefly });
-    scene.insert({ "light_2", torch });
-    scene.insert({ "wooden_base", base });
-    scene.insert({ "minitower", mini_tower });
-    
-
-    my_model.meshes.clear();
-}
-
-GLuint App::textureInit(const std::filesystem::path& file_name){
-    // Initialise texture based on given image
-
-    cv::Mat image = cv::imread(file_name.string(), cv::IMREAD_UNCHANGED);  // Read with (potential) Alpha
-    if (image.empty()) {
-        throw std::runtime_error("No texture in file: " + file_name.string());
+    Transform const& tower_transform = *scene.transforms.get(camp);
+    Entity torch_entity = spawn("light_2", torch, scene_graph.toLocalPoint(tower_transform.node, glm::vec3(positionx, terrainYm + 16.0f, positionz)),
+        glm::vec3(0.5f) / tower_transform.scale, -1, tower_transform.node);
+    torch_node = scene.transforms.get(torch_entity)->node;
+    scene_graph.update();
+
+    // ------ Colliders ------: every drawn entity is a box of its model in the broadphase, in the space of the projectiles
+    const glm::mat4 root_space = glm::inverse(scene_graph.world(world_root));
+    for (size_t i = 0; i < scene.renderables.size(); ++i) {
+        Model const* model = scene.renderables.data[i].model;
+        scene.add_collider(scene.renderables.owners[i], model->bounds_min, model->bounds_max, root_space);
     }
-    
-    // or print warning, and generate synthetic image with checkerboard pattern 
-    // using OpenCV and use as a texture replacement 
-
-    GLuint texture = gen_tex(image);
-
-    return texture;
-}
-
-GLuint App::gen_tex(cv::Mat& image){
-    // Generate texture from loaded image file
-
-    GLuint ID = 0;
-
-    if (image.empty()) {
-        throw std::runtime_error("Image empty?\n");
-    }
-
-    // Generates an OpenGL texture object
-    glCreateTextures(GL_TEXTURE_2D, 1, &ID);
-    glObjectLabel(GL_TEXTURE, ID, -1, "Mytexture");
-
-    switch (image.channels()) {
-    case 3:
-        // Create and clear space for data - immutable format
-        glTextureStorage2D(ID, 1, GL_RGB8, image.cols, image.rows);
-        // Assigns the image to the OpenGL Texture object
-        glTextureSubImage2D(ID, 0, 0, 0, image.cols, image.rows, GL_BGR, GL_UNSIGNED_BYTE, image.data);
-        break;
-    case 4:
-        glTextureStorage2D(ID, 1, GL_RGBA8, image.cols, image.rows);
-        glTextureSubImage2D(ID, 0, 0, 0, image.cols, image.rows, GL_BGRA, GL_UNSIGNED_BYTE, image.data);
-        break;
-    default:
-        throw std::runtime_error("unsupported channel cnt. in texture:" + std::to_string(image.channels()));
-    }
-
-    // MIPMAP filtering + automatic MIPMAP generation - nicest, needs more memory. Notice: MIPMAP is only for image minifying.
-    glTextureParameteri(ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // bilinear magnifying
-    glTextureParameteri(ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // trilinear minifying
-    glGenerateTextureMipmap(ID);  //Generate mipmaps now.
-
-    // Configures the way the texture repeats
-    glTextureParameteri(ID, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTextureParameteri(ID, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    return ID;
 }
 
 void App::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {   //Handles the callback events for all the key inputs
@@ -311,59 +374,84 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
             std::cout << "ESC has been pressed!\n";
             glfwSetWindowShouldClose(window, GLFW_TRUE);
             break;
-        case GLFW_KEY_V:    // Toggle VSync on-off by glfwSwapInterval(...)
-            app->vsync_on = !app->vsync_on;  // Toggle the flag
-            glfwSwapInterval(app->vsync_on ? 1 : 0);  // Apply new VSync setting
+        case GLFW_KEY_V:    // Cycle VSync off -> on -> adaptive (swap interval 0, 1, -1 where swap_control_tear is supported)
+            app->pacer.cycle_vsync();
+            break;
+        case GLFW_KEY_L:    // Cycle the frame limiter: off, 30, 60, 120, 144 Hz
+        {
+            static const double limits[] = { 0.0, 30.0, 60.0, 120.0, 144.0 };
+            const double* current = std::find(std::begin(limits), std::end(limits), app->pacer.target_hz());
+            size_t next = (current == std::end(limits)) ? 0 : (current - std::begin(limits) + 1) % std::size(limits);
+            app->pacer.set_target_hz(limits[next]);
             break;
+        }
         case GLFW_KEY_TAB:  // Toggle between full screen and vindowed mode
-            if (app->fullscreen == FALSE) {
+            if (app->fullscreen == false) {
                 app->switch_to_fullscreen();
                 //app->update_projection_matrix();
-                app->fullscreen = TRUE;
+                app->fullscreen = true;
             }
             else {
                 glfwSetWindowMonitor(window, app->last_window_monitor, app->last_window_xpos,
                     app->last_window_ypos, app->last_window_width, app->last_window_height, GLFW_DONT_CARE);
                // app->update_projection_matrix();
-                app->fullscreen = FALSE;
+                app->fullscreen = false;
             }
             break; 
         case GLFW_KEY_C:    //Toggle the status of the cursor between locked and free
-            if (app->cursor_state == FALSE) {
+            if (app->cursor_state == false) {
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-                app->cursor_state = TRUE;
+                app->cursor_state = true;
             }
             else{
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-                app->cursor_state = FALSE;
+                app->cursor_state = false;
             }
             break;
         case GLFW_KEY_M:    // Mute/unmute the audio
-            if (app->mute == FALSE) {
-                app->mute = TRUE;
+            if (app->mute == false) {
+                app->mute = true;
             }
             else {
-                app->mute = FALSE;
+                app->mute = false;
             }
             break;
         case GLFW_KEY_F:    // toggle flashlight
-            if (app->flashlight == FALSE) {
-                app->flashlight = TRUE;
+            if (app->flashlight == false) {
+                app->flashlight = true;
                 app->brightness = 10.0f;
                 app->my_shader.setUniform("lights[1].ambientM", glm::vec3(0.05f, 0.05f, 0.05f));
                 app->my_shader.setUniform("lights[1].diffuseM", glm::vec3(1.0f * app->brightness, 0.95f * app->brightness, 0.8f * app->brightness));
                 app->my_shader.setUniform("lights[1].specularM", glm::vec3(1.0f * app->brightness, 0.95f * app->brightness, 0.9f * app->brightness));
             }
             else {
-                app->flashlight = FALSE;
+                app->flashlight = false;
                 app->my_shader.setUniform("lights[1].ambientM", glm::vec3(0.0f, 0.0f, 0.0f));
                 app->my_shader.setUniform("lights[1].diffuseM", glm::vec3(0.0f, 0.0f, 0.0f));
                 app->my_shader.setUniform("lights[1].specularM", glm::vec3(0.0f, 0.0f, 0.0f));
             }
             break;
+        case GLFW_KEY_G:    // print the compiled frame graph (passes, resources, memory) and the GPU time of all scopes
+            app->print_frame_graph = true;
+            break;
+        case GLFW_KEY_P:    // print the frame time percentiles, hitches and the graph of the last frames
+            app->print_frame_stats = true;
+            break;
+        case GLFW_KEY_R:    // lock / unlock the dynamic resolution scale at its current value
+            if (app->dynamic_resolution.locked())
+                app->dynamic_resolution.unlock();
+            else
+                app->dynamic_resolution.lock(app->dynamic_resolution.scale());
+            break;
+        case GLFW_KEY_T:    // CPU profiler: first press starts recording, next presses write the trace of the last seconds
+            if (!CpuProfiler::instance().enabled())
+                CpuProfiler::instance().set_enabled(true);
+            else
+                CpuProfiler::instance().write_chrome_trace("cpu_trace.json", app->cpu_trace_seconds);
+            break;
         case GLFW_KEY_N:    // Change day/night
-            if (app->night == FALSE) {//set to night
-                app->night = TRUE;
+            if (app->night == false) {//set to night
+                app->night = true;
                 app->brightness = 0.1f;
                 app->my_shader.setUniform("fog_color", glm::vec4(glm::vec3(0.0f), 1.0f));
                 app->my_shader.setUniform("lights[0].ambientM", glm::vec3(0.05f, 0.05f, 0.1f));
@@ -371,7 +459,7 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
                 app->my_shader.setUniform("lights[0].specularM", glm::vec3(0.3f * app->brightness, 0.3f * app->brightness, 0.5f * app->brightness));
             }
             else {//set to day
-                app->night = FALSE;
+                app->night = false;
                 app->my_shader.setUniform("fog_color", glm::vec4(glm::vec3(0.85f), 1.0f));
                 app->my_shader.setUniform("lights[0].ambientM", glm::vec3(0.2f, 0.2f, 0.2f));
                 app->my_shader.setUniform("lights[0].diffuseM", glm::vec3(1.0f, 0.95f, 0.8f));
@@ -386,7 +474,8 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
 }
 
 void App::update_projection_matrix() {  //Update the projection matrix
-    glfwGetFramebufferSize(window, &width, &height);
+    if (window)     // headless: fixed size
+        glfwGetFramebufferSize(window, &width, &height);
     if (height <= 0) // avoid division by 0
         height = 1;
 
@@ -445,36 +534,68 @@ void App::switch_to_fullscreen(void) {
     glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
 }
 
-float App::getTerrainHeight(float x, float z, const std::vector<std::vector<float>>& heightmap) {
-    int terrainWidth = Ground.width;
-    int terrainHeight = Ground.height;
+float App::getTerrainHeight(float x, float z, const Heightfield& heightmap) {
     float terrainScale = Ground.scale.x;  // Only need to be changed if the scale of the heightmap is changed
-    float fx = (x + terrainHeight / 2.0f) / terrainScale;
-    float fz = (z + terrainWidth / 2.0f) / terrainScale;
-
-    int ix = (int)fx;
-    int iz = (int)fz;
-
-    // Clamp to terrain boundaries
-    ix = std::max(0, std::min(ix, terrainWidth - 2));
-    iz = std::max(0, std::min(iz, terrainHeight - 2));
-
-    // Heights of surrounding points
-    float h00 = heightmap[ix][iz];
-    float h10 = heightmap[ix + 1][iz];
-    float h01 = heightmap[ix][iz + 1];
-    float h11 = heightmap[ix + 1][iz + 1];
-
-    // Fractional part for interpolation
-    float fracx = fx - ix;
-    float fracz = fz - iz;
-
-    // Bilinear interpolation
-    float h0 = h00 * (1 - fracx) + h10 * fracx;
-    float h1 = h01 * (1 - fracx) + h11 * fracx;
-    return h0 * (1 - fracz) + h1 * fracz;
+    // bilinear between the samples, clamped to the terrain boundaries
+    if (pager.ready())
+        return pager.height(x / terrainScale, z / terrainScale);
+    return heightmap.height(x / terrainScale, z / terrainScale);
 }
 
+bool App::raycastTerrain(glm::vec3 const& origin, glm::vec3 const& direction, float max_t, HeightPyramid::Hit& hit) const {
+    const glm::vec3 to_local(1.0f / Ground.scale.x, 1.0f, 1.0f / Ground.scale.x);   // as getTerrainHeight: only x and z are scaled
+    const bool found = pager.ready() ? pager.raycast(origin * to_local, direction * to_local, max_t, hit)
+        : terrain_pyramid.raycast(origin * to_local, direction * to_local, max_t, hit);
+    if (!found)
+        return false;
+    hit.position = origin + direction * hit.t;
+    hit.normal = glm::normalize(hit.normal * to_local);     // normals scale inversely
+    return true;
+}
+
+void App::digCrater(glm::vec3 const& position, float radius, float depth) {
+    if (pager.ready() || !Ground.lod.ready())    // the tiles of the paged terrain are read-only (see init_assets)
+        return;
+    const HeightRegion region = Ground.crater(position.x / Ground.scale.x, position.z / Ground.scale.x, radius / Ground.scale.x, depth);
+    terrain_pyramid.update(region);
+    if (region.rows == Ground.heightmap.rows() && region.columns == Ground.heightmap.columns()) {
+        // the whole map: the 16-bit heights were widened, the texture has a new range
+        particles.set_terrain(Ground.lod.height_map(), Ground.lod.height_map_size(), Ground.lod.height_map_range(), scene_graph.local(Ground.node));
+        if (swarm.ready())
+            swarm.set_terrain(Ground.lod.height_map(), Ground.lod.height_map_size(), Ground.lod.height_map_range(), scene_graph.local(Ground.node));
+    }
+}
+
+void App::onProjectileHit(Entity target, glm::vec3 const& position) {
+    if (!scene.alive(target))
+        return;
+    ++projectile_hits;
+    emitImpact(position);
+}
+
+void App::emitImpact(glm::vec3 const& position) {
+    ParticleSystem::Emitter sparks;
+    sparks.kind = ParticleSystem::Kind::Spark;
+    sparks.position = position + glm::vec3(0.0f, 0.1f, 0.0f);
+    sparks.velocity = glm::vec3(0.0f, 4.0f, 0.0f);
+    sparks.spread = 3.0f;
+    sparks.lifetime = 1.2f;
+    sparks.size = 0.08f;
+    particles.emit(sparks, 160);
+    ParticleSystem::Emitter flames;
+    flames.position = position;
+    flames.radius = 0.4f;
+    flames.velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+    flames.lifetime = 0.6f;
+    flames.size = 0.6f;
+    particles.emit(flames, 60);
+    ParticleSystem::Emitter smoke = flames;
+    smoke.kind = ParticleSystem::Kind::Smoke;
+    smoke.radius = 0.6f;
+    smoke.lifetime = 2.5f;
+    smoke.size = 0.8f;
+    particles.emit(smoke, 30);
+}
 
 void App::cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     auto app = static_cast<App*>(glfwGetWindowUserPointer(window));
@@ -493,13 +614,15 @@ void App::mouse_button_callback(GLFWwindow* window, int button, int action, int
         app->b = 1.0f;
     }*/
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-        if(app->leftclick == false){
-            app->leftclick = true;
-            app->projectile.origin = app->camera.Position;
-            app->projectile.velocity = glm::normalize(app->camera.Front)*10.0f;
-            app->scene.insert({ "throwable_rock", app->projectile });
-        }
-        
+        // a slot of the pool, nothing is allocated; ignored when all of them are flying
+        app->projectiles.spawn(app->camera.Position, glm::normalize(app->camera.Front) * 10.0f);
+    }
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
+        // pick the terrain under the crosshair (center of the view)
+        HeightPyramid::Hit hit;
+        if (app->raycastTerrain(app->camera.Position, glm::normalize(app->camera.Front), 1000.0f, hit))
+            std::cout << "Terrain at (" << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << "), " << hit.t
+                << " away, normal (" << hit.normal.x << ", " << hit.normal.y << ", " << hit.normal.z << ")\n";
     }
 }
 
@@ -519,22 +642,20 @@ int App::run(void)
     glCullFace(GL_BACK);  // The default
     glEnable(GL_CULL_FACE); // assume ALL objects are non-transparent 
     
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);    // Disable cursor, so that it can not leave window, and we can process movement
-    glfwGetCursorPos(window, &cursorLastX, &cursorLastY);           // get first position of mouse cursor
+    if (window) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);    // Disable cursor, so that it can not leave window, and we can process movement
+        glfwGetCursorPos(window, &cursorLastX, &cursorLastY);           // get first position of mouse cursor
+    }
 
     update_projection_matrix();
     glViewport(0, 0, width, height);    //Set viewport
 
     camera.Position = glm::vec3(0.0, 10.0, 0.0);    // Setting the camera starting position
+    camera.PreviousPosition = camera.Position;
 
     glm::vec4 my_rgba = glm::vec4(r,g,b,a); // Creatiing the vector for the color input of the object
-    a = 0.1f;
-    glm::vec4 transparent_rgba = glm::vec4(r, g, b, a);
-    float tile_size = 1.0f / 16;            // Size of one tile on the texture atlas
-    glm::vec2 tile_offset = glm::vec2(0.0f* tile_size, 0.0f * tile_size);   // Setting the position of the desired tile of the texture atlas
 
     // Setting variables for the FPS calculations
-    double last_frame_time = glfwGetTime();
     last_time = Clock::now();
     frame_count = 0;
 
@@ -543,7 +664,7 @@ int App::run(void)
     // ----- Setting the parameters of the desired lights. (All parameters needs to be set from the s_lights struct for it to work >.<)------
     // Currently these parameters generatte a green and a blue pointlight at the top and bottom of the loaded in textured cube
     const int maxlights = 4;
-    my_shader.setUniform("N_matrix", Ground.normal_matrix); //Needed for light calculations
+    my_shader.setUniform("N_matrix", scene_graph.normal(Ground.node)); //Needed for light calculations
 
     brightness = 5;
     //glm::vec3 spotDir = glm::normalize(glm::vec3(glm::inverse(camera.GetViewMatrix()) * eyeCoords));
@@ -606,16 +727,24 @@ int App::run(void)
     my_shader.setUniform("specular_shinines", 80.0f);
     //------ ------
 
-    std::vector<Model*> transparent;    // temporary, vector of pointers to transparent objects
-    transparent.reserve(scene.size());  // reserve size for all objects to avoid reallocation
+    std::vector<DrawItem> opaque;       // draw lists, rebuilt every frame (capacity is kept between frames)
+    std::vector<DrawItem> transparent;
+    std::vector<Entity> landed;         // thrown objects that hit the ground in this frame
+    std::vector<ProjectileSystem::Impact> impacts;
+    impacts.reserve(projectiles.capacity());
     
+#ifndef APP_NO_AUDIO
     //----- 2D & 3D audio -----    
     // position, playLooped = true, startPaused = true, track = true
-    irrklang::ISound* music = engine->play3D("resources/music/birds.mp3", irrklang::vec3df(0, 0, 0), false, true, true); // loop, start paused, enable 3D sound
-    irrklang::ISound* BackgroundMusic = BackgroundEngine -> play2D("resources/music/Relaxing_Green_Nature_David_Fesliyan.mp3", true, true, false); // loop, start paused, enable 3D sound
-    // The minimum distance is the distance in which the sound gets played at maximum volume.
-    music->setMinDistance(5.0f); // Make sound source bigger. (Default = 1.0 = "small" sound source.)
-    music->setIsPaused(false); // Start playing
+    irrklang::ISound* music = nullptr;
+    irrklang::ISound* BackgroundMusic = nullptr;
+    if (engine && BackgroundEngine) {   // no audio when headless
+        music = engine->play3D("resources/music/birds.mp3", irrklang::vec3df(0, 0, 0), false, true, true); // loop, start paused, enable 3D sound
+        BackgroundMusic = BackgroundEngine -> play2D("resources/music/Relaxing_Green_Nature_David_Fesliyan.mp3", true, true, false); // loop, start paused, enable 3D sound
+        // The minimum distance is the distance in which the sound gets played at maximum volume.
+        music->setMinDistance(5.0f); // Make sound source bigger. (Default = 1.0 = "small" sound source.)
+        music->setIsPaused(false); // Start playing
+    }
     
     if (BackgroundMusic) {
         std::cout << "Current volume:" << BackgroundMusic->getVolume(); // float, [0.0 to 1.0]
@@ -632,205 +761,464 @@ int App::run(void)
         // Unpause
         music->setIsPaused(false);
     }
+#endif
 
     float eyeHeight = 1.8f;
+#ifndef APP_NO_FACE_TRACKER
     // Start background worker
-    if (!tracker.startWorker()) return -1;
+    if (!headless && !tracker.startWorker()) return -1;
+#endif
     std::uint64_t last_seq = 0;
 
-    while (!glfwWindowShouldClose(window)) {    //Main loop of the application
+    int headless_frame = 0;
+    TimePoint run_start = Clock::now();
+
+    frame_graph.set_profiler(&gpu_profiler);
+    CpuProfiler::instance().set_thread_name("main");
+
+    // frame statistics: wall clock interval between frame starts, CPU time until the swap, GPU time when read back
+    TimePoint frame_start = Clock::now();
+    double cpu_ms = -1.0;
+    size_t gpu_measured = gpu_profiler.measured_frames();
+
+    while (headless ? headless_frame < headless_frames : !glfwWindowShouldClose(window)) {    //Main loop of the application
         
-        // Set all the callback functions we want to be active during the runtime of the application (Only the set functions with declaration will be active, just declaring a callback function is not enough)
-        glfwSetCursorPosCallback(window, cursor_position_callback);
-        glfwSetMouseButtonCallback(window, mouse_button_callback);
-        glfwSetWindowTitle(window, std::string("FPS: ").append(std::to_string(fps)).append(" Vsync: ").append(std::to_string(vsync_on)).c_str());   //Set the window title to show current FPS of the application and if Vsync is active or not
-        glfwSetWindowSizeCallback(window,framebuffer_size_callback);
-
-        //glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // Set background color
-        if (night) {
-            glClearColor(0.02f, 0.02f, 0.08f, 1.0f);
+        CPU_ZONE("frame");
+        JobSystem::instance().run_main_jobs();  // GL work handed to the main thread by jobs
+        {
+            TimePoint now = Clock::now();
+            double gpu_ms = -1.0;
+            if (gpu_profiler.measured_frames() != gpu_measured) {
+                gpu_measured = gpu_profiler.measured_frames();
+                gpu_ms = gpu_profiler.frame_ms();
+            }
+            if (cpu_ms >= 0.0)  // not before the first frame
+                frame_stats.record(std::chrono::duration<double, std::milli>(now - frame_start).count(), cpu_ms, gpu_ms);
+            if (gpu_ms >= 0.0)
+                dynamic_resolution.update(gpu_ms);
+            frame_start = now;
         }
-        else { glClearColor(0.53f, 0.81f, 0.92f, 1.0f); }  // sky blue RGBA
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear canvas
-
-        double current_frame_time = glfwGetTime(); //Needed for FPS calculation
-
-        double delta_t = current_frame_time - last_frame_time; // render time of the last frame 
-        last_frame_time = current_frame_time;
-        camera.ProcessInput(window, delta_t); // process keys etc.
-        //--- Process ground colision ---
-        float terrainY = getTerrainHeight(camera.Position.x, camera.Position.z, Ground.heightmap);
-        float minEyeY = terrainY + eyeHeight;
-        if (camera.Position.y < minEyeY) {
-            camera.Position.y = minEyeY;
-            camera.Velocity.y = 0.0f;
-            camera.onground = true;
+        gpu_profiler.begin_frame();
+        if (window) {
+            // Set all the callback functions we want to be active during the runtime of the application (Only the set functions with declaration will be active, just declaring a callback function is not enough)
+            glfwSetCursorPosCallback(window, cursor_position_callback);
+            glfwSetMouseButtonCallback(window, mouse_button_callback);
+            glfwSetWindowTitle(window, std::string("FPS: ").append(std::to_string(fps)).append(" ").append(pacer.status()).append(" GPU: ").append(std::to_string(gpu_profiler.frame_ms())).append(" ms")
+                .append(" Res: ").append(std::to_string(static_cast<int>(std::lround(dynamic_resolution.scale() * 100.0f)))).append(dynamic_resolution.locked() ? "% (locked)" : "%").c_str());   //Set the window title to show current FPS, GPU time of the frame and if Vsync is active or not
+            glfwSetWindowSizeCallback(window,framebuffer_size_callback);
         }
-        else {
-            camera.onground = false;
+
+        // smoothed frame time; headless: fixed 60 Hz, so every run simulates exactly the same frames
+        double delta_t = headless ? 1.0 / 60.0 : pacer.begin_frame();
+
+        // ------ Simulation: fixed steps, independent of the frame rate; rendering interpolates between the last two steps ------
+        {
+            CPU_ZONE("simulation");
+            const int steps = sim_clock.advance(delta_t);
+            const float step = static_cast<float>(sim_clock.step);
+            for (int i = 0; i < steps; ++i) {
+                camera.PreviousPosition = camera.Position;
+                if (window)
+                    camera.ProcessInput(window, step); // process keys etc.
+                //--- Process ground colision ---
+                float terrainY = getTerrainHeight(camera.Position.x, camera.Position.z, Ground.heightmap);
+                float minEyeY = terrainY + eyeHeight;
+                if (camera.Position.y < minEyeY) {
+                    camera.Position.y = minEyeY;
+                    camera.Velocity.y = 0.0f;
+                    camera.onground = true;
+                }
+                else {
+                    camera.onground = false;
+                }
+                //--- ---
+
+                landed.clear();
+                scene.update_movers(step, FaceTracResult,
+                    [&](float x, float z) { return getTerrainHeight(x, z, Ground.heightmap); },
+                    [&](glm::vec3 const& from, glm::vec3 const& to) { HeightPyramid::Hit hit; return raycastTerrain(from, to - from, 1.0f, hit); },
+                    landed);
+                for (Entity e : landed) {
+                    // the impact: where the last step crossed the surface, or below the object if it was already under it
+                    Transform const* t = scene.transforms.get(e);
+                    Mover const* mover = scene.movers.get(e);
+                    if (t && mover) {
+                        HeightPyramid::Hit hit;
+                        const glm::vec3 impact = raycastTerrain(mover->previous, t->origin - mover->previous, 1.0f, hit) ? hit.position : t->origin;
+                        digCrater(impact, 1.5f, 0.5f);
+                        emitImpact(impact);
+                    }
+                    scene.destroy(e);
+                }
+                scene.update_colliders(glm::inverse(scene_graph.world(world_root)));
+
+                impacts.clear();
+                projectiles.update(step, FaceTracResult,
+                    [&](float* x, float* z, size_t count, float* heights) {
+                        for (size_t i = 0; i < count; ++i) {    // into the local space of the terrain, as getTerrainHeight
+                            x[i] /= Ground.scale.x;
+                            z[i] /= Ground.scale.x;
+                        }
+                        if (pager.ready()) {
+                            for (size_t i = 0; i < count; ++i)
+                                heights[i] = pager.height(x[i], z[i]);
+                        }
+                        else {
+                            Ground.heightmap.sample(x, z, count, heights);
+                        }
+                    },
+                    [&](glm::vec3 const& from, glm::vec3 const& to, glm::vec3& point) {
+                        HeightPyramid::Hit hit;
+                        if (!raycastTerrain(from, to - from, 1.0f, hit))
+                            return false;
+                        point = hit.position;
+                        return true;
+                    },
+                    &scene.broadphase, impacts);
+                for (ProjectileSystem::Impact const& impact : impacts) {
+                    if (impact.object != SpatialHash::no_object) {     // an object: no crater
+                        onProjectileHit(scene.entity(impact.object), impact.position);
+                        continue;
+                    }
+                    digCrater(impact.position, 1.5f, 0.5f);
+                    emitImpact(impact.position);
+                }
+            }
         }
-        //--- ---
+        const float sim_alpha = sim_clock.alpha();
+        const glm::vec3 eye = camera.GetRenderPosition(sim_alpha);
 
-        my_shader.setUniform("uV_m", camera.GetViewMatrix());   // Update the view matrix based on the viewmatrix of the camera
+        const glm::mat4 view_matrix = camera.GetViewMatrix(sim_alpha);
+        my_shader.setUniform("uV_m", view_matrix);   // Update the view matrix based on the viewmatrix of the camera
         my_shader.setUniform("uP_m", projection_matrix);        
         
-        // --- Set the color and texture tile (from texture atlas) of the object ---     
-        tile_offset = glm::vec2(14.0f * tile_size, 4.0f * tile_size);
+        // --- Set the color of the object (the texture layer is chosen per draw) ---     
         my_shader.setUniform("my_color", my_rgba);
-        my_shader.setUniform("tileSize", tile_size);
-        my_shader.setUniform("tileOffset", tile_offset);  
 
 
-        my_shader.setUniform("lights[1].position", glm::vec4(camera.Position, 1.0f));
+        my_shader.setUniform("lights[1].position", glm::vec4(eye, 1.0f));
         my_shader.setUniform("lights[1].direction", glm::vec3(camera.Front.x * delta_t, camera.Front.y * delta_t, camera.Front.z * delta_t));
 
-        // --- set the 3D audio ---
-        // move sound source
-        irrklang::vec3df newPosition(20.0, 10.0, 20.0);
-        music->setPosition(newPosition);
-        // move Listener (similar to Camera)
-        irrklang::vec3df position(camera.Position.x, camera.Position.y, camera.Position.z); // position of the listener
-        irrklang::vec3df lookDirection(camera.Front.x, camera.Front.y, camera.Front.z); // the direction the listener looks into
-        irrklang::vec3df velPerSecond(0, 0, 0); // only relevant for doppler effects
-        irrklang::vec3df upVector(camera.Up.x, camera.Up.y, camera.Up.z); // where 'up' is in your 3D scene
-        engine->setListenerPosition(position, lookDirection, velPerSecond, upVector);
-
-        if (mute) {
-            music->setIsPaused(true);
-            BackgroundMusic->setIsPaused(true);
-        }
-        else {
-            music->setIsPaused(false);
-            BackgroundMusic->setIsPaused(false);
+#ifndef APP_NO_AUDIO
+        if (music) {    // no audio when headless
+            CPU_ZONE("audio");
+            // --- set the 3D audio ---
+            // move sound source
+            irrklang::vec3df newPosition(20.0, 10.0, 20.0);
+            music->setPosition(newPosition);
+            // move Listener (similar to Camera)
+            irrklang::vec3df position(eye.x, eye.y, eye.z); // position of the listener
+            irrklang::vec3df lookDirection(camera.Front.x, camera.Front.y, camera.Front.z); // the direction the listener looks into
+            irrklang::vec3df velPerSecond(0, 0, 0); // only relevant for doppler effects
+            irrklang::vec3df upVector(camera.Up.x, camera.Up.y, camera.Up.z); // where 'up' is in your 3D scene
+            engine->setListenerPosition(position, lookDirection, velPerSecond, upVector);
+
+            if (mute) {
+                music->setIsPaused(true);
+                BackgroundMusic->setIsPaused(true);
+            }
+            else {
+                music->setIsPaused(false);
+                BackgroundMusic->setIsPaused(false);
+            }
         }
-    
+
         if (music && music->isFinished()){
             music->drop();
             music = nullptr;
         }
+#endif
                         
-        // draw all models in the scene
-        glFrontFace(GL_CW);
-        Ground.draw(translate, rotate, scale);
-        glFrontFace(GL_CCW);
-        if (auto res = tracker.getLatest(last_seq)) {
-            if (res->face_found) {
-                std::cout << "Face at px: " << res->center_px
-                    << " norm: " << res->center_norm << '\n';
-                float ndcX = -(res->center_norm.x * 2.0f - 1.0f);
-                float ndcY = 1.0f - res->center_norm.y * 2.0f;
-                glm::vec3 targetPos(ndcX, ndcY, 0.0f); // new position from face tracker
-                float alpha = 0.1f; // smoothing factor: smaller = smoother, slower
-                FaceTracResult = alpha * targetPos + (1.0f - alpha) * FaceTracResult;
+#ifndef APP_NO_FACE_TRACKER
+        if (!headless) {    // no face tracking when headless
+            CPU_ZONE("face tracker poll");
+            if (auto res = tracker.getLatest(last_seq)) {
+                if (res->face_found) {
+                    std::cout << "Face at px: " << res->center_px
+                        << " norm: " << res->center_norm << '\n';
+                    float ndcX = -(res->center_norm.x * 2.0f - 1.0f);
+                    float ndcY = 1.0f - res->center_norm.y * 2.0f;
+                    glm::vec3 targetPos(ndcX, ndcY, 0.0f); // new position from face tracker
+                    float alpha = 0.1f; // smoothing factor: smaller = smoother, slower
+                    FaceTracResult = alpha * targetPos + (1.0f - alpha) * FaceTracResult;
+                }
+            }
+            else {
+                std::cout << "No face detected\n";
+                //FaceTracResult = glm::vec3(0.0f, 0.0f, 0.0f);
             }
         }
-        else {
-            std::cout << "No face detected\n";
-            //FaceTracResult = glm::vec3(0.0f, 0.0f, 0.0f);
+#endif
+
+        // interpolated transforms of the moving entities, then recompute the cached matrices of everything that moved
+        {
+            CPU_ZONE("scene update");
+            scene.interpolate_movers(sim_alpha);
+            projectiles.upload(sim_alpha);
+            scene_graph.setLocal(world_root, translate, rotate, scale);
+            scene_graph.update();
+            for (size_t i = 0; i < scene.movers.size(); ++i) {   // lights carried by moving entities
+                Mover const& mover = scene.movers.data[i];
+                if (mover.light >= 0) {
+                    SceneGraph::NodeId node = scene.transforms.get(scene.movers.owners[i])->node;
+                    my_shader.setUniform("lights[" + std::to_string(mover.light) + "].position", glm::vec4(glm::vec3(scene_graph.world(node)[3]), 1.0f));
+                }
+            }
+
+            scene.build_draw_lists(eye, opaque, transparent);
+        }
+
+        // ------ Particles: emitted on the CPU, simulated and compacted on the GPU, nothing read back ------
+        {
+            CPU_ZONE("particles");
+            auto gpu_scope = gpu_profiler.scope("particles");
+            if (torch_node != SceneGraph::no_node) {
+                ParticleSystem::Emitter flame;
+                flame.position = glm::vec3(glm::inverse(scene_graph.world(world_root)) * scene_graph.world(torch_node) * glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+                flame.radius = 0.08f;
+                flame.velocity = glm::vec3(0.0f, 0.6f, 0.0f);
+                flame.spread = 0.25f;
+                flame.lifetime = 0.7f;
+                flame.size = 0.35f;
+                particles.emit(flame, ParticleSystem::due(torch_emission, 90.0f, static_cast<float>(delta_t)));
+            }
+            particles.update(static_cast<float>(delta_t));
+            my_shader.activate();   // the uniforms below are set on the scene shader
+        }
+
+        // ------ Firefly swarm: flocking, model instances and the brightest flashes as lights, all on the GPU ------
+        if (swarm.ready()) {
+            CPU_ZONE("fireflies");
+            auto gpu_scope = gpu_profiler.scope("fireflies");
+            swarm.update(static_cast<float>(delta_t), scene_graph.world(world_root), eye);
+            my_shader.activate();
         }
-                
-        transparent.clear();
+        my_shader.setUniform("swarm_lights_enabled", swarm.ready() ? 1 : 0);
+
+        // ------ Frame graph: forward passes render into transient targets, the result is upscaled to the window ------
+        // dynamic resolution: the scene covers the lower left render_width x render_height of the full size targets
+        if (window) {   // follows resizes and fullscreen switches; minimized (0 x 0): keeps the last size
+            int framebuffer_width = 0, framebuffer_height = 0;
+            glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+            if (framebuffer_width > 0 && framebuffer_height > 0) {
+                width = framebuffer_width;
+                height = framebuffer_height;
+            }
+        }
+        const GLsizei render_width = dynamic_resolution.scaled(width);
+        const GLsizei render_height = dynamic_resolution.scaled(height);
+        frame_graph.reset();
+        FrameGraph::ResourceId backbuffer = frame_graph.import_backbuffer("backbuffer", width, height, headless_context.framebuffer());
+        FrameGraph::ResourceId scene_color = FrameGraph::no_resource;
+        FrameGraph::ResourceId scene_depth = FrameGraph::no_resource;
+
         // FIRST PART - draw all non-transparent in any order
-        for (auto& [name, model] : scene) {
-            my_shader.setUniform("N_matrix", model.normal_matrix); //Needed for light calculations
-            if (!model.transparent) {
-                if (name == "my_first_object") {
-                    tile_offset = glm::vec2(4.0f * tile_size, 0.0f * tile_size);
-                    my_shader.setUniform("tileOffset", tile_offset);
-                    model.draw(translate, rotate, scale);
-                }else if (name == "Moving_model") {
-                    tile_offset = glm::vec2(0.0f * tile_size, 3.0f * tile_size);
-                    my_shader.setUniform("tileOffset", tile_offset);
-                    float height = getTerrainHeight(model.origin.x,model.origin.z,Ground.heightmap);
-                    model.circlepath(delta_t,height);
-                    my_shader.setUniform("lights[3].position", glm::vec4(model.origin, 1.0f));
-                    model.draw(translate, rotate, scale);
+        frame_graph.add_pass("opaque",
+            [&](FrameGraph::PassBuilder& pass) {
+                scene_color = pass.create("scene_color", { width, height, GL_RGBA8 });
+                scene_depth = pass.create("scene_depth", { width, height, GL_DEPTH_COMPONENT32F });
+            },
+            [&](FrameGraph&) {
+                glViewport(0, 0, render_width, render_height);
+                if (night) {
+                    glClearColor(0.02f, 0.02f, 0.08f, 1.0f);
                 }
-                else if (name == "wooden_base") {
-                    tile_offset = glm::vec2(8.0f * tile_size, 1.0f * tile_size);
-                    my_shader.setUniform("tileOffset", tile_offset);
-                    model.draw(translate, rotate, scale);
+                else { glClearColor(0.53f, 0.81f, 0.92f, 1.0f); }  // sky blue RGBA
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear canvas
+
+                {
+                    auto gpu_scope = gpu_profiler.scope("terrain");
+                    glFrontFace(GL_CW);
+                    if (terrain_rendering == Heightmap::Rendering::Tessellated)
+                        terrain_shader.copyUniforms(my_shader);     // camera, lights, fog
+                    if (pager.ready()) {
+                        pager.update(glm::vec3(glm::inverse(scene_graph.world(Ground.node)) * glm::vec4(eye, 1.0f)));
+                        pager.draw(my_shader, scene_graph.world(Ground.node), scene_graph.normal(Ground.node),
+                            projection_matrix * view_matrix, Ground.texture_id, Ground.texture_layer);
+                    }
+                    else {
+                        Ground.draw(scene_graph, projection_matrix * view_matrix, eye);
+                    }
+                    glFrontFace(GL_CCW);
                 }
-                else if (name == "light_2") {
-                    tile_offset = glm::vec2(1.0f * tile_size, 1.0f * tile_size);
-                    my_shader.setUniform("tileOffset", tile_offset);
-                    model.draw(translate, rotate, scale);
+
+                auto gpu_scope = gpu_profiler.scope("models");
+                for (DrawItem const& item : opaque) {
+                    item.model->draw(scene_graph, item.node, item.layer);
                 }
-                else if (name == "throwable_rock") {
-                    if (leftclick) {
-                            model.flyghtpath(delta_t, FaceTracResult);
-                            model.draw(translate, rotate, scale);
-                            if (model.origin.y < getTerrainHeight(model.origin.x, model.origin.z, Ground.heightmap)) {
-                                leftclick = false;
-                                continue;
-                            }
-                        }
-                        else {
-                            continue;
-                        }
-                    
+                projectiles.draw(projectile, scene_graph.world(world_root), scene_graph.normal(world_root));
+                swarm.draw(models.at("firefly"), scene_graph.world(world_root), scene_graph.normal(world_root));
+            });
+
+        // SECOND PART - draw only transparent - painter's algorithm (sorted by distance from camera, from far to near)
+        frame_graph.add_pass("transparent",
+            [&](FrameGraph::PassBuilder& pass) {
+                pass.read(scene_depth, FrameGraph::Access::Attachment);    // depth test only, no depth writes
+                pass.read(scene_color, FrameGraph::Access::Attachment);    // blending
+                pass.write(scene_color);
+            },
+            [&](FrameGraph&) {
+                glViewport(0, 0, render_width, render_height);
+                // set GL for transparent objects // TODO: from lectures
+                glEnable(GL_BLEND);
+                glDepthMask(GL_FALSE); 
+                glDisable(GL_CULL_FACE);
+                // draw sorted transparent
+                for (DrawItem const& item : transparent) {
+                    my_shader.setUniform("my_color", item.color);
+                    item.model->draw(scene_graph, item.node, item.layer);
                 }
-                else{
-                    tile_offset = glm::vec2(5.0f * tile_size, 8.0f * tile_size);
-                    my_shader.setUniform("tileOffset", tile_offset);
-                    model.draw(translate, rotate, scale);
+                {
+                    auto gpu_scope = gpu_profiler.scope("particles draw");
+                    particles.draw(scene_graph.world(world_root), view_matrix, projection_matrix, textures.id(), fire_layer);
+                    my_shader.activate();
                 }
-                
-            }
-            else
-                transparent.emplace_back(&model); // save pointer for painters algorithm
-        }
-
-        if (!leftclick)
-            scene.erase("throwable_rock");
-
-        tile_offset = glm::vec2(3.0f * tile_size, 4.0f * tile_size);
-        my_shader.setUniform("tileOffset", tile_offset);
-        my_shader.setUniform("my_color", transparent_rgba);
+                {
+                    auto gpu_scope = gpu_profiler.scope("fireflies draw");
+                    swarm.draw_glow(scene_graph.world(world_root), view_matrix, projection_matrix);
+                    my_shader.activate();
+                }
+                // restore GL properties for non-transparent objects // TODO: from lectures
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+                glEnable(GL_CULL_FACE);
+            });
 
-        // SECOND PART - draw only transparent - painter's algorithm (sort by distance from camera, from far to near)
-        std::sort(transparent.begin(), transparent.end(), [&](Model const* a, Model const* b) {
-            glm::vec3 translation_a = glm::vec3(a->model_matrix[3]);  // get 3 values from last column of model matrix = translation
-            glm::vec3 translation_b = glm::vec3(b->model_matrix[3]);  // dtto for model B
-            return glm::distance(camera.Position, translation_a) < glm::distance(camera.Position, translation_b); // sort by distance from camera
+        frame_graph.add_pass("present",
+            [&](FrameGraph::PassBuilder& pass) {
+                pass.read(scene_color, FrameGraph::Access::Sampled);
+                pass.write(backbuffer, FrameGraph::Access::Attachment);
+            },
+            [&](FrameGraph& graph) {
+                FrameGraph::TextureDesc const& size = graph.desc(scene_color);
+                const float scale = dynamic_resolution.scale();
+                upscale_shader.activate();
+                upscale_shader.setUniform("scene", 0);
+                upscale_shader.setUniform("uv_scale", glm::vec2(static_cast<float>(render_width) / size.width, static_cast<float>(render_height) / size.height));
+                upscale_shader.setUniform("texel", glm::vec2(1.0f / size.width, 1.0f / size.height));
+                upscale_shader.setUniform("sharpness", scale < 1.0f ? 0.5f + 0.5f * (1.0f - scale) : 0.0f);  // more sharpening for stronger upscaling
+                glBindTextureUnit(0, graph.texture(scene_color));
+                glBindSampler(0, upscale_sampler);
+                glDisable(GL_DEPTH_TEST);
+                glBindVertexArray(fullscreen_vao);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                glBindVertexArray(0);
+                glEnable(GL_DEPTH_TEST);
+                glBindSampler(0, 0);
+                my_shader.activate();   // the uniforms of the next frame are set on the scene shader
             });
 
-        // set GL for transparent objects // TODO: from lectures
-        glEnable(GL_BLEND);
-        glDepthMask(GL_FALSE); 
-        glDisable(GL_CULL_FACE);
-        // draw sorted transparent
-        for (auto p : transparent) {
-            my_shader.setUniform("N_matrix", p->normal_matrix);
-            my_shader.setUniform("uM_m", p->model_matrix);
-            p->draw();
+        {
+            CPU_ZONE("render");
+            frame_graph.compile();
+            frame_graph.execute();
+        }
+        if (print_frame_graph) {
+            std::cout << frame_graph.dump() << gpu_profiler.report();
+            print_frame_graph = false;
+        }
+
+        if (print_frame_stats) {
+            std::cout << frame_stats.report() << "Resolution scale: " << dynamic_resolution.scale()
+                << (dynamic_resolution.locked() ? " (locked)" : "") << ", " << render_width << "x" << render_height << '\n';
+            if (Ground.lod.ready()) {
+                TerrainLod::Stats const& terrain = Ground.lod.stats();
+                std::cout << "Terrain: " << terrain.triangles << " triangles, " << terrain.patches << " patches, " << terrain.draws << " draws";
+                if (Ground.rendering == Heightmap::Rendering::Lod)
+                    std::cout << ", " << terrain.nodes << " nodes visited, " << terrain.levels << " levels";
+                std::cout << ", " << Ground.lod.gpu_bytes() / 1024 << " KB on the GPU\n";
+            }
+            if (pager.ready()) {
+                TerrainPager::Stats const& terrain = pager.stats();
+                std::cout << "Terrain: " << terrain.triangles << " triangles, " << terrain.drawn << " tiles drawn, " << terrain.resident << "/"
+                    << terrain.slots << " resident, " << terrain.loading << " loading, " << terrain.loaded << " loaded, " << terrain.evicted << " evicted\n";
+            }
+            if (particles.ready()) {
+                ParticleSystem::Stats const particle_stats = particles.stats();
+                std::cout << "Particles: " << particle_stats.alive << "/" << particles.capacity() << " alive, " << particle_stats.dropped << " dropped (budget)\n";
+            }
+            std::cout << "Projectiles: " << projectiles.size() << " in flight, " << projectile_hits << " objects hit\n";
+            print_frame_stats = false;
         }
-        // restore GL properties for non-transparent objects // TODO: from lectures
-        glDisable(GL_BLEND);
-        glDepthMask(GL_TRUE);
-        glEnable(GL_CULL_FACE);
 
+        gpu_profiler.end_frame();
         updateFPS();
-        glfwSwapBuffers(window);        
-        glfwPollEvents();
+        cpu_ms = std::chrono::duration<double, std::milli>(Clock::now() - frame_start).count();
+        if (window) {
+            {
+                CPU_ZONE("frame limiter");
+                pacer.limit();
+            }
+            {
+                CPU_ZONE("swap buffers");
+                glfwSwapBuffers(window);        
+            }
+            CPU_ZONE("poll events");
+            glfwPollEvents();
+        }
+        else {
+            ++headless_frame;
+        }
     }
 
+    if (headless) {
+        glFinish();
+        double seconds = std::chrono::duration<double>(Clock::now() - run_start).count();
+        std::cout << "Headless: " << headless_frame << " frames in " << seconds << " s, "
+            << seconds * 1000.0 / std::max(headless_frame, 1) << " ms per frame\n" << frame_graph.dump() << gpu_profiler.report();
+    }
+    std::cout << frame_stats.report();
+    frame_stats.write_results(frame_stats_file);
+
+#ifndef APP_NO_FACE_TRACKER
     tracker.stopWorker();
+#endif
+    JobSystem::instance().stop();
+    if (CpuProfiler::instance().enabled())
+        CpuProfiler::instance().write_chrome_trace("cpu_trace.json", cpu_trace_seconds);
+    release_gl();
+    headless_context.destroy();
     // Close OpenGL window if opened and terminate GLFW
-    if (window)
+    if (window) {
         glfwDestroyWindow(window);
+        window = NULL;
+    }
 
     return EXIT_SUCCESS;
 
 }
 
+void App::release_gl(void)
+{
+    // GL objects of all members, while the context still exists: their destructors then find nothing to delete
+    if (!gl_ready)
+        return;
+    frame_graph.clear();
+    gpu_profiler.clear();
+    particles.clear();
+    swarm.clear();
+    projectiles.clear();
+    pager.close();
+    textures.clear();
+    Ground.lod.clear();
+    my_shader.clear();
+    terrain_shader.clear();
+    upscale_shader.clear();
+    glDeleteVertexArrays(1, &fullscreen_vao);
+    glDeleteSamplers(1, &upscale_sampler);
+    fullscreen_vao = upscale_sampler = 0;
+    gl_ready = false;
+}
+
 App::~App()
 {
     // clean-up
+    release_gl();   // init failed after the context was created: run() did not release them
+    if (window)
+        glfwDestroyWindow(window);
     cv::destroyAllWindows();
     glfwTerminate();
-    my_shader.clear();
-    glDeleteTextures(1, &my_texture);
+#ifndef APP_NO_AUDIO
     if (engine) {
         engine->drop();
         engine = nullptr;
@@ -839,15 +1227,159 @@ App::~App()
         BackgroundEngine->drop();
         BackgroundEngine = nullptr;
     }
+#endif
     std::cout << "Bye...\n";
 
 }
 
 App app;
 
+#ifdef __AVX2__
+// built for AVX2 (my_app.vcxproj, CMake APP_AVX2): the CPU and the OS (saved YMM registers) must support it
+static bool cpu_supports_avx2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
 
-int main()
+// the whole argument as a number from lo to hi, otherwise a message naming the option
+static bool parse_count(char const* option, char const* text, long long lo, long long hi, long long& value)
 {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < lo || value > hi) {
+        std::cerr << option << " needs a number from " << lo << " to " << hi << ", got '" << text << "'\n";
+        return false;
+    }
+    return true;
+}
+
+// the same for a real number (megabytes, scales)
+static bool parse_number(char const* option, char const* text, double lo, double hi, double& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !(value >= lo && value <= hi)) {
+        std::cerr << option << " needs a number from " << lo << " to " << hi << ", got '" << text << "'\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef __AVX2__
+    // first thing: a clear message instead of an illegal instruction somewhere later
+    if (!cpu_supports_avx2()) {
+        std::cerr << "This build of my_app needs a CPU with AVX2. Rebuild without it (CMake -DAPP_AVX2=OFF, "
+            "or Enable Enhanced Instruction Set = Not Set in my_app.vcxproj).\n";
+        return EXIT_FAILURE;
+    }
+#endif
+    // my_app.exe --bench <name>  runs the microbenchmarks instead of the application
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return run_benchmarks(argv[2]);
+    // my_app --headless <frames> [width height]  renders a fixed number of frames without window (EGL surfaceless)
+    if (argc > 2 && std::string(argv[1]) == "--headless") {
+        long long frames = 0, width = 1280, height = 720;
+        if (!parse_count("--headless", argv[2], 1, std::numeric_limits<int>::max(), frames))
+            return EXIT_FAILURE;
+        if (argc > 4 && argv[3][0] != '-' && (!parse_count("--headless width", argv[3], 1, 16384, width)
+            || !parse_count("--headless height", argv[4], 1, 16384, height)))
+            return EXIT_FAILURE;
+        app.set_headless(static_cast<int>(frames), static_cast<int>(width), static_cast<int>(height));
+    }
+    // --profile  records CPU zones from the start, the trace is written to cpu_trace.json at exit
+    // --stats <file>  frame time statistics file written at exit (default frame_stats.json)
+    // --fps <hz>  frame limiter target (also key L)
+    // --threads <n>  threads of the job system including the main thread (default: all cores)
+    // --res-scale <s>  fixed render scale of the scene (0.1 .. 1), default: dynamic (headless: 1)
+    // --terrain <file>  heightmap image, --full-terrain  draws every sample instead of LOD patches,
+    // --tessellated-terrain  patches subdivided by their on-screen size, --quantize-heights  16-bit heights (half the memory)
+    // --bake-terrain <image> <file>  writes the tiled file of a heightmap and exits,
+    // --paged-terrain <file>  streams the terrain from a tiled file, --terrain-budget <MB>  memory of its resident tiles (default 64)
+    // --procedural-terrain <seed>  noise instead of the heightmap image, --infinite-terrain <seed>  noise tiles generated around
+    // the camera by the job system, --procedural-size <samples>  per side (default 2049, streamed 32769)
+    // --particles <n>  particle budget of the fire, spark and smoke effects (default 262144)
+    // --fireflies <n>  fireflies in the swarm (default 4096, 0 = none)
+    if (argc > 3 && std::string(argv[1]) == "--bake-terrain")
+        return Heightmap::bake_tiles(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--profile")
+            CpuProfiler::instance().set_enabled(true);
+        else if (std::string(argv[i]) == "--stats" && i + 1 < argc)
+            app.set_frame_stats_file(argv[++i]);
+        else if (std::string(argv[i]) == "--fps" && i + 1 < argc)
+            app.set_frame_limit(std::atof(argv[++i]));
+        else if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+            // at least the main thread: a worker count below 0 would mean "all cores" to the job system
+            long long threads = 0;
+            if (!parse_count("--threads", argv[++i], 1, 1024, threads))
+                return EXIT_FAILURE;
+            app.set_job_threads(static_cast<int>(threads) - 1);
+        }
+        else if (std::string(argv[i]) == "--res-scale" && i + 1 < argc)
+            app.set_resolution_scale(static_cast<float>(std::atof(argv[++i])));
+        else if (std::string(argv[i]) == "--terrain" && i + 1 < argc)
+            app.set_terrain_file(argv[++i]);
+        else if (std::string(argv[i]) == "--full-terrain")
+            app.set_terrain_rendering(Heightmap::Rendering::Full);
+        else if (std::string(argv[i]) == "--tessellated-terrain")
+            app.set_terrain_rendering(Heightmap::Rendering::Tessellated);
+        else if (std::string(argv[i]) == "--quantize-heights")
+            app.set_quantized_heights(true);
+        else if (std::string(argv[i]) == "--paged-terrain" && i + 1 < argc)
+            app.set_paged_terrain(argv[++i]);
+        else if (std::string(argv[i]) == "--terrain-budget" && i + 1 < argc) {
+            // the pager keeps at least 64 tiles whatever the budget, the layer limit of the GPU caps it
+            double megabytes = 0.0;
+            if (!parse_number("--terrain-budget", argv[++i], 1.0, 65536.0, megabytes))
+                return EXIT_FAILURE;
+            app.set_terrain_budget(static_cast<size_t>(megabytes * 1024 * 1024));
+        }
+        else if (std::string(argv[i]) == "--procedural-terrain" && i + 1 < argc)
+            app.set_procedural_terrain(static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10)), false);
+        else if (std::string(argv[i]) == "--infinite-terrain" && i + 1 < argc)
+            app.set_procedural_terrain(static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10)), true);
+        else if (std::string(argv[i]) == "--procedural-size" && i + 1 < argc) {
+            // a map needs two samples per side; 65537: 1024 x 1024 pager tiles, 16 GB as an in-memory float heightfield
+            long long samples = 0;
+            if (!parse_count("--procedural-size", argv[++i], 2, 65537, samples))
+                return EXIT_FAILURE;
+            app.set_procedural_size(static_cast<int>(samples));
+        }
+        else if (std::string(argv[i]) == "--particles" && i + 1 < argc) {
+            // 0: no room, every emission is dropped; ParticleSystem::create() lowers it further to what the GPU can bind
+            long long particles = 0;
+            if (!parse_count("--particles", argv[++i], 0, std::numeric_limits<int>::max(), particles))
+                return EXIT_FAILURE;
+            app.set_particle_budget(static_cast<size_t>(particles));
+        }
+        else if (std::string(argv[i]) == "--fireflies" && i + 1 < argc) {
+            // 0: no swarm; FireflySwarm::create() lowers it further to what the GPU can bind
+            long long fireflies = 0;
+            if (!parse_count("--fireflies", argv[++i], 0, std::numeric_limits<int>::max(), fireflies))
+                return EXIT_FAILURE;
+            app.set_firefly_count(static_cast<size_t>(fireflies));
+        }
+    }
+
     if (!app.init()) {
         std::cerr << "App initialization failed.\n";
         return 3; 
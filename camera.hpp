@@ -25,6 +25,7 @@ public:
     bool onground = false;
     float gravity = -9.81f;
     glm::vec3 Velocity{ 0.0f, 0.0f, 0.0f };
+    glm::vec3 PreviousPosition{};   // before the last simulation step, for interpolated rendering
 
 
     Camera(void) = default; //does nothing
@@ -39,6 +40,18 @@ public:
         return glm::lookAt(this->Position, this->Position + this->Front, this->Up);
     }
 
+    // eye between the last two simulation steps (the orientation follows the mouse directly)
+    glm::vec3 GetRenderPosition(float alpha) const
+    {
+        return glm::mix(this->PreviousPosition, this->Position, alpha);
+    }
+
+    glm::mat4 GetViewMatrix(float alpha)
+    {
+        glm::vec3 eye = GetRenderPosition(alpha);
+        return glm::lookAt(eye, eye + this->Front, this->Up);
+    }
+
     glm::vec3 ProcessInput(GLFWwindow* window, GLfloat deltaTime)
     {
         glm::vec3 direction{ 0 };
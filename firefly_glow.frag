@@ -0,0 +1,16 @@
+#version 460 core
+
+// Firefly swarm (FireflySwarm): soft round glow, added to the scene
+
+in VS_OUT {
+	vec2 corner;		// -1..1
+	vec3 color;			// additive
+} fs_in;
+
+out vec4 FragColor;
+
+void main() {
+	float d = length(fs_in.corner);
+	float glow = max(1.0 - d, 0.0);
+	FragColor = vec4(fs_in.color * glow * glow, 0.0);
+}
@@ -0,0 +1,33 @@
+#version 460 core
+
+// Firefly swarm (FireflySwarm): one camera-facing glowing quad per firefly, no vertex data
+// triangle strip of 4 vertices, the firefly from the SSBO written by firefly_swarm.comp
+
+struct Firefly {
+	vec4 position;		// xyz, blink phase 0..1
+	vec4 velocity;		// xyz, brightness 0..1
+};
+layout(std430, binding = 0) readonly buffer Fireflies { Firefly fireflies[]; };
+
+uniform mat4 uP_m = mat4(1.0);
+uniform mat4 uV_m = mat4(1.0);
+uniform mat4 uM_m = mat4(1.0);
+uniform float glow_size;
+uniform vec3 glow_color;
+
+out VS_OUT {
+	vec2 corner;		// -1..1
+	vec3 color;			// additive
+} vs_out;
+
+void main() {
+	Firefly f = fireflies[gl_InstanceID];
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	// a faint glow between the flashes, larger and brighter while flashing
+	float b = f.velocity.w;
+	vec4 P = uV_m * uM_m * vec4(f.position.xyz, 1.0);
+	P.xy += corner * glow_size * (0.4 + 0.6 * b);
+	gl_Position = uP_m * P;
+	vs_out.corner = corner;
+	vs_out.color = glow_color * (0.08 + 1.5 * b);
+}
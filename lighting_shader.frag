@@ -20,6 +20,18 @@ struct s_lights {
 };
 uniform s_lights lights[MAX_LIGHTS];
 
+// Firefly swarm (FireflySwarm): its brightest fireflies of the frame, selected and written on the GPU
+struct s_swarm_light {
+	vec4 position;	// world, as lights[].position
+	vec4 color;		// diffuse only
+};
+layout(std430, binding = 5) readonly buffer SwarmLights {	// FireflySwarm::light_binding
+	uint swarm_light_count;
+	uint swarm_pad0, swarm_pad1, swarm_pad2;
+	s_swarm_light swarm_lights[];
+};
+uniform int swarm_lights_enabled = 0;
+
 
 uniform vec3 ambient_intensity;	
 // Material properties
@@ -37,11 +49,10 @@ vec2 texCoord;	// texture coordinates for FS
 vec3 N;			// normal in view space
 vec3 L;			// view-space light vector
 vec3 V;			// view vector (negative of the view-space position)
+flat float layer;	// layer of the texture array
 } fs_in;
 
-uniform sampler2D tex0;					// texture unit from C++
-uniform vec2 tileOffset = vec2(0.0);	// the offset of one tile in a texture atlas
-uniform float tileSize = 1.0;			// size of one tile from a texture atlas
+uniform sampler2DArray tex0;			// texture unit from C++, one layer per texture / atlas tile
 out vec4 FragColor; 					// Final output
 
 
@@ -106,6 +117,16 @@ vec4 SpotLight(int i){
 	return vec4(ambient + full_attenuation * (diffuse + specular), 1.0);
 }
 
+// small point lights: diffuse only, short range
+vec4 SwarmLight(uint i){
+	vec3 L_raw = fs_in.L + swarm_lights[i].position.xyz;
+	vec3 N = normalize(fs_in.N);
+	float d = length(L_raw);
+	vec3 L = normalize(L_raw);
+	float dist_attenuation = 1.0 / (1.0 + 0.7 * d + 1.8 * d * d);
+	return vec4(dist_attenuation * max(dot(N, L), 0.0) * swarm_lights[i].color.rgb * diffuse_intensity, 0.0);
+}
+
 //------ Lighting calculations end ------
 
 //------ For fog calculations ------
@@ -119,7 +140,7 @@ return (1 / (1 + exp(steepness * (linear_depth - offset))));
 
 void main() {
 
-vec2 tileUV = fs_in.texCoord * tileSize + tileOffset; //remapping the texturev coordinates for one tile from the texture atlas
+vec3 layerUV = vec3(fs_in.texCoord, fs_in.layer); //texture coordinates inside the layer of the object
 vec4 light_result = vec4(0.0, 0.0, 0.0, 0.0);
 vec4 additional_lights = vec4(1.0, 1.0, 1.0, 1.0);
 // Calculating the lighting based on the number and type of lights in the s_lights structure 
@@ -135,8 +156,12 @@ for (int i = 0; i < MAX_LIGHTS; ++i) {
 
 	light_result += additional_lights; 
 }
-//FragColor = fs_in.color * texture(tex0, tileUV) * light_result;	//Final output of FS
-vec4 PreFogColor = fs_in.color * texture(tex0, tileUV) * light_result;
+if (swarm_lights_enabled != 0) {
+	for (uint i = 0; i < swarm_light_count; ++i)
+		light_result += SwarmLight(i);
+}
+//FragColor = fs_in.color * texture(tex0, layerUV) * light_result;	//Final output of FS
+vec4 PreFogColor = fs_in.color * texture(tex0, layerUV) * light_result;
 
 float depth = log_depth(gl_FragCoord.z, 0.02f, 200.0f);
 FragColor = mix(fog_color, PreFogColor, depth); // linear interpolation
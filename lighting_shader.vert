@@ -3,6 +3,8 @@
 in vec3 aPos; // Positions/Coordinates
 in vec3 aNorm;// Normals
 in vec2 aTex; // Texture Coordinates
+in float aLayer; // Texture array layer: constant per draw (glVertexAttrib) or per instance
+in vec4 aInstance; // Instanced draws (Mesh::draw_instanced): offset xyz, scale w; otherwise the current value (0, 0, 0, 1)
 
 uniform mat4 uP_m = mat4(1.0);	//Projection matrix - 
 uniform mat4 uM_m = mat4(1.0);	//Model matrix - 
@@ -14,24 +16,89 @@ uniform vec4 my_color = vec4(1.0);			//Uniform to change the color of the shader
 uniform vec3 light_position = vec3(0.0f);	//Default to origo will be changed in FS
 uniform mat3 N_matrix = mat3(0.0f);
 
+//------ Terrain (TerrainLod) ------: no vertex data, the heights come from height_map
+// 1 = CDLOD patch, aPos.xy = grid position inside the patch
+// 2 = full grid, position from gl_VertexID: one triangle strip per pair of rows, two vertices per column
+// 3 = paged tile (TerrainPager): grid position from gl_VertexID, heights from its layer of terrain_tiles
+uniform int terrain_mode = 0;
+layout(binding = 1) uniform sampler2D height_map;	// one texel per heightmap sample (R32F or R16), unit 1 (tex0 is on unit 0)
+uniform vec2 height_map_size;		// samples (columns, rows)
+uniform vec2 height_map_range = vec2(0.0, 1.0);	// height = x + texel * y (16-bit heights are normalized)
+uniform vec3 cdlod_node;			// first sample (column, row) of the patch, sample spacing of its level
+uniform vec2 cdlod_morph;			// distance where the morph starts, 1 / morph distance (0 = no morph)
+uniform vec3 cdlod_eye;				// camera in the local space of the terrain
+layout(binding = 2) uniform sampler2DArray terrain_tiles;	// R16, one tile per layer, unit 2
+uniform vec4 tile_params;			// first sample (column, row) of the tile, sample spacing of its level, layer
+const int tile_samples = 67;		// TerrainPager::tile_samples: tile_size + 1 samples, one sample apron per side
+
+float tile_height(vec2 t) { return height_map_range.x + texture(terrain_tiles, vec3((t + 0.5) / float(tile_samples), tile_params.w)).r * height_map_range.y; }
+float terrain_height(vec2 s) { return height_map_range.x + texture(height_map, (s + 0.5) / height_map_size).r * height_map_range.y; }
+// same layout as the Heightmap mesh: x = row, z = column, centered
+vec3 terrain_position(vec2 s) { return vec3(-height_map_size.y * 0.5 + s.y, terrain_height(s), -height_map_size.x * 0.5 + s.x); }
+// central differences, like the normals of the Heightmap mesh
+vec3 terrain_normal(vec2 s) {
+	float dx = terrain_height(s + vec2(0.0, 1.0)) - terrain_height(s - vec2(0.0, 1.0));
+	float dz = terrain_height(s + vec2(1.0, 0.0)) - terrain_height(s - vec2(1.0, 0.0));
+	return normalize(vec3(-dx, 2.0, -dz));
+}
+//------ ------
+
 out VS_OUT {
 vec4 color;		// Outputs color for FS
 vec2 texCoord;	// Outputs texture coordinates for FS
 vec3 N;			// normal in view space
 vec3 L;			//view-space light vector
 vec3 V;			//view vector (negative of the view-space position)
+flat float layer;	// texture array layer for FS
 } vs_out;
 
 void main() {
 
+vec3 position = aPos * aInstance.w + aInstance.xyz;
+vec3 normal = aNorm;
+vec2 texcoord = aTex;
+if (terrain_mode != 0) {
+	vec2 s;
+	if (terrain_mode == 3) {
+		// the outer ring of the grid is a skirt: edge vertex pushed down, hides the cracks to tiles of other levels
+		ivec2 g = ivec2(gl_VertexID % tile_samples, gl_VertexID / tile_samples) - 1;
+		ivec2 inside = clamp(g, ivec2(0), ivec2(tile_samples - 3));
+		vec2 t = vec2(inside + 1);	// texel, past the apron
+		s = min(tile_params.xy + vec2(inside) * tile_params.z, height_map_size - 1.0);
+		float h = tile_height(t) - (g != inside ? tile_params.z * 4.0 : 0.0);
+		position = vec3(-height_map_size.y * 0.5 + s.y, h, -height_map_size.x * 0.5 + s.x);
+		float dx = tile_height(t + vec2(0.0, 1.0)) - tile_height(t - vec2(0.0, 1.0));
+		float dz = tile_height(t + vec2(1.0, 0.0)) - tile_height(t - vec2(1.0, 0.0));
+		normal = normalize(vec3(-dx, 2.0 * tile_params.z, -dz));
+		texcoord = s / (height_map_size - 1.0);
+	}
+	else if (terrain_mode == 1) {
+		s = cdlod_node.xy + aPos.xy * cdlod_node.z;
+		// odd grid vertices slide onto the grid of the next level as the patch gets further from the camera
+		float morph = clamp((distance(cdlod_eye, terrain_position(min(s, height_map_size - 1.0))) - cdlod_morph.x) * cdlod_morph.y, 0.0, 1.0);
+		s -= fract(aPos.xy * 0.5) * 2.0 * cdlod_node.z * morph;
+		s = min(s, height_map_size - 1.0);	// patches at the edge reach beyond the map
+	}
+	else {
+		int strip_length = 2 * int(height_map_size.x);
+		int k = gl_VertexID % strip_length;
+		s = vec2(k / 2, gl_VertexID / strip_length + (k & 1));
+	}
+	if (terrain_mode != 3) {
+		position = terrain_position(s);
+		normal = terrain_normal(s);
+		texcoord = s / (height_map_size - 1.0);
+	}
+}
+
 // Create Model-View matrix
 mat4 mv_m = uV_m * uM_m;
 // Calculate view-space coordinate - in P point
 // we are computing the color
-vec4 P = mv_m * vec4(aPos,1.0f);
-vec3 P_world = vec3(uM_m * vec4(aPos,1.0));
+vec4 P = mv_m * vec4(position,1.0f);
+vec3 P_world = vec3(uM_m * vec4(position,1.0));
 // Calculate normal in view space
-vec3 Normal = N_matrix * aNorm;
+vec3 Normal = N_matrix * normal;
 vs_out.N = mat3(mv_m) * Normal;
 // Calculate view-space light vector
 vs_out.L = light_position - P_world;
@@ -44,6 +111,7 @@ gl_Position = uP_m * P;
 // Assigns the colors somehow
 vs_out.color = my_color;
 // Pass the texture coordinates to "texCoord" for FS
-vs_out.texCoord = aTex;
+vs_out.texCoord = texcoord;
+vs_out.layer = aLayer;
 
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 460 core
+
+// GPU particles (ParticleSystem): fire and smoke take their shape from the fire texture, sparks are round
+
+in VS_OUT {
+	vec2 texCoord;
+	vec4 color;			// premultiplied, alpha 0 = additive
+	flat int kind;
+} fs_in;
+
+uniform sampler2DArray tex0;	// the texture array of the scene, unit 0
+uniform float texture_layer;	// fire.png
+
+out vec4 FragColor;
+
+const int Spark = 1;
+const int Smoke = 2;
+
+void main() {
+	if (fs_in.kind == Spark) {
+		float d = length(fs_in.texCoord * 2.0 - 1.0);
+		FragColor = fs_in.color * max(1.0 - d, 0.0);
+		return;
+	}
+	vec4 tex = texture(tex0, vec3(fs_in.texCoord, texture_layer));
+	if (fs_in.kind == Smoke)
+		FragColor = fs_in.color * tex.a;
+	else
+		FragColor = vec4(fs_in.color.rgb * tex.rgb * tex.a, 0.0);
+}
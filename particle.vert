@@ -0,0 +1,61 @@
+#version 460 core
+
+// GPU particles (ParticleSystem): one camera-facing quad per instance, no vertex data
+// triangle strip of 4 vertices, the particle from the SSBO written by particles.comp
+
+struct Particle {
+	vec4 position;		// xyz, age (s)
+	vec4 velocity;		// xyz, lifetime (s)
+	vec4 look;			// size, kind, random 0..1, -
+};
+layout(std430, binding = 0) readonly buffer Particles { Particle particles[]; };
+
+uniform mat4 uP_m = mat4(1.0);
+uniform mat4 uV_m = mat4(1.0);
+uniform mat4 uM_m = mat4(1.0);
+
+const int Fire = 0;
+const int Spark = 1;
+const int Smoke = 2;
+
+out VS_OUT {
+	vec2 texCoord;
+	vec4 color;			// premultiplied, alpha 0 = additive
+	flat int kind;
+} vs_out;
+
+void main() {
+	Particle p = particles[gl_InstanceID];
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	float t = clamp(p.position.w / p.velocity.w, 0.0, 1.0);	// part of the life
+	int kind = int(p.look.y);
+	mat4 mv_m = uV_m * uM_m;
+	vec4 P = mv_m * vec4(p.position.xyz, 1.0);
+
+	vec2 offset;
+	if (kind == Spark) {
+		// a streak along the motion on screen, longer when faster
+		vec3 v = mat3(mv_m) * p.velocity.xyz;
+		vec2 along = length(v.xy) > 1e-4 ? normalize(v.xy) : vec2(0.0, 1.0);
+		float streak = p.look.x + length(v) * 0.02;
+		offset = along * corner.y * streak * 0.5 + vec2(-along.y, along.x) * corner.x * p.look.x * 0.15;
+		vs_out.color = vec4(vec3(1.0, 0.75, 0.35) * 2.0 * (1.0 - t), 0.0);
+	}
+	else {
+		// flames shrink and cool down, smoke spreads and fades; every particle turns its own way
+		float size = p.look.x * (kind == Fire ? mix(1.0, 0.35, t) : mix(1.0, 3.0, t));
+		float angle = p.look.z * 6.2831853 + p.position.w * (kind == Fire ? 1.5 : 0.4);
+		mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+		offset = rotation * corner * size * 0.5;
+		if (kind == Fire)
+			vs_out.color = vec4(mix(vec3(1.0, 0.85, 0.5), vec3(0.9, 0.2, 0.05), t) * (1.0 - t), 0.0);
+		else {
+			float alpha = 0.5 * smoothstep(0.0, 0.1, t) * (1.0 - t);
+			vs_out.color = vec4(vec3(0.3) * alpha, alpha);
+		}
+	}
+	P.xy += offset;
+	gl_Position = uP_m * P;
+	vs_out.texCoord = corner * 0.5 + 0.5;
+	vs_out.kind = kind;
+}
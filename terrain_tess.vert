@@ -0,0 +1,17 @@
+#version 460 core
+
+// Tessellated terrain (TerrainLod): no vertex data, 4 corners per patch from gl_VertexID, patches row by row.
+// A patch covers tess_patch_size x tess_patch_size heightmap samples, the ones at the edge of the map are smaller.
+
+uniform vec2 height_map_size;		// samples (columns, rows)
+uniform int tess_patch_size = 64;
+
+out vec2 grid_position;				// (column, row) of the corner
+
+void main() {
+	int patches_per_row = (int(height_map_size.x) - 2) / tess_patch_size + 1;
+	int patch_index = gl_VertexID / 4;
+	int corner = gl_VertexID % 4;		// (0,0), (1,0), (0,1), (1,1)
+	vec2 cell = vec2(patch_index % patches_per_row + (corner & 1), patch_index / patches_per_row + (corner >> 1));
+	grid_position = min(cell * float(tess_patch_size), height_map_size - 1.0);
+}
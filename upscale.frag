@@ -0,0 +1,37 @@
+#version 460 core
+// Upscale of the dynamic resolution scene: bilinear sample of the rendered part of the scene texture,
+// then contrast adaptive sharpening (less sharpening where the local contrast is already high, no ringing:
+// the result stays inside the min/max of the cross neighbourhood)
+
+in vec2 uv;
+
+uniform sampler2D scene;
+uniform vec2 uv_scale;      // rendered part of the scene texture (render size / texture size)
+uniform vec2 texel;         // 1 / texture size
+uniform float sharpness;    // 0 = plain bilinear
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 lo = 0.5 * texel;              // stay inside the rendered texels, the rest of the texture is stale
+    vec2 hi = uv_scale - 0.5 * texel;
+    vec2 c_uv = clamp(uv * uv_scale, lo, hi);
+
+    vec3 c = texture(scene, c_uv).rgb;
+    if (sharpness <= 0.0) {
+        FragColor = vec4(c, 1.0);
+        return;
+    }
+    vec3 n = texture(scene, clamp(c_uv + vec2(0.0, texel.y), lo, hi)).rgb;
+    vec3 s = texture(scene, clamp(c_uv - vec2(0.0, texel.y), lo, hi)).rgb;
+    vec3 e = texture(scene, clamp(c_uv + vec2(texel.x, 0.0), lo, hi)).rgb;
+    vec3 w = texture(scene, clamp(c_uv - vec2(texel.x, 0.0), lo, hi)).rgb;
+
+    vec3 mn = min(c, min(min(n, s), min(e, w)));
+    vec3 mx = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sharpness * sqrt(clamp(min(mn, 1.0 - mx) / max(mx, vec3(1.0e-4)), 0.0, 1.0));
+
+    vec3 sharp = c + (4.0 * c - (n + s + e + w)) * 0.25 * amount;
+    FragColor = vec4(clamp(sharp, mn, mx), 1.0);
+}
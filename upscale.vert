@@ -0,0 +1,11 @@
+#version 460 core
+// Fullscreen triangle without vertex buffers: gl_VertexID 0, 1, 2 -> (-1,-1), (3,-1), (-1,3)
+
+out vec2 uv;
+
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    uv = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}